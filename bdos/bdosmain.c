@@ -272,6 +272,26 @@ static const FND funcs[] =
 };
 #define MAX_FNCALL (ARRAY_SIZE(funcs) - 1)
 
+#if CONF_WITH_VFAT
+/*
+ * dirfuncs - table of the MiNT-compatible directory functions,
+ * indexed by function number - FIRST_DIRFUNC
+ */
+static const FND dirfuncs[] =
+{
+    { xpathconf, 0, 3 },    /* 0x124 */
+    { ni,       0, 0 },
+    { ni,       0, 0 },
+    { ni,       0, 0 },
+    { xopendir, 0, 3 },     /* 0x128 */
+    { xreaddir, 0, 5 },     /* 0x129 */
+    { xrewinddir, 0, 2 },   /* 0x12A */
+    { xclosedir, 0, 2 }     /* 0x12B */
+};
+#define FIRST_DIRFUNC   0x124
+#define LAST_DIRFUNC    (FIRST_DIRFUNC + ARRAY_SIZE(dirfuncs) - 1)
+#endif
+
 
 /*
  *  xgetver -
@@ -345,6 +365,7 @@ static void freetree(DND *d)
         freetree(d->d_right);
     if (d->d_ofd)
     {
+        release_extents(d->d_ofd);
         xmfreblk(d->d_ofd);
     }
     for (i = 1, p = dirtbl+1; i < NCURDIR; i++, p++)
@@ -373,6 +394,7 @@ static void offree(DMD *d)
         {
             if (f->o_dmd == d)
             {
+                release_extents(f);
                 xmfreblk(f);
                 sft[i].f_ofd = 0;
                 sft[i].f_own = 0;
@@ -383,6 +405,14 @@ static void offree(DMD *d)
 }
 
 
+/*
+ * TRUE while osif() writes old dirty buffers: errors then concern some
+ * drive other than the one the current call is for, so they must not
+ * be returned by the call
+ */
+static BOOL syncing;
+
+
 /*
  *  osif -
  */
@@ -390,7 +420,6 @@ long osif(int *pw)
 {
     char **pb, *pb2, *p, ctmp;
     BPB *b;
-    BCB *bx;
     DND *dn;
     int typ, h, i, fn;
     int num, max;
@@ -399,7 +428,11 @@ long osif(int *pw)
 
 restrt:
     fn = pw[0];
+#if CONF_WITH_VFAT
+    if ((fn > MAX_FNCALL) && ((fn < FIRST_DIRFUNC) || (fn > LAST_DIRFUNC)))
+#else
     if (fn > MAX_FNCALL)
+#endif
         return EINVFN;
 
     KDEBUG(("BDOS (fn=0x%04x)\n",fn));
@@ -416,44 +449,87 @@ restrt:
             /* first, out with the old stuff */
             dn = drvtbl[errdrv]->m_dtl;
             offree(drvtbl[errdrv]);
+            discard_fmap(drvtbl[errdrv]);
+#if CONF_WITH_DIRINDEX
+            discard_dirindex(drvtbl[errdrv],NULL);
+#endif
+#if CONF_WITH_DNDCACHE
+            discard_dndcache(drvtbl[errdrv]);
+#endif
             xmfreblk(drvtbl[errdrv]);
             drvtbl[errdrv] = 0;
 
             if (dn)
                 freetree(dn);
 
-            for (i = 0; i < 2; i++)
-                for (bx = bufl[i]; bx; bx = bx->b_link)
-                    if (bx->b_bufdrv == errdrv)
-                        bx->b_bufdrv = -1;
+            invalidate_buffers(errdrv);
 
             /* then, in with the new */
             b = (BPB *)Getbpb(errdrv);
             if ((long)b <= 0)
             {
                 drvsel &= ~(1L<<errdrv);
+                if (syncing)
+                    goto sync_failed;
                 if (b)
                     return (long)b;
                 return rc;
             }
 
             if (log_media(b,errdrv))
-                return ENSMEM;
+            {
+                if (!syncing)
+                    return ENSMEM;
+                drvsel &= ~(1L<<errdrv);    /* try again on next access */
+            }
 
             rwerr = 0;
             errdrv = 0;
+            if (syncing)
+                goto sync_failed;
+            goto restrt;
+        }
+
+        /*
+         * if the periodic write failed, keep the buffers dirty and
+         * carry on with the call: the error is reported (against the
+         * right drive) when they are next written from a call
+         */
+        if (syncing)
+        {
+        sync_failed:
+            syncing = FALSE;
+            rwerr = 0;
+            errdrv = 0;
+            postpone_sync();
             goto restrt;
         }
 
         /* else handle as hard error on disk for now */
 
-        for (i = 0; i < 2; i++)
-            for (bx = bufl[i]; bx; bx = bx->b_link)
-                if (bx->b_bufdrv == errdrv)
-                    bx->b_bufdrv = -1;
+        invalidate_buffers(errdrv);
+        if (drvtbl[errdrv])     /* the FAT may no longer match the bitmap */
+        {
+            discard_fmap(drvtbl[errdrv]);
+#if CONF_WITH_DIRINDEX
+            discard_dirindex(drvtbl[errdrv],NULL);
+#endif
+        }
         return rc;
     }
 
+    syncing = TRUE;
+    sync_if_due();  /* write old dirty buffers (needs errbuf) */
+    syncing = FALSE;
+#if CONF_WITH_DNDCACHE
+    dndcache_newcall();
+#endif
+
+#if CONF_WITH_VFAT
+    if (fn >= FIRST_DIRFUNC)
+        f = &dirfuncs[fn-FIRST_DIRFUNC];
+    else
+#endif
     f = &funcs[fn];
     typ = f->stdio_typ;
 
@@ -90,7 +90,11 @@ typedef struct _dnd DND;
 typedef struct _dmd DMD;
 
 typedef unsigned int FH;        /*  file handle    */
+#if CONF_WITH_FAT32
+typedef ULONG CLNO;             /*  cluster number */
+#else
 typedef UWORD CLNO;             /*  cluster number */
+#endif
 typedef ULONG RECNO;            /*  record number  */
 
 
@@ -115,7 +119,7 @@ struct _ofd
 {
     OFD   *o_link;      /*  link to next OFD                    */
     UWORD o_flag;
-                    /* the following 3 items must be as in FCB: */
+                    /* the following 3 items are as in FCB: */
     DOSTIME o_td;       /*  creation time/date: little-endian!  */
     CLNO  o_strtcl;     /*  starting cluster number             */
     long  o_fileln;     /*  length of file in bytes             */
@@ -132,6 +136,8 @@ struct _ofd
     WORD  o_usecnt;     /* use count for inherited files        */
     OFD   *o_thread;    /* mulitple open thread list            */
     UWORD o_mod;        /* mode file opened in (see below)      */
+    struct _extlist *o_ext; /* cluster run cache (see fsfat.c)  */
+    long  o_seqpos;     /* file position after the last read    */
 } ;
 
 /*
@@ -169,9 +175,10 @@ typedef struct
 {
     char f_name[11];
     char f_attrib;
-    char f_fill[10];
+    char f_fill[8];
+    UWORD f_clusthi;        /* FAT32 only: high word of f_clust */
     DOSTIME f_td;           /* time, date */
-    CLNO f_clust;
+    UWORD f_clust;          /* (use getfcbcl()/setfcbcl() for these) */
     long f_fileln;
 } FCB;
 
@@ -187,6 +194,18 @@ typedef struct
 #define FA_NORM         (FA_ARCHIVE|FA_SYSTEM|FA_HIDDEN|FA_RO)
 #define FA_LFN          0x0f
 
+/*
+ * VFAT long filenames are held in a run of FA_LFN entries which
+ * immediately precede the normal (8.3) entry.  each holds 13 characters
+ * of the name, and they are stored in reverse order, with LFN_LAST set
+ * in the ordinal of the first one.
+ */
+#define LFN_LAST        0x40    /* in f_name[0], flags last LFN entry */
+#define LFN_ORDMASK     0x3f    /* in f_name[0], ordinal (1-20) */
+#define LFN_CHARS       13      /* characters per LFN entry */
+#define LFN_MAXENT      20      /* max LFN entries per name */
+#define LFN_MAXLEN      255     /* max length of a long filename */
+
 
 
 /*
@@ -214,6 +233,10 @@ struct _dnd         /* directory node descriptor */
 
     long d_scan;        /*  current posn in dir for DND tree    */
     OFD  *d_files;      /* open files on this node              */
+#if CONF_WITH_DNDCACHE
+    DND  *d_hlink;      /*  next DND in same hash chain         */
+    UWORD d_stamp;      /*  for LRU reclamation                 */
+#endif
 } ;
 
 /*
@@ -221,19 +244,24 @@ struct _dnd         /* directory node descriptor */
  */
 #define DND_LOCKED  0x8000  /* DND may not be scavenged (see     */
                             /* free_available_dnds() in fsdir.c) */
+#define DND_NOINDEX 0x4000  /* directory is too small for a name  */
+                            /* index (see scan() in fsdir.c)      */
 
 
 
 /*
  *  DMD - Drive Media Block
  *
+ *  architectural restriction: this is allocated from the OS memory
+ *  pool, so it must not exceed 64 bytes in length
+ *
  *  note: in the following comments, records == logical sectors
  */
 struct _dmd         /* drive media block */
 {
     RECNO  m_recoff[3]; /*  record offsets for fat,dir,data     */
     int    m_drvnum;    /*  drive number for this media         */
-    int    m_fsiz;      /*  fat size in records M01.01.03       */
+    RECNO  m_fsiz;      /*  fat size in records M01.01.03       */
     int    m_clsiz;     /*  cluster size in records M01.01.03   */
     unsigned int m_clsizb;  /*  cluster size in bytes           */
     int    m_recsiz;    /*  record size in bytes                */
@@ -247,11 +275,54 @@ struct _dmd         /* drive media block */
     int    m_clbm;      /* clsiz in bytes, mask                 */
     OFD    *m_fatofd;   /* OFD for 'fat file'                   */
 
-    OFD    *m_ofl;      /*  list of open files                  */
     DND    *m_dtl;      /* root of directory tree list          */
-    UWORD  m_16;        /* 16 bit fat ?                         */
+    UBYTE  m_16;        /* 16 bit fat ?                         */
+    UBYTE  m_32;        /* 32 bit fat ? (flags, see below)      */
+    UWORD  m_fsinfo;    /* FAT32 FSInfo record number, or 0     */
+
+    UBYTE  *m_fmap;     /* free cluster bitmap, built on demand */
+    CLNO   m_freecl;    /* nbr of free clusters (see below)     */
+    CLNO   m_rover;     /* where to start looking for free cl   */
 } ;
 
+/*
+ * bit usage in m_32 (zero for FAT12/FAT16)
+ *
+ * m_freecl is valid if there is a free cluster bitmap, or if M32_FREEVALID
+ * is set.  for FAT32, it is initialised from the FSInfo sector, and the
+ * FSInfo sector is rewritten when buffers are synced if M32_FSIDIRTY is set.
+ *
+ * on FAT32, the root directory is a normal cluster chain, so its OFD has a
+ * non-NULL o_dnode (pointing to the root DND itself), and m_recoff[BT_ROOT]
+ * is zero; BT_ROOT buffers are used to access the FSInfo sector.
+ */
+#define M32_FAT32       0x01    /* 32 bit fat */
+#define M32_FSILOADED   0x02    /* FSInfo sector has been read */
+#define M32_FSIVALID    0x04    /* ... and has valid signatures */
+#define M32_FREEVALID   0x08    /* m_freecl is valid without bitmap */
+#define M32_FSIDIRTY    0x10    /* FSInfo sector must be rewritten */
+
+/*
+ *  FSINFO - FAT32 FSInfo sector
+ *
+ *  architectural restriction: this is the structure on disk, so
+ *  all values are little-endian
+ */
+typedef struct
+{
+    ULONG fsi_sig1;         /* FSI_SIG1 */
+    char  fsi_fill1[480];
+    ULONG fsi_sig2;         /* FSI_SIG2 */
+    ULONG fsi_freecl;       /* number of free clusters, or -1 */
+    ULONG fsi_nextfree;     /* hint for next free cluster, or -1 */
+    char  fsi_fill2[12];
+    ULONG fsi_sig3;         /* FSI_SIG3 */
+} FSINFO;
+
+#define FSI_SIG1        0x52526141L     /* "RRaA" */
+#define FSI_SIG2        0x72724161L     /* "rrAa" */
+#define FSI_SIG3        0x000055aaL
+
 
 
 /*
@@ -314,11 +385,13 @@ typedef struct
     LONG  dt_offset_drive;      /*  -1 => uninitialised DTA, else:      */
                                 /*   bits 4-0: drive id                 */
                                 /*   bits 31-5: if root, offset to next */
-                                /*    FCB, otherwise 0                  */
+                                /*    FCB, otherwise bits 31-16 of the  */
+                                /*    cluster number (FAT32)            */
     UWORD dt_cloffset;          /*  if subdir, offset within cluster to */
                                 /*   next FCB, otherwise 0              */
-    CLNO  dt_clnum;             /*  if subdir, current cluster number,  */
-                                /*   otherwise 0                        */
+    UWORD dt_clnum;             /*  if subdir, current cluster number,  */
+                                /*   otherwise 0 (FAT32: low word only, */
+                                /*   high bits in dt_offset_drive)      */
     char  dt_attr;              /*  attribute from Fsfirst()            */
                             /* public area, must not change             */
     char  dt_fattr;             /*  attrib from fcb             21      */
@@ -399,11 +472,26 @@ BOOL contains_illegal_characters(const char *test);
  */
 
 void bufl_init(void);
-/* ??? */
+/* discard all buffers for a drive */
+void invalidate_buffers(int drv);
+/* write a buffer if dirty, and invalidate it */
 void flush(BCB *b);
+/* write all dirty buffers for a drive (or all drives), leaving them valid */
+void sync_buffers(int drv);
+/* write all dirty buffers if they have been waiting too long */
+void sync_if_due(void);
+/* retry sync_if_due() later, after it failed */
+void postpone_sync(void);
 /* return the ptr to the buffer containing the desired record */
 char *getrec(RECNO recn, OFD *of, int wrtflg);
 BCB *getbcb(DMD *dmd,WORD buftype,RECNO recnum);
+#if CONF_BDOS_READAHEAD
+/* read consecutive data records into the buffers in a single request */
+void readahead(DMD *dm, RECNO recnum, int count);
+#endif
+#if CONF_WITH_FAT32
+char *getsysrec(DMD *dm, RECNO recn, int wrtflg);
+#endif
 
 /*
  * in fsfat.c
@@ -414,6 +502,15 @@ void clfix(CLNO cl, CLNO link, DMD *dm);
 CLNO getrealcl(CLNO cl, DMD *dm);
 CLNO getclnum(CLNO cl, OFD *of);
 int nextcl(OFD *p, int wrtflg);
+int nextcl_run(OFD *p, int wrtflg, CLNO want);
+CLNO seekcl(OFD *p, CLNO idx, CLNO curidx, CLNO curcl);
+void release_extents(OFD *p);
+CLNO getfcbcl(const FCB *f, const DMD *dm);
+void setfcbcl(FCB *f, CLNO cl);
+#if CONF_WITH_FAT32
+void sync_fsinfo(int drv);
+#endif
+void discard_fmap(DMD *dm);
 long xgetfree(long *buf, int drv);
 
 /*
@@ -455,6 +552,35 @@ int incr_curdir_usage(DND *dnd);
 void decr_curdir_usage(int index);
 OFD *makofd(DND *p);
 WORD free_available_dnds(void);
+char *packit(char *s, char *d);
+#if CONF_WITH_DIRINDEX
+void discard_dirindex(DMD *dm, DND *dnd);
+#endif
+#if CONF_WITH_DNDCACHE
+void dndcache_newcall(void);
+void discard_dndcache(DMD *dm);
+#endif
+
+#if CONF_WITH_VFAT
+/*
+ * in fsvfat.c
+ */
+
+BOOL lfn_is_long(const char *s);
+UBYTE lfn_checksum(const char *name);
+void lfn_reset(void);
+void lfn_collect(const FCB *f);
+BOOL lfn_match(const FCB *f, const char *n);
+long lfn_create(DND *dn, const char *name, char *alias);
+void lfn_erase(OFD *fd, LONG pos, UBYTE sum);
+void close_dirhandles(PD *p);
+
+long xpathconf(char *name, int mode);
+long xopendir(char *name, int flag);
+long xreaddir(int len, long handle, char *buf);
+long xrewinddir(long handle);
+long xclosedir(long handle);
+#endif
 
 
 /*
@@ -471,8 +597,13 @@ OFD  *getofd(int h);
  * FAT chain defines
  */
 #define FREECLUSTER     0x0000
+#if CONF_WITH_FAT32
+#define ENDOFCHAIN      0x0fffffffL             /* our end-of-chain marker */
+#define endofchain(a)   ((a)==ENDOFCHAIN)       /* getrealcl() converts the others */
+#else
 #define ENDOFCHAIN      0xffff                  /* our end-of-chain marker */
 #define endofchain(a)   (((a)&0xfff8)==0xfff8)  /* in case file was created by someone else */
+#endif
 
 
 /* Misc. defines */
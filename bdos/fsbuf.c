@@ -22,24 +22,160 @@
 #include "mem.h"
 #include "string.h"
 #include "kprint.h"
+#include "../bios/tosvars.h"
 
 extern BCB *bufl[];     /* buffer lists - two lists:  FAT and dir/data */
 
-#define NUMBUFS 2       /* buffers per list */
+/*
+ * BCBX - extended Buffer Control Block
+ *
+ * the public BCB (see fs.h) has a fixed layout, so the additional
+ * information needed for the hash index and the LRU list is kept in
+ * this private structure, which begins with the BCB.  the bufl[] chains
+ * are built once at initialisation and are never reordered, so that
+ * programs which walk or extend them see a consistent list.
+ *
+ * note that BCBs added to the bufl[] chains by external programs are
+ * never used for caching, and are never written back by the cache: at
+ * most, they are marked invalid by invalidate_buffers().
+ */
+typedef struct _bcbx BCBX;
+struct _bcbx
+{
+    BCB     x_bcb;      /*  public part: must be first  */
+    BCBX    *x_hlink;   /*  next buffer in hash chain   */
+    BCBX    *x_prev;    /*  more recently used buffer   */
+    BCBX    *x_next;    /*  less recently used buffer   */
+    UWORD   x_hash;     /*  hash chain index, or NOHASH */
+};
+
+#define NOHASH  0xffff
+
+#define MINBUFS 2       /* minimum buffers per list */
+#define BUFMEM_SHIFT 6  /* use 1/64th of free memory for buffers if not configured */
+
+/*
+ * the LRU lists (one per buffer list) and the hash index
+ */
+static BCBX *lru_head[2];           /* most recently used buffer */
+static BCBX *lru_tail[2];           /* least recently used buffer */
+static BCBX **bcb_hash;             /* hash chain heads */
+static UWORD bcb_hashmask;
+
+#define BCB_HASH(drv,typ,rec)   \
+    (((UWORD)(rec) + ((UWORD)(drv) << 6) + ((UWORD)(typ) << 12)) & bcb_hashmask)
+
+/*
+ * write-back support
+ *
+ * dirty buffers are not written individually, but are collected by
+ * sync_buffers(), sorted, and written in runs of consecutive records.
+ * a run is copied to flush_buf so that it can be written by a single
+ * Rwabs() call.
+ */
+#define FLUSH_BUFSIZE   8192L       /* size of buffer for coalesced writes */
+#define SYNC_DELAY      (2*200)     /* max age of dirty buffers (in 200Hz ticks) */
+
+static BCBX **dirty_list;           /* work area for sync_buffers() */
+static char *flush_buf;             /* work area for coalesced writes */
+static WORD flush_max;              /* max records per coalesced write */
+static BOOL dirty_pending;          /* TRUE iff there may be dirty buffers ... */
+static LONG dirty_time;             /* ... and hz_200 when the first was dirtied */
+
+#if CONF_BDOS_READAHEAD
+static WORD readahead_max;          /* max dir/data buffers used by readahead() */
+#endif
+
+/* absolute record number of the contents of a (valid) buffer */
+#define ABSREC(b)   ((b)->b_bufrec + (b)->b_dm->m_recoff[(b)->b_buftyp])
 
-/* creates a chain of BCBs and corresponding buffers */
-static void *create_chain(char *p,LONG n)
+
+/*
+ * lru_unlink - remove a buffer from its LRU list
+ */
+static void lru_unlink(BCBX *x, int list)
 {
-    BCB *bcbptr;
+    if (x->x_prev)
+        x->x_prev->x_next = x->x_next;
+    else
+        lru_head[list] = x->x_next;
+
+    if (x->x_next)
+        x->x_next->x_prev = x->x_prev;
+    else
+        lru_tail[list] = x->x_prev;
+}
+
+
+/*
+ * lru_insert - put a buffer at the head (most recently used end)
+ * or the tail (least recently used end) of an LRU list
+ */
+static void lru_insert(BCBX *x, int list, BOOL at_head)
+{
+    if (at_head)
+    {
+        x->x_prev = NULL;
+        x->x_next = lru_head[list];
+        if (x->x_next)
+            x->x_next->x_prev = x;
+        else
+            lru_tail[list] = x;
+        lru_head[list] = x;
+    }
+    else
+    {
+        x->x_next = NULL;
+        x->x_prev = lru_tail[list];
+        if (x->x_prev)
+            x->x_prev->x_next = x;
+        else
+            lru_head[list] = x;
+        lru_tail[list] = x;
+    }
+}
+
+
+/*
+ * unhash - remove a buffer from the hash index
+ */
+static void unhash(BCBX *x)
+{
+    BCBX **q;
+
+    if (x->x_hash == NOHASH)
+        return;
+
+    for (q = &bcb_hash[x->x_hash]; *q; q = &(*q)->x_hlink)
+    {
+        if (*q == x)
+        {
+            *q = x->x_hlink;
+            break;
+        }
+    }
+    x->x_hash = NOHASH;
+}
+
+
+/*
+ * creates a chain of 'nbufs' BCBs and corresponding buffers; the
+ * buffers are also linked into LRU list 'list'
+ */
+static char *create_chain(char *p, LONG n, WORD nbufs, int list)
+{
+    BCBX *x;
     WORD i;
 
-    for (i = 0; i < NUMBUFS; i++, p += n) {
-        bcbptr = (BCB *)p;
-        memset(bcbptr,0x00,sizeof(BCB));
-        if (i < NUMBUFS-1)                  /* chain to next */
-            bcbptr->b_link = (BCB *)(p + n);
-        bcbptr->b_bufdrv = -1;              /* mark as invalid */
-        bcbptr->b_bufr = p + sizeof(BCB);
+    for (i = 0; i < nbufs; i++, p += n) {
+        x = (BCBX *)p;
+        memset(x,0x00,sizeof(BCBX));
+        if (i < nbufs-1)                    /* chain to next */
+            x->x_bcb.b_link = (BCB *)(p + n);
+        x->x_bcb.b_bufdrv = -1;             /* mark as invalid */
+        x->x_bcb.b_bufr = p + sizeof(BCBX);
+        x->x_hash = NOHASH;
+        lru_insert(x,list,FALSE);
     }
 
     return p;
@@ -47,24 +183,119 @@ static void *create_chain(char *p,LONG n)
 
 /*
  * bufl_init - BDOS buffer list initialization
+ *
+ * the number of buffers per list is CONF_BDOS_BUFFERS if that is
+ * non-zero, otherwise it is derived from the size of the largest
+ * free memory block.
  */
 void bufl_init(void)
 {
     char *p;
-    LONG n;
-
-    n = sizeof(BCB) + pun_ptr->max_sect_siz;
-    p = (char *)xmalloc(2L*NUMBUFS*n);
+    LONG n, size;
+    WORD nbufs, nhash;
+    int mode;
+
+#if CONF_PREFER_STRAM_DISK_BUFFERS
+    mode = MX_PREFSTRAM;
+#else
+    mode = MX_PREFTTRAM;
+#endif
+
+    /* size of one buffer, including its BCBX, rounded up to a LONG boundary */
+    n = (sizeof(BCBX) + pun_ptr->max_sect_siz + 3) & ~3L;
+
+#if CONF_BDOS_BUFFERS
+    nbufs = CONF_BDOS_BUFFERS;
+#else
+    size = ((LONG)xmxalloc(-1L,mode) >> BUFMEM_SHIFT) / (2 * n);
+    if (size > CONF_BDOS_MAX_BUFFERS)
+        size = CONF_BDOS_MAX_BUFFERS;
+    nbufs = (size < MINBUFS) ? MINBUFS : size;
+#endif
+
+    /* the hash index has one chain per buffer (rounded up to a power of 2) */
+    for (nhash = 1; nhash < 2*nbufs; nhash <<= 1)
+        ;
+    bcb_hashmask = nhash - 1;
+
+    /* the coalescing buffer holds at least one record */
+    flush_max = FLUSH_BUFSIZE / pun_ptr->max_sect_siz;
+    if (flush_max < 1)
+        flush_max = 1;
+    if (flush_max > 2*nbufs)
+        flush_max = 2*nbufs;
+
+#if CONF_BDOS_READAHEAD
+    /* readahead never uses more than half the dir/data buffers */
+    readahead_max = min(flush_max,nbufs/2);
+    if (readahead_max > CONF_BDOS_READAHEAD)
+        readahead_max = CONF_BDOS_READAHEAD;
+#endif
+
+    size = (nhash + 2L*nbufs) * sizeof(BCBX *) + 2L * nbufs * n;
+    if (flush_max > 1)
+        size += (LONG)flush_max * pun_ptr->max_sect_siz;
+    p = (char *)xmxalloc(size,mode);
     if (!p)
-        panic("bufl_init(%ld): no memory\n",2L*NUMBUFS*n);
+        panic("bufl_init(%ld): no memory\n",size);
+
+    KDEBUG(("bufl_init(): %d buffers per list, %d hash chains\n",nbufs,nhash));
+
+    bcb_hash = (BCBX **)p;
+    memset(bcb_hash,0x00,nhash*sizeof(BCBX *));
+    p += nhash * sizeof(BCBX *);
+
+    dirty_list = (BCBX **)p;
+    p += 2L * nbufs * sizeof(BCBX *);
+
+    if (flush_max > 1)
+    {
+        flush_buf = p;
+        p += (LONG)flush_max * pun_ptr->max_sect_siz;
+    }
 
     /* set up FAT chain */
     bufl[BI_FAT] = (BCB *)p;
-    p = create_chain(p,n);
+    p = create_chain(p,n,nbufs,BI_FAT);
 
     /* set up dir/data chain */
     bufl[BI_DATA] = (BCB *)p;
-    create_chain(p,n);
+    create_chain(p,n,nbufs,BI_DATA);
+}
+
+
+/*
+ * invalidate_buffers - discard the contents of all buffers for drive 'drv'
+ *
+ * this is used after a media change or a hard error: dirty buffers are
+ * not written.  the buffers are moved to the tail of their LRU list, so
+ * that they are reused first.
+ */
+void invalidate_buffers(int drv)
+{
+    BCB *b;
+    BCBX *x, *next;
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        for (x = lru_head[i]; x; x = next)
+        {
+            next = x->x_next;
+            if (x->x_bcb.b_bufdrv == drv)
+            {
+                x->x_bcb.b_bufdrv = -1;
+                unhash(x);
+                lru_unlink(x,i);
+                lru_insert(x,i,FALSE);
+            }
+        }
+
+        /* handle any BCBs added to the chain by other programs */
+        for (b = bufl[i]; b; b = b->b_link)
+            if (b->b_bufdrv == drv)
+                b->b_bufdrv = -1;
+    }
 }
 
 
@@ -107,63 +338,216 @@ void flush(BCB *b)
 }
 
 
+/*
+ * bcb_after - return TRUE iff the buffer 'x' must be written after 'y'
+ *
+ * buffers are ordered by drive, then by absolute record number
+ */
+static BOOL bcb_after(BCBX *x, BCBX *y)
+{
+    if (x->x_bcb.b_bufdrv != y->x_bcb.b_bufdrv)
+        return x->x_bcb.b_bufdrv > y->x_bcb.b_bufdrv;
+
+    return ABSREC(&x->x_bcb) > ABSREC(&y->x_bcb);
+}
+
 
 /*
- * getbcb - called by getrec() to get the BCB for the desired record
+ * write_run - write a run of 'count' dirty buffers from dirty_list[]
  *
- * buftype is BT_FAT, BT_ROOT, or BT_DATA
+ * the buffers contain consecutive records of the same type on the
+ * same drive.  FAT records are written to both FATs.  if a write
+ * fails, the buffers stay valid and dirty, so that the data is not
+ * lost: it is written (or the error reported) by a later sync.  after
+ * a media change, the buffers are discarded by the error handling in
+ * osif(), via invalidate_buffers().
  */
-BCB *getbcb(DMD *dmd,WORD buftype,RECNO recnum)
+static void write_run(BCBX **list, int count)
 {
+    BCB *b = &list[0]->x_bcb;
+    DMD *dm = b->b_dm;
+    RECNO rec = ABSREC(b);
+    char *p;
+    int i, d = b->b_bufdrv;
+    BOOL fat = (b->b_buftyp == BT_FAT);
+
+    if (count == 1)
+        p = b->b_bufr;
+    else
+    {
+        p = flush_buf;
+        for (i = 0; i < count; i++)
+            memcpy(p+((LONG)i<<dm->m_rblog),list[i]->x_bcb.b_bufr,dm->m_recsiz);
+    }
+
+    longjmp_rwabs(1, (long)p, count, rec, d);
+
+    /* flush to both fats */
+
+    if (fat) {
+        longjmp_rwabs(1, (long)p, count, rec-dm->m_fsiz, d);
+    }
+
+    for (i = 0; i < count; i++)
+        list[i]->x_bcb.b_dirty = 0;
+}
+
+
+/*
+ * sync_buffers - write all dirty buffers for drive 'drv' (or for all
+ * drives if 'drv' is negative)
+ *
+ * the buffers are written in ascending order of record number, and
+ * consecutive records are written by a single Rwabs() call.  unlike
+ * flush(), this leaves the buffers valid.
+ *
+ * NOTE: as for flush(), errors are handled via longjmp().
+ */
+void sync_buffers(int drv)
+{
+    BCBX *x;
     BCB *b;
-    BCB *p, *mtbuf, **q, **phdr;
-    int err;
+    RECNO next;
+    int i, j, n, count;
+
+    if (!dirty_pending)
+        return;
 
-    mtbuf = 0;
-    phdr = &bufl[buftype==BT_FAT ? BI_FAT : BI_DATA];
+#if CONF_WITH_FAT32
+    sync_fsinfo(drv);       /* this may add another dirty buffer */
+#endif
 
     /*
-     * See if the desired record for the desired drive is in memory.
-     * If it is, we will use it.  Otherwise we will use
-     *          the last invalid (available) buffer,  or
-     *          the last (least recently) used buffer.
+     * collect the dirty buffers, using an insertion sort
+     */
+    for (i = n = 0; i < 2; i++)
+    {
+        for (x = lru_head[i]; x; x = x->x_next)
+        {
+            b = &x->x_bcb;
+            if ((b->b_bufdrv == -1) || !b->b_dirty)
+                continue;
+            if ((drv >= 0) && (b->b_bufdrv != drv))
+                continue;
+            for (j = n++; (j > 0) && bcb_after(dirty_list[j-1],x); j--)
+                dirty_list[j] = dirty_list[j-1];
+            dirty_list[j] = x;
+        }
+    }
+
+    KDEBUG(("sync_buffers(%d): %d dirty buffers\n",drv,n));
+
+    /*
+     * write them, combining consecutive records into a single request
      */
+    for (i = 0; i < n; i += count)
+    {
+        b = &dirty_list[i]->x_bcb;
+        next = ABSREC(b) + 1;
+        for (count = 1; (count < flush_max) && (i+count < n); count++, next++)
+        {
+            x = dirty_list[i+count];
+            if ((x->x_bcb.b_bufdrv != b->b_bufdrv)
+             || ((x->x_bcb.b_buftyp == BT_FAT) != (b->b_buftyp == BT_FAT))
+             || (ABSREC(&x->x_bcb) != next))
+                break;
+        }
+        write_run(dirty_list+i,count);
+    }
+
+    if (drv < 0)
+        dirty_pending = FALSE;
+}
+
+
+/*
+ * sync_if_due - write all dirty buffers if the oldest one has been
+ * waiting for longer than SYNC_DELAY
+ *
+ * this is called on entry to the BDOS, since it is not safe to write
+ * buffers from the timer interrupt
+ */
+void sync_if_due(void)
+{
+    if (dirty_pending && (hz_200 - dirty_time >= SYNC_DELAY))
+        sync_buffers(-1);
+}
+
+
+/*
+ * postpone_sync - called when sync_if_due() failed: the buffers that
+ * could not be written stay dirty, and are retried after SYNC_DELAY
+ */
+void postpone_sync(void)
+{
+    dirty_time = hz_200;
+}
+
 
-    for (b = *(q = phdr); b; b = *(q = &b->b_link))
+
+/*
+ * findbuf - return the buffer containing the desired record, or NULL
+ * if it is not in memory
+ */
+static BCBX *findbuf(DMD *dmd, WORD buftype, RECNO recnum)
+{
+    BCBX *x;
+    BCB *b;
+
+    for (x = bcb_hash[BCB_HASH(dmd->m_drvnum,buftype,recnum)]; x; x = x->x_hlink)
     {
+        b = &x->x_bcb;
         if ((b->b_bufdrv == dmd->m_drvnum) && (b->b_buftyp == buftype) && (b->b_bufrec == recnum))
             break;
-        /*
-         * keep track of the last invalid buffer
-         */
-        if (b->b_bufdrv == -1)  /*  if buffer not valid */
-            mtbuf = b;          /*    then it's 'empty' */
     }
 
-    if (!b)
-    {
-        /*
-         * not in memory.  If there was an 'empty' buffer, use it.
-         */
-        if (mtbuf)
-            b = mtbuf;
+    return x;
+}
 
+
+/*
+ * getbcb - called by getrec() to get the BCB for the desired record
+ *
+ * buftype is BT_FAT, BT_ROOT, or BT_DATA
+ */
+BCB *getbcb(DMD *dmd,WORD buftype,RECNO recnum)
+{
+    BCBX *x;
+    BCB *b;
+    int list, err;
+    UWORD hash;
+
+    list = (buftype == BT_FAT) ? BI_FAT : BI_DATA;
+    hash = BCB_HASH(dmd->m_drvnum,buftype,recnum);
+
+    /*
+     * See if the desired record for the desired drive is in memory.
+     * If it is, we will use it.  Otherwise we will use the least
+     * recently used buffer.
+     */
+    x = findbuf(dmd,buftype,recnum);
+
+    if (!x)
+    {
         /*
-         * find predecessor of mtbuf, or last guy in list, which
-         * is the least recently used.
+         * not in memory: use the least recently used buffer
          */
+        x = lru_tail[list];
 
-doio:   for (p = *(q = phdr); p->b_link; p = *(q = &p->b_link))
-            if (b == p)
-                break;
-        b = p;
+doio:   b = &x->x_bcb;
 
         /*
          * flush the current contents of the buffer, and read in the
-         * new record.
+         * new record.  the buffer is marked invalid in case of error.
+         * if the buffer is dirty, we take the opportunity to write all
+         * the dirty buffers for the same drive.
          */
 
+        if ((b->b_bufdrv != -1) && b->b_dirty)
+            sync_buffers(b->b_bufdrv);
         flush(b);
+        unhash(x);
+        b->b_bufdrv = -1;
         longjmp_rwabs(0, (long)b->b_bufr, 1, recnum+dmd->m_recoff[buftype], dmd->m_drvnum);
 
         /*
@@ -175,9 +559,14 @@ doio:   for (p = *(q = phdr); p->b_link; p = *(q = &p->b_link))
         b->b_buftyp = buftype;
         b->b_bufdrv = dmd->m_drvnum;
         b->b_dm = dmd;
+
+        x->x_hash = hash;
+        x->x_hlink = bcb_hash[hash];
+        bcb_hash[hash] = x;
     }
     else
     {   /* use a buffer, but first validate media */
+        b = &x->x_bcb;
         err = Mediach(b->b_bufdrv);
         if (err != 0) {
             if (err == 1) {
@@ -193,18 +582,116 @@ doio:   for (p = *(q = phdr); p->b_link; p = *(q = &p->b_link))
     }
 
     /*
-     *  now put the current buffer at the head of the list
+     *  now put the current buffer at the head of the LRU list
      */
 
-    *q = b->b_link;
-    b->b_link = *phdr;
-    *phdr = b;
+    if (lru_head[list] != x)
+    {
+        lru_unlink(x,list);
+        lru_insert(x,list,TRUE);
+    }
 
     return b;
 }
 
 
 
+#if CONF_BDOS_READAHEAD
+/*
+ * readahead - make sure that data record 'recnum' and as many as possible
+ * of the following 'count'-1 records are in memory
+ *
+ * the records must be consecutive on disk (i.e. they must be within one
+ * cluster).  the records up to the first one that is already in memory
+ * are read by a single Rwabs() into flush_buf, then copied to the least
+ * recently used buffers.  at most readahead_max buffers are used, so a
+ * file being read cannot displace all the directory records.
+ *
+ * NOTE: as for getbcb(), errors are handled via longjmp().
+ */
+void readahead(DMD *dm, RECNO recnum, int count)
+{
+    BCBX *x;
+    BCB *b;
+    UWORD hash;
+    int i, n;
+
+    if (count > readahead_max)
+        count = readahead_max;
+
+    for (n = 0; n < count; n++)
+        if (findbuf(dm,BT_DATA,recnum+n))
+            break;
+
+    if (n < 2)          /* nothing to gain over getbcb() */
+        return;
+
+    KDEBUG(("readahead(%d): %d records from 0x%lx\n",dm->m_drvnum,n,recnum));
+
+    /*
+     * the buffers that will be reused must be clean.  sync_buffers() may
+     * reorder the LRU list (on FAT32, it may read the FSInfo sector into
+     * a dir/data buffer), so we start again after each call.  this must
+     * be done before the read, since sync_buffers() also uses flush_buf.
+     */
+restart:
+    for (i = 0, x = lru_tail[BI_DATA]; i < n; i++, x = x->x_prev)
+    {
+        b = &x->x_bcb;
+        if ((b->b_bufdrv != -1) && b->b_dirty)
+        {
+            sync_buffers(b->b_bufdrv);
+            goto restart;
+        }
+    }
+
+    longjmp_rwabs(0, (long)flush_buf, n, recnum+dm->m_recoff[BT_DATA], dm->m_drvnum);
+
+    /*
+     * fill the buffers last record first, so that 'recnum' ends up as
+     * the most recently used.  the LRU list has not changed since the
+     * loop above, so these are the 'n' clean buffers checked there.
+     */
+    for (i = n-1; i >= 0; i--)
+    {
+        x = lru_tail[BI_DATA];
+        b = &x->x_bcb;
+        unhash(x);
+        memcpy(b->b_bufr,flush_buf+((LONG)i<<dm->m_rblog),dm->m_recsiz);
+
+        b->b_bufrec = recnum + i;
+        b->b_dirty = 0;
+        b->b_buftyp = BT_DATA;
+        b->b_bufdrv = dm->m_drvnum;
+        b->b_dm = dm;
+
+        hash = BCB_HASH(dm->m_drvnum,BT_DATA,b->b_bufrec);
+        x->x_hash = hash;
+        x->x_hlink = bcb_hash[hash];
+        bcb_hash[hash] = x;
+
+        lru_unlink(x,BI_DATA);
+        lru_insert(x,BI_DATA,TRUE);
+    }
+}
+#endif
+
+
+
+/*
+ * mark_dirty - mark a buffer as modified
+ */
+static void mark_dirty(BCB *b)
+{
+    b->b_dirty = 1;
+    if (!dirty_pending)
+    {
+        dirty_pending = TRUE;
+        dirty_time = hz_200;
+    }
+}
+
+
 /*
  * getrec - return the ptr to the buffer containing the desired record
  */
@@ -231,7 +718,28 @@ char *getrec(RECNO recn, OFD *of, int wrtflg)
      * if we are writing to the buffer, dirty it
      */
     if (wrtflg)
-        b->b_dirty = 1;
+        mark_dirty(b);
+
+    return b->b_bufr;
+}
+
+
+#if CONF_WITH_FAT32
+/*
+ * getsysrec - return the ptr to the buffer containing record 'recn' of
+ * the reserved area at the start of a FAT32 drive (e.g. the FSInfo sector)
+ *
+ * this uses BT_ROOT buffers, since there is no fixed root directory area
+ * on FAT32, and the record offset for BT_ROOT is set to zero
+ */
+char *getsysrec(DMD *dm, RECNO recn, int wrtflg)
+{
+    BCB *b;
+
+    b = getbcb(dm,BT_ROOT,recn);
+    if (wrtflg)
+        mark_dirty(b);
 
     return b->b_bufr;
 }
+#endif
@@ -135,12 +135,18 @@
 
 #define ROOT_PSEUDO_CLUSTER 1   /* see comments in xrename() */
 
+/*
+ * for a subdirectory, the cluster number in the DTA is split between
+ * dt_clnum (low word) and bits 31-5 of dt_offset_drive (high bits, only
+ * non-zero on FAT32)
+ */
+#define DTA_CLHI(cl)    (((ULONG)(cl) >> 16) << 5)
+#define DTA_CLUSTER(dt) ((CLNO)((((dt)->dt_offset_drive & ~DTA_DRIVEMASK) << 11) | (dt)->dt_clnum))
+
 /*
  * forward prototypes
  */
 static int namlen(char *s11);
-static char *packit(char *s, char *d);
-static void unpackit(const char *src, char *dst);
 static char *dopath(DND *p, char *buf, int *len);
 static DND *makdnd(DND *p, FCB *b);
 static DND *dcrack(const char **np);
@@ -168,6 +174,68 @@ static const char dots[22] = ".          ";
  */
 static LONG freed_dnds, freed_ofds; /* count of DNDs & OFDs made available */
 
+#if CONF_WITH_DIRINDEX
+/*
+ *  directory name indexes
+ *
+ *  for a large directory, scan() can find an exact 8.3 name via a hash
+ *  index of the names to their entry numbers, rather than reading every
+ *  entry.  the index is built on the first such lookup in the directory,
+ *  and is discarded whenever an entry is created, deleted or renamed.
+ *  DNDs must fit in the OS memory pool, so the indexes are kept in a
+ *  small table, and the least recently used one is replaced when needed.
+ *
+ *  an index is allocated from the memory pools, and may stay there for
+ *  a long time, so DIRINDEX_MAX limits its size to avoid breaking up
+ *  user memory: each index takes at most 16KB (4096 entries + 4096
+ *  chains), i.e. 64KB for all of them.  bigger directories are scanned.
+ */
+#define NUM_DIRINDEXES  4
+#define DIRINDEX_MIN    128     /* smaller directories are not indexed */
+#define DIRINDEX_MAX    4096L   /* nor are bigger ones (see above) */
+
+typedef struct {
+    DND   *x_dnd;               /* directory, NULL if unused */
+    DMD   *x_dmd;               /* with its drive & start cluster, */
+    CLNO  x_strtcl;             /*  in case the DND has been reused */
+    UWORD x_stamp;              /* for LRU replacement */
+    UWORD x_mask;               /* number of hash chains - 1 */
+    UWORD *x_head;              /* first entry number+1 in each chain */
+    UWORD *x_next;              /* next entry number+1 in same chain */
+} DIRINDEX;
+
+static DIRINDEX dirindex[NUM_DIRINDEXES];
+static UWORD dirindex_clock;
+static jmp_buf bakbuf;          /* longjmp buffer for dirindex_build() */
+#endif
+
+#if CONF_WITH_DNDCACHE
+/*
+ *  directory node cache
+ *
+ *  the DNDs that makdnd() creates are also linked into a hash table
+ *  keyed by parent & name, so that getdnd() need not walk long sibling
+ *  chains.  once DNDCACHE_MAX of them exist, makdnd() frees the least
+ *  recently used one that is not in use before allocating another, so
+ *  that deep or wide directory trees do not fill up the OS memory pool.
+ *  DNDs returned by findit() during the current BDOS call are never
+ *  reclaimed, since the caller may still hold pointers to them.
+ */
+#define DNDCACHE_HASH   64      /* number of hash chains, a power of 2 */
+#define DNDCACHE_MAX    64      /* DNDs kept before reclaiming */
+
+static DND *dndhash[DNDCACHE_HASH];
+static WORD dndcount;           /* number of DNDs in dndhash[] */
+static UWORD dnd_clock;         /* for LRU reclamation */
+static UWORD dnd_epoch;         /* value of dnd_clock at start of call */
+
+static DND **dndcache_chain(const DND *parent, const char *name);
+static void dndcache_add(DND *dnd);
+static void dndcache_remove(DND *dnd);
+static BOOL dnd_reclaimable(DND *dnd);
+static void dndcache_reclaim(DND *p);
+#endif
+
 
 /*
  *  namlen - parameter points to a character string of 11 bytes max
@@ -202,7 +270,7 @@ long xmkdir(char *s)
     OFD *fd,*f0;
     FCB *b;
     DND *dn;
-    int h,cl,plen;
+    int h,plen;
     long rc;
 
     if ((h = rc = ixcreat(s,FA_SUBDIR)) < 0)
@@ -245,9 +313,7 @@ long xmkdir(char *s)
     memcpy(f2, dots, 22);
     f2->f_attrib = FA_SUBDIR;
     f2->f_td = f0->o_td;            /* time/date are little-endian */
-    cl = f0->o_strtcl;
-    swpw(cl);
-    f2->f_clust = cl;
+    setfcbcl(f2,f0->o_strtcl);
     f2->f_fileln = 0;
     f2++;
 
@@ -256,22 +322,22 @@ long xmkdir(char *s)
     f2->f_name[1] = '.';           /* This is .. */
     f2->f_attrib = FA_SUBDIR;
     /* if creating a folder in the root, the parent entry needs special handling */
-    if (!fd->o_dnode)
+    if (!f->o_dnode->d_parent)
     {
         f2->f_td.time = 0;          /* time/date of parent must be zero */
         f2->f_td.date = 0;
-        f2->f_clust = 0;            /* cluster number is zero too */
+        setfcbcl(f2,0);             /* cluster number is zero too (even on FAT32) */
     }
     else
     {
         f2->f_td = f->o_dirfil->o_td;   /* time/date are little-endian */
-        f2->f_clust = f->o_dirfil->o_strtcl;
-        swpw(f2->f_clust);
+        setfcbcl(f2,f->o_dirfil->o_strtcl);
     }
     f2->f_fileln = 0;
     memcpy(f, f0, sizeof(OFD));
     f->o_flag |= O_DIRTY;
     ixclose(f,CL_DIR | CL_FULL);    /* force flush and write */
+    release_extents(f);
     xmfreblk(f);
     sft[h-NUMSTD].f_own = 0;
     sft[h-NUMSTD].f_ofd = 0;
@@ -358,8 +424,17 @@ long xrmdir(char *p)
     /*
      * next, we free up the OFD (if it exists) and our DND
      */
+#if CONF_WITH_DIRINDEX
+    discard_dirindex(d->d_drv,d);
+#endif
+#if CONF_WITH_DNDCACHE
+    dndcache_remove(d);
+#endif
     if (d->d_ofd)
+    {
+        release_extents(d->d_ofd);
         xmfreblk(d->d_ofd);
+    }
 
     d1 = d->d_parent;
     xmfreblk(d);
@@ -469,9 +544,9 @@ long ixsfirst(char *name, WORD att, DTAINFO *addr)
         }
         else
         {
-            addr->dt_offset_drive = 0L;
+            addr->dt_offset_drive = DTA_CLHI(ofd->o_curcl);
             addr->dt_cloffset = ofd->o_curbyt;
-            addr->dt_clnum = ofd->o_curcl;
+            addr->dt_clnum = (UWORD)ofd->o_curcl;
         }
         addr->dt_offset_drive |= dn->d_drv->m_drvnum & DTA_DRIVEMASK;
         addr->dt_attr = att;
@@ -480,6 +555,11 @@ long ixsfirst(char *name, WORD att, DTAINFO *addr)
                 name,att,addr,addr->dt_offset_drive,addr->dt_cloffset,addr->dt_clnum));
 
         makbuf(f, addr);
+
+#if CONF_WITH_VFAT
+        if (lfn_is_long(s))             /* a long name can only match */
+            addr->dt_offset_drive = -1L;/*  once (see xsnext())       */
+#endif
     }
 
     return E_OK;
@@ -550,9 +630,12 @@ static FCB *ixsnext(DTAINFO *dt)
     dmd = drvtbl[drive];
 
     /*
-     * determine starting point
+     * determine starting point.  there is no fixed root directory area
+     * on FAT32, so the high bits of dt_offset_drive are always part of
+     * the cluster number, and a zero low word is a valid subdirectory.
      */
-    if ((dt->dt_cloffset == 0) && (dt->dt_clnum == 0))
+    if ((dt->dt_cloffset == 0) && (dt->dt_clnum == 0)
+     && (!(dmd->m_32 & M32_FAT32) || (DTA_CLUSTER(dt) == 0)))
     {
         buftype = BT_ROOT;
         offset = dt->dt_offset_drive & ~DTA_DRIVEMASK;
@@ -564,7 +647,7 @@ static FCB *ixsnext(DTAINFO *dt)
     {
         buftype = BT_DATA;
         offset = dt->dt_cloffset;       /* within cluster */
-        cluster = dt->dt_clnum;
+        cluster = DTA_CLUSTER(dt);
         recnum = cl2rec(cluster,dmd) + (offset >> dmd->m_rblog);
         offset &= dmd->m_rbm;           /* within record */
     }
@@ -624,7 +707,8 @@ static FCB *ixsnext(DTAINFO *dt)
     else
     {
         dt->dt_cloffset = ((recnum&dmd->m_clrm) << dmd->m_rblog) + offset;
-        dt->dt_clnum = cluster;
+        dt->dt_clnum = (UWORD)cluster;
+        dt->dt_offset_drive = DTA_CLHI(cluster) | dmd->m_drvnum;
     }
 
     return fcb;
@@ -828,7 +912,7 @@ void builds(const char *s1, char *s2)
 /*
  *  is_subdir: check if directory 2 is an immediate subdirectory of directory 1
  *
- *  s1      name of directory 1
+ *  s1      name of directory 1, in directory format
  *  dn1     DND of directory containing directory 1
  *  dn2     DND of directory containing directory 2
  *
@@ -836,14 +920,10 @@ void builds(const char *s1, char *s2)
  */
 static BOOL is_subdir(const char *s1,DND *dn1, DND *dn2)
 {
-    char s2[LEN_ZFNAME];
-
     if (dn2->d_parent != dn1)
         return FALSE;
 
-    packit(dn2->d_name,s2);
-
-    return strncasecmp(s1,s2,LEN_ZFNAME) ? FALSE : TRUE;
+    return strncasecmp(s1,dn2->d_name,11) ? FALSE : TRUE;
 }
 
 
@@ -884,10 +964,10 @@ long xrename(int n, char *p1, char *p2)
     DMD *dmd1, *dmd2;
     CLNO strtcl1, strtcl2, temp;
     const char *s1, *s2;
-    char buf[11], att;
+    char buf[11], oldname[11], att;
     int hnew;
     long posp;
-    UWORD filetime, filedate;
+    UWORD filetime, filedate, w;
     CLNO clust;
     LONG fileln;
 
@@ -928,14 +1008,14 @@ long xrename(int n, char *p1, char *p2)
     fd = dn1->d_ofd;
     posp -= 32;                 /* adjust to start of FCB */
 
-    /* get old attribute & time/date/cluster/length */
+    /* get old name & attribute & time/date/cluster/length */
+    memcpy(oldname,f->f_name,11);
     att = f->f_attrib;
     filetime = f->f_td.time;
     swpw(filetime);             /* convert from little-endian format */
     filedate = f->f_td.date;
     swpw(filedate);
-    clust = f->f_clust;
-    swpw(clust);
+    clust = getfcbcl(f,dmd1);
     fileln = f->f_fileln;
     swpl(fileln);
 
@@ -969,16 +1049,21 @@ long xrename(int n, char *p1, char *p2)
         return ENSAME;
 
     /*
-     * check for cross-directory rename
+     * check for cross-directory rename.  renaming to a long name is
+     * handled the same way, since it needs a new run of entries.
      */
+#if CONF_WITH_VFAT
+    if ((strtcl1 != strtcl2) || lfn_is_long(s2))
+#else
     if (strtcl1 != strtcl2)
+#endif
     {
         OFD *fd2, *fdparent;
 
         /*
          * prevent invalid renames such as 0 -> 0\2 or a\b -> a\b\c
          */
-        if (is_subdir(s1,dn1,dn2))
+        if (is_subdir(oldname,dn1,dn2))
             return EACCDN;
 
         /* create new directory entry with old info.  even if
@@ -1004,6 +1089,9 @@ long xrename(int n, char *p1, char *p2)
             KDEBUG(("xrename(): can't erase old entry\n"));
             return EACCDN;
         }
+#if CONF_WITH_VFAT
+        lfn_erase(fd,posp,lfn_checksum(oldname));
+#endif
 
         /* copy the time/date/cluster/length to the OFD */
         swpcopyw(&filetime,&fd2->o_td.time);    /* must be little-endian! */
@@ -1026,12 +1114,22 @@ long xrename(int n, char *p1, char *p2)
             if (!fd2->o_dnode->d_name[0])   /* empty name means root */
                 temp = 0;
             else temp = fdparent->o_strtcl; /* else real start cluster */
-            swpw(temp);                     /* convert to disk format */
-            if (update_fcb(fd2,32+26,2L,(BYTE *)&temp) < 0)
+            w = (UWORD)temp;
+            swpw(w);                        /* convert to disk format */
+            if (update_fcb(fd2,32+26,2L,(BYTE *)&w) < 0)
+            {
+                KDEBUG(("xrename(): can't update .. entry\n"));
+                return EINTRN;
+            }
+#if CONF_WITH_FAT32
+            w = (UWORD)(temp >> 16);        /* high word (FAT32 only) */
+            swpw(w);
+            if (update_fcb(fd2,32+20,2L,(BYTE *)&w) < 0)
             {
                 KDEBUG(("xrename(): can't update .. entry\n"));
                 return EINTRN;
             }
+#endif
 
             /* set attribute for this file in parent directory */
             if (update_fcb(fdparent,fd2->o_dirbyt+11,1L,&att) < 0)
@@ -1043,6 +1141,7 @@ long xrename(int n, char *p1, char *p2)
         fd2->o_flag |= O_DIRTY;
         if (att&FA_SUBDIR) {
             ixclose(fd2,CL_DIR|CL_FULL);    /* force flush & write */
+            release_extents(fd2);
             xmfreblk(fd2);                  /* free OFD */
             sft[hnew-NUMSTD].f_own = 0;     /* free handle */
             sft[hnew-NUMSTD].f_ofd = 0;
@@ -1057,6 +1156,9 @@ long xrename(int n, char *p1, char *p2)
             KDEBUG(("xrename(): can't update FCB with new name\n"));
             return EACCDN;
         }
+#if CONF_WITH_VFAT
+        lfn_erase(fd,posp,lfn_checksum(oldname));  /* old long name */
+#endif
     }
 
     /*
@@ -1065,15 +1167,17 @@ long xrename(int n, char *p1, char *p2)
      */
     if (att&FA_SUBDIR) {
         DND *dnd;
-        char s[LEN_ZFNAME];
-        unpackit(s1,s);         /* s[] = old name for getdnd() lookup */
-        dnd = getdnd(s,dn1);
+        dnd = getdnd(oldname,dn1);
         if (dnd) {
             KDEBUG(("xrename(): delete existing DND @ %p\n",dnd));
             freednd(dnd);
         }
     }
 
+#if CONF_WITH_DIRINDEX
+    discard_dirindex(dmd1,dn1);
+#endif
+
     return ixclose(fd,CL_DIR);
 }
 
@@ -1275,7 +1379,7 @@ FCB *dirinit(DND *dn)
  * into:
  *   NAME.EXT
  */
-static char *packit(char *s, char *d)
+char *packit(char *s, char *d)
 {
     char *s0;
     int i;
@@ -1305,39 +1409,6 @@ static char *packit(char *s, char *d)
 }
 
 
-/*
- * unpackit - more-or-less the reverse of packit()
- * converts a filename of the form
- *   "NAME.EXT"
- * into:
- *   "NAME    EXT"
- */
-static void unpackit(const char *src, char *dst)
-{
-    const char *s;
-    char *d;
-    int i;
-
-    /* initialise destination */
-    memset(dst,' ',11);
-
-    /* process NAME */
-    for (i = 0, s = src, d = dst; (i < 8) && *s && (*s != '.'); i++)
-        *d++ = *s++;
-
-    /* find start of EXT (just in case NAME is >8 chars long) */
-    while(*s)
-        if (*s++ == '.')
-            break;
-
-    /* process EXT */
-    for (i = 0, d = dst+8; (i < 3) && *s; i++)
-        *d++ = *s++;
-
-    *(dst+11) = '\0';
-}
-
-
 /*
  *  dopath -
  *
@@ -1387,7 +1458,10 @@ DND *findit(char *name, const char **sp, int dflag)
 {
     DND *p;
     const char *n;
-    DND *pp, *newp;
+    DND *pp;
+#if !CONF_WITH_DNDCACHE
+    DND *newp;
+#endif
     int i;
     char s[11];
 
@@ -1426,6 +1500,22 @@ DND *findit(char *name, const char **sp, int dflag)
          */
         pp = p;                 /*  save ptr to parent dnd      */
 
+#if CONF_WITH_VFAT
+        if (lfn_is_long(n))     /*  long names are only on disk */
+        {
+            p = dirscan(pp,n);
+            goto scanxt;
+        }
+#endif
+
+#if CONF_WITH_DNDCACHE
+        /*
+         *  look the child up in the DND cache; if it is not there,
+         *  scan the directory, which logs it in
+         */
+        if (!(p = getdnd(s,pp)))
+            p = dirscan(pp,n);
+#else
         if (!(newp = p->d_left))
         {                               /*  [1] [see below]     */
                                         /*  make sure children  */
@@ -1454,8 +1544,13 @@ DND *findit(char *name, const char **sp, int dflag)
             else
                 p = newp;
         }
+#endif
 
     scanxt:
+#if CONF_WITH_DNDCACHE
+    if (p)                      /*  caller may keep a pointer to it */
+        p->d_stamp = ++dnd_clock;
+#endif
     if (*(n = n + i))
         n++;
     else
@@ -1485,6 +1580,203 @@ DND *findit(char *name, const char **sp, int dflag)
  */
 
 
+#if CONF_WITH_DIRINDEX
+
+/*
+ *  dirindex_hash - hash an 8.3 name in directory format
+ */
+static UWORD dirindex_hash(const char *name)
+{
+    UWORD h;
+    int i;
+
+    for (i = 0, h = 0; i < 11; i++)
+        h = (h << 5) + h + toupper(name[i]);
+
+    return h;
+}
+
+
+/*
+ *  dirindex_wild - check if an 8.3 name in directory format contains
+ *  wildcards
+ */
+static BOOL dirindex_wild(const char *name)
+{
+    int i;
+
+    for (i = 0; i < 11; i++)
+        if (name[i] == '?')
+            return TRUE;
+
+    return FALSE;
+}
+
+
+/*
+ *  dirindex_build - build the name index for a directory, replacing
+ *  the index 'x'
+ *
+ *  returns NULL if the directory is too small (or too big) to index,
+ *  or there is not enough memory
+ */
+static DIRINDEX *dirindex_build(DND *dnd, OFD *fd, DIRINDEX *x)
+{
+    FCB *fcb;
+    UWORD *mem;
+    LONG n, nent;
+    UWORD h, nchains;
+
+    /* count the entries up to the end of the directory */
+    ixlseek(fd,0L);
+    for (nent = 0; (nent <= DIRINDEX_MAX) && (fcb = (FCB *)ixread(fd,32L,NULL)) && fcb->f_name[0]; nent++)
+        ;
+
+    if ((nent < DIRINDEX_MIN) || (nent > DIRINDEX_MAX))
+    {
+        dnd->d_flag |= DND_NOINDEX;     /* don't count them again */
+        return NULL;
+    }
+
+    for (nchains = DIRINDEX_MIN; (nchains < nent) && (nchains < 0x8000); nchains <<= 1)
+        ;
+    mem = xmxalloc_os((nchains+nent)*sizeof(UWORD),MX_PREFTTRAM);
+    if (!mem)
+        return NULL;
+    bzero(mem,nchains*sizeof(UWORD));
+
+    if (x->x_dnd)                       /* replace the old index */
+    {
+        xmfree(x->x_head);
+        x->x_dnd = NULL;
+    }
+
+    /* if we get a read error, we must release the index */
+    memcpy(bakbuf,errbuf,sizeof(errbuf));
+    if (setjmp(errbuf))
+    {
+        xmfree(mem);
+        longjmp(bakbuf,1);
+    }
+
+    /*
+     * add the live 8.3 entries to the chains, in order, so that each
+     * chain is in descending order of entry number
+     */
+    ixlseek(fd,0L);
+    for (n = 0; n < nent; n++)
+    {
+        fcb = (FCB *)ixread(fd,32L,NULL);
+        if ((fcb->f_name[0] == (char)ERASE_MARKER) || (fcb->f_attrib == FA_LFN))
+            continue;
+        h = dirindex_hash(fcb->f_name) & (nchains-1);
+        mem[nchains+n] = mem[h];
+        mem[h] = n + 1;
+    }
+
+    memcpy(errbuf,bakbuf,sizeof(errbuf));
+
+    x->x_dnd = dnd;
+    x->x_dmd = dnd->d_drv;
+    x->x_strtcl = dnd->d_strtcl;
+    x->x_mask = nchains - 1;
+    x->x_head = mem;
+    x->x_next = mem + nchains;
+
+    KDEBUG(("dirindex_build(%p): %ld entries, %u chains\n",dnd,nent,nchains));
+
+    return x;
+}
+
+
+/*
+ *  dirindex_get - get the name index for a directory, building it if
+ *  necessary
+ *
+ *  returns NULL if the directory is not indexed
+ */
+static DIRINDEX *dirindex_get(DND *dnd, OFD *fd)
+{
+    DIRINDEX *x, *lru;
+
+    if (dnd->d_flag & DND_NOINDEX)
+        return NULL;
+
+    for (x = lru = dirindex; x < dirindex+NUM_DIRINDEXES; x++)
+    {
+        if ((x->x_dnd == dnd) && (x->x_dmd == dnd->d_drv)
+         && (x->x_strtcl == dnd->d_strtcl))
+            break;
+        if (!x->x_dnd)
+            lru = x;
+        else if (lru->x_dnd
+         && ((UWORD)(dirindex_clock-x->x_stamp) > (UWORD)(dirindex_clock-lru->x_stamp)))
+            lru = x;
+    }
+
+    if (x >= dirindex+NUM_DIRINDEXES)
+        x = dirindex_build(dnd,fd,lru);
+
+    if (x)
+        x->x_stamp = ++dirindex_clock;
+
+    return x;
+}
+
+
+/*
+ *  dirindex_lookup - look up an exact 8.3 name (with attribute) via a
+ *  directory's name index
+ *
+ *  returns a pointer to the first matching FCB (with the directory
+ *  positioned after it, as for a normal scan), or NULL if none matches
+ */
+static FCB *dirindex_lookup(DIRINDEX *x, OFD *fd, char *name)
+{
+    FCB *fcb;
+    UWORD e, found = 0;
+
+    for (e = x->x_head[dirindex_hash(name) & x->x_mask]; e; e = x->x_next[e-1])
+    {
+        ixlseek(fd,(LONG)(e-1)*32);
+        fcb = (FCB *)ixread(fd,32L,NULL);
+        if (fcb && match(name,fcb->f_name))
+            found = e;                  /* chains are in descending order */
+    }
+
+    if (!found)
+        return NULL;
+
+    ixlseek(fd,(LONG)(found-1)*32);
+    return (FCB *)ixread(fd,32L,NULL);
+}
+
+
+/*
+ *  discard_dirindex - discard the name index for a directory, or for
+ *  all directories on a drive if 'dnd' is NULL
+ */
+void discard_dirindex(DMD *dm, DND *dnd)
+{
+    DIRINDEX *x;
+
+    if (dnd)
+        dnd->d_flag &= ~DND_NOINDEX;    /* it may have grown */
+
+    for (x = dirindex; x < dirindex+NUM_DIRINDEXES; x++)
+    {
+        if (!x->x_dnd || (x->x_dmd != dm))
+            continue;
+        if (dnd && (x->x_dnd != dnd))
+            continue;
+        xmfree(x->x_head);
+        x->x_dnd = NULL;
+    }
+}
+
+#endif /* CONF_WITH_DIRINDEX */
+
+
 /*
  *  scan - scan a directory for an entry with the desired name.
  *      scans a directory indicated by a DND.  attributes figure in matching
@@ -1499,6 +1791,12 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
     OFD *fd;
     DND *dnd1;
     BOOL m;                 /*  T: found a matching FCB             */
+#if CONF_WITH_DIRINDEX
+    DIRINDEX *x;
+#endif
+#if CONF_WITH_VFAT
+    BOOL longname;          /*  T: n can only match a long name     */
+#endif
 
     KDEBUG(("scan(%p,'%s',0x%x,%p)\n",dnd,n,att,posp));
 
@@ -1506,6 +1804,20 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
     builds(n,name);         /*  format name into dir format         */
     name[11] = att;
 
+#if CONF_WITH_VFAT
+    /*
+     *  a name that is not a valid 8.3 name can only match the long name
+     *  of an entry.  the long name is collected from its entries as they
+     *  are read, so that we still need only one pass over the directory.
+     */
+    longname = lfn_is_long(n);
+    if (longname)
+    {
+        memset(name,'?',11);    /*  match() now checks attributes only  */
+        lfn_reset();
+    }
+#endif
+
     dnd1 = 0; /* dummy to avoid warning */
 
     /*
@@ -1515,6 +1827,26 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
     if (!(fd = dnd->d_ofd))
         fd = makofd(dnd);   /* makofd() also updates dnd->d_ofd */
 
+#if CONF_WITH_DIRINDEX
+    /*
+     *  an exact 8.3 name searched for from the start of a large directory
+     *  is looked up via the directory's name index
+     */
+    if (((*posp == 0L) || (*posp == -1L)) && (*name != (char)ERASE_MARKER)
+     && !dirindex_wild(name) && (x = dirindex_get(dnd,fd)))
+    {
+        fcb = dirindex_lookup(x,fd,name);
+        if ((m = fcb ? TRUE : FALSE) && (fcb->f_attrib & FA_SUBDIR)
+         && (fcb->f_name[0] != '.'))
+        {
+            dnd1 = getdnd(&fcb->f_name[0], dnd);
+            if (!dnd1)
+                dnd1 = makdnd(dnd,fcb);   /* always succeeds */
+        }
+        goto scanned;
+    }
+#endif
+
     /*
      *  seek to desired starting position.  If posp == -1, then start at
      *  the beginning.
@@ -1526,6 +1858,14 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
      */
     while ((fcb = (FCB *) ixread(fd,32L,NULL)) && (fcb->f_name[0]))
     {
+#if CONF_WITH_VFAT
+        if (longname && (fcb->f_attrib == FA_LFN))
+        {
+            lfn_collect(fcb);
+            continue;
+        }
+#endif
+
         /*
          *  Add New DND.
          *  ( iff after scan ptr && not a .
@@ -1540,10 +1880,18 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
                 dnd1 = makdnd(dnd,fcb);   /* always succeeds */
         }
 
-        if ((m = match(name, fcb->f_name)))
-             break;
+        m = match(name, fcb->f_name);
+#if CONF_WITH_VFAT
+        if (longname && !lfn_match(fcb,n))
+            m = FALSE;
+#endif
+        if (m)
+            break;
     }
 
+#if CONF_WITH_DIRINDEX
+scanned:
+#endif
     KDEBUG(("\n   scan(pos=%ld DND=%p DNDfoundFile=%p name=%s name=%s, %d)",
             (long)fd->o_bytnum,dnd,dnd1,fcb?fcb->f_name:"(null)",name,m));
 
@@ -1579,14 +1927,34 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
  */
 static DND *makdnd(DND *p, FCB *b)
 {
+#if !CONF_WITH_DNDCACHE
     DIRTBL_ENTRY *dt;
-    DND *p1;
     DND **prev;
-    OFD *fd;
     int i;
+#endif
+    DND *p1;
+    OFD *fd;
 
     fd = p->d_ofd;
 
+#if CONF_WITH_DNDCACHE
+    /*
+     *  if the cache is full, free the least recently used DND that
+     *  nobody needs, then allocate a new one
+     */
+    if (dndcount >= DNDCACHE_MAX)
+        dndcache_reclaim(p);
+
+    KDEBUG(("\n makdnd new"));
+
+    p->d_flag |= DND_LOCKED;    /* see makofd() */
+    p1 = MGET(DND); /* MGET(DND) only returns if it succeeds */
+    p->d_flag &= ~DND_LOCKED;
+
+    p1->d_right = p->d_left;
+    p->d_left = p1;
+    p1->d_parent = p;
+#else
     /*
      *  scavenge a DND at this level if we can find one that has not
      *  d_left
@@ -1613,8 +1981,14 @@ static DND *makdnd(DND *p, FCB *b)
                 p1->d_flag = 0;
                 p1->d_scan = 0L;
                 p1->d_files = (OFD *) 0;
+#if CONF_WITH_DIRINDEX
+                discard_dirindex(p1->d_drv,p1);
+#endif
                 if (p1->d_ofd)
+                {
+                    release_extents(p1->d_ofd);
                     xmfreblk(p1->d_ofd);
+                }
                 break;
             }
         }
@@ -1633,18 +2007,21 @@ static DND *makdnd(DND *p, FCB *b)
         p->d_left = p1;
         p1->d_parent = p;
     }
+#endif
 
     /* complete the initialization */
 
     p1->d_ofd = (OFD *) 0;
-    p1->d_strtcl = b->f_clust;
-    swpw(p1->d_strtcl);
+    p1->d_strtcl = getfcbcl(b,p->d_drv);
     p1->d_drv = p->d_drv;
     p1->d_dirfil = fd;
     p1->d_dirpos = fd->o_bytnum - 32;
     p1->d_td.time = b->f_td.time;   /* note: DND time/date are  */
     p1->d_td.date = b->f_td.date;   /*  actually little-endian! */
     memcpy(p1->d_name, b->f_name, 11);
+#if CONF_WITH_DNDCACHE
+    dndcache_add(p1);
+#endif
 
     KDEBUG(("\n makdnd(%p)",p1));
 
@@ -1777,10 +2154,10 @@ static BOOL match(char *s1, char *s2)
     int i;
 
     /*
-     **  skip VFAT long file name entries
+     **  skip VFAT long file name entries (erased ones are free entries)
      */
 
-    if (s2[11] == FA_LFN)
+    if ((s2[11] == FA_LFN) && (*s2 != (char)ERASE_MARKER))
         return FALSE;
 
     /*
@@ -1843,11 +2220,19 @@ static DND *getdnd(char *n, DND *d)
 {
     DND *dnd;
 
+#if CONF_WITH_DNDCACHE
+    for (dnd = *dndcache_chain(d,n); dnd; dnd = dnd->d_hlink)
+    {
+        if ((dnd->d_parent == d) && (strncasecmp(n,dnd->d_name,11) == 0))
+            return dnd;
+    }
+#else
     for (dnd = d->d_left; dnd; dnd = dnd->d_right)
     {
         if (strncasecmp(n,dnd->d_name,11) == 0)
             return dnd;
     }
+#endif
 
     return (DND *)NULL;
 }
@@ -1873,17 +2258,178 @@ static void snipdnd(DND *dnd)
 static void freednd(DND *dn)                    /* M01.01.1031.02 */
 {
     if (dn->d_ofd)                  /* free associated OFD if it's linked */
+    {
+        release_extents(dn->d_ofd);
         xmfreblk(dn->d_ofd);
+    }
 
     snipdnd(dn);                    /* cut this DND out of the chain */
+#if CONF_WITH_DNDCACHE
+    dndcache_remove(dn);            /* and out of the hash table */
+#endif
 
     while (dn->d_left) {            /* is this step really necessary? */
         freednd(dn->d_left);
     }
+#if CONF_WITH_DIRINDEX
+    /* the index is keyed by DND address, which may be reused */
+    discard_dirindex(dn->d_drv,dn);
+#endif
     xmfreblk(dn);                   /* finally free this DND */
 }
 
 
+#if CONF_WITH_DNDCACHE
+
+/*
+ *  dndcache_chain - return the head of the hash chain for the child
+ *  'name' (in directory format) of directory 'parent'
+ */
+static DND **dndcache_chain(const DND *parent, const char *name)
+{
+    UWORD h;
+    int i;
+
+    h = (UWORD)((ULONG)parent >> 6);
+    for (i = 0; i < 11; i++)
+        h = (h << 5) + h + toupper(name[i]);
+
+    return &dndhash[h & (DNDCACHE_HASH-1)];
+}
+
+
+/*
+ *  dndcache_add - add a newly made DND to the cache
+ */
+static void dndcache_add(DND *dnd)
+{
+    DND **chain;
+
+    chain = dndcache_chain(dnd->d_parent,dnd->d_name);
+    dnd->d_hlink = *chain;
+    *chain = dnd;
+    dnd->d_stamp = dnd_epoch - 1;   /* not yet used by findit() */
+    dndcount++;
+}
+
+
+/*
+ *  dndcache_remove - remove a DND from the cache before it is freed
+ *
+ *  the root DNDs are not in the cache, so they are ignored
+ */
+static void dndcache_remove(DND *dnd)
+{
+    DND **prev;
+
+    if (!dnd->d_parent)
+        return;
+
+    for (prev = dndcache_chain(dnd->d_parent,dnd->d_name); *prev; prev = &(*prev)->d_hlink)
+    {
+        if (*prev == dnd)
+        {
+            *prev = dnd->d_hlink;
+            dndcount--;
+            return;
+        }
+    }
+}
+
+
+/*
+ *  dnd_reclaimable - check if a DND may be freed: it must not have
+ *  children, open files or a lock, and must not be a root or anyone's
+ *  current directory
+ */
+static BOOL dnd_reclaimable(DND *dnd)
+{
+    DIRTBL_ENTRY *dt;
+    int i;
+
+    if (dnd->d_left || dnd->d_files || !dnd->d_parent || (dnd->d_flag & DND_LOCKED))
+        return FALSE;
+
+    for (i = 1, dt = dirtbl+1; i < NCURDIR; i++, dt++)
+        if (dt->use && (dt->dnd == dnd))
+            return FALSE;
+
+    return TRUE;
+}
+
+
+/*
+ *  dndcache_reclaim - free the least recently used DND that is not in
+ *  use and has not been returned by findit() during the current BDOS
+ *  call.  'p' is the directory being scanned, which must be kept.
+ */
+static void dndcache_reclaim(DND *p)
+{
+    DND *dnd, *lru;
+    UWORD age, lruage;
+    int i;
+
+    lru = NULL;
+    lruage = (UWORD)(dnd_clock - dnd_epoch);
+
+    for (i = 0; i < DNDCACHE_HASH; i++)
+    {
+        for (dnd = dndhash[i]; dnd; dnd = dnd->d_hlink)
+        {
+            age = (UWORD)(dnd_clock - dnd->d_stamp);
+            if ((age > lruage) && (dnd != p) && dnd_reclaimable(dnd))
+            {
+                lru = dnd;
+                lruage = age;
+            }
+        }
+    }
+
+    if (lru)
+    {
+        KDEBUG(("dndcache_reclaim(): freeing DND @ %p\n",lru));
+        freednd(lru);
+    }
+}
+
+
+/*
+ *  dndcache_newcall - note the start of a BDOS call, so that the DNDs
+ *  used from now on are not reclaimed by makdnd()
+ */
+void dndcache_newcall(void)
+{
+    dnd_epoch = dnd_clock;
+}
+
+
+/*
+ *  discard_dndcache - remove the DNDs of a drive from the cache, before
+ *  its DND tree is freed
+ */
+void discard_dndcache(DMD *dm)
+{
+    DND *dnd, **prev;
+    int i;
+
+    for (i = 0; i < DNDCACHE_HASH; i++)
+    {
+        for (prev = &dndhash[i]; (dnd = *prev); )
+        {
+            if (dnd->d_drv == dm)
+            {
+                *prev = dnd->d_hlink;
+                dndcount--;
+            }
+            else
+                prev = &dnd->d_hlink;
+        }
+    }
+}
+
+#endif /* CONF_WITH_DNDCACHE */
+
+
 /*
  *  makofd - create an OFD for a directory
  *
@@ -1999,10 +2545,19 @@ static void process_dnd_tree(DND *dndstart)
             prev = NULL;
         }
 
+#if CONF_WITH_DNDCACHE
+        dndcache_remove(dnd);
+#endif
+#if CONF_WITH_DIRINDEX
+        /* the index is keyed by DND address, which may be reused */
+        discard_dirindex(dnd->d_drv,dnd);
+#endif
+
         /*
          * now we can free up the DND and any associated OFD
          */
         if (dnd->d_ofd) {
+            release_extents(dnd->d_ofd);
             xmfreblk(dnd->d_ofd);
             freed_ofds++;
         }
@@ -183,12 +183,24 @@ long log_media(BPB *b, int drv)
     OFD *fo, *f;                        /*  M01.01.03   */
     DND *d;
     DMD *dm;
-    unsigned long rsiz, cs, n, fs;
+    unsigned long rsiz, cs, n, fs, fatrec, datrec, numcl;
 
     rsiz = b->recsiz;
     cs = b->clsiz;
     n = b->rdlen;
     fs = b->fsiz;
+    fatrec = b->fatrec;
+    datrec = b->datrec;
+    numcl = b->numcl;
+#if CONF_WITH_FAT32
+    if (b->b_flags & B_32)
+    {
+        fs = b->fsiz32;
+        fatrec = b->fatrec32;
+        datrec = b->datrec32;
+        numcl = b->numcl32;
+    }
+#endif
 
     KDEBUG(("log_media(%p,%i) rsiz=0x%lx, cs=0x%lx, n=0x%lx, fs=0x%lx\n",
             b,drv,rsiz,cs,n,fs));
@@ -215,7 +227,7 @@ long log_media(BPB *b, int drv)
     dm->m_clsiz = cs;                   /*  set cluster size in sectors */
     dm->m_clsizb = b->clsizb;           /*    and in bytes              */
     dm->m_recsiz = rsiz;                /*  set record (sector) size    */
-    dm->m_numcl = b->numcl;             /*  set cluster size in records */
+    dm->m_numcl = numcl;                /*  set cluster size in records */
     dm->m_clrlog = log2ul(cs);          /*    and log of it             */
     dm->m_clrm = (1L<<dm->m_clrlog)-1;  /*      and mask of it          */
     dm->m_rblog = log2ul(rsiz);         /*  set log of bytes/record     */
@@ -230,9 +242,26 @@ long log_media(BPB *b, int drv)
     fo->o_strtcl = 2;                   /*  FAT start pseudo-cluster    */
     fo->o_dmd = dm;                     /*  link with DMD               */
 
-    dm->m_recoff[BT_FAT] = (RECNO)b->fatrec;
-    dm->m_recoff[BT_ROOT] = (RECNO)b->fatrec + fs;
-    dm->m_recoff[BT_DATA] = (RECNO)b->datrec;
+    dm->m_recoff[BT_FAT] = (RECNO)fatrec;
+    dm->m_recoff[BT_ROOT] = (RECNO)fatrec + fs;
+    dm->m_recoff[BT_DATA] = (RECNO)datrec;
+
+#if CONF_WITH_FAT32
+    /*
+     * on FAT32, the root directory is a normal cluster chain, handled
+     * like a subdirectory.  there is no fixed root directory area, so
+     * BT_ROOT records are used for the reserved area (see fs.h).
+     */
+    if (b->b_flags & B_32)
+    {
+        dm->m_32 = M32_FAT32;
+        dm->m_fsinfo = b->fsinfo;
+        f->o_fileln = 0x7fffffffL;      /*  fake size, as for subdirs   */
+        f->o_dnode = d;                 /*  not a pseudo-cluster chain  */
+        d->d_strtcl = f->o_strtcl = b->rootcl;
+        dm->m_recoff[BT_ROOT] = 0;
+    }
+#endif
 
     KDEBUG(("log_media(%i) dm->m_recoff[0-2] = 0x%lx/0x%lx/0x%lx\n",
             drv, dm->m_recoff[0],dm->m_recoff[1],dm->m_recoff[2]));
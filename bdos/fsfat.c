@@ -14,7 +14,66 @@
 #include "portab.h"
 #include "asm.h"
 #include "fs.h"
+#include "mem.h"
 #include "gemerror.h"
+#include "string.h"
+
+
+/*
+ * free cluster bitmap
+ *
+ * for each logged-in drive, a bitmap of free clusters (one bit per
+ * cluster number, set if the cluster is free) is built the first time
+ * that a cluster is allocated or that Dfree() is called.  it is kept
+ * up to date by clfix(), so that allocating a cluster or counting the
+ * free clusters no longer needs to scan the FAT.  the bitmap is freed
+ * along with the DMD when the media changes.
+ *
+ * the bitmap is allocated from the memory pools (it is too big for the
+ * os memory pool), and stays there while the drive is logged in, so
+ * its size is limited to FMAP_MAXSIZE to avoid breaking up user memory:
+ * this covers any FAT12/FAT16 drive, and FAT32 drives of up to 128K
+ * clusters.  for bigger drives, or if there is not enough memory for
+ * the bitmap, we just use the FAT.
+ */
+#define FMAP_MAXSIZE    16384L  /* in bytes, i.e. 128K clusters */
+#define FMAP_BYTE(cl)   ((cl) >> 3)
+#define FMAP_BIT(cl)    (1 << ((cl) & 7))
+
+static jmp_buf bakbuf;          /* longjmp buffer for build_fmap() */
+
+static UBYTE *build_fmap(DMD *dm);
+static CLNO countfree(DMD *dm, UBYTE *map);
+#if CONF_WITH_FAT32
+static void load_fsinfo(DMD *dm);
+#endif
+
+
+/*
+ * fmap_set - update the bitmap entry for cluster 'cl'
+ */
+static void fmap_set(DMD *dm, CLNO cl, BOOL isfree)
+{
+    UBYTE *p = dm->m_fmap + FMAP_BYTE(cl);
+    UBYTE bit = FMAP_BIT(cl);
+
+    if (isfree)
+    {
+        if (!(*p & bit))
+        {
+            *p |= bit;
+            dm->m_freecl++;
+        }
+    }
+    else
+    {
+        if (*p & bit)
+        {
+            *p &= ~bit;
+            dm->m_freecl--;
+        }
+    }
+}
 
 
 
@@ -38,10 +97,49 @@ RECNO cl2rec(CLNO cl, DMD *dm)
 void clfix(CLNO cl, CLNO link, DMD *dm)
 {
     int spans;
-    CLNO f, mask;
+    BOOL isfree;
+    UWORD f, mask, link12;
     LONG offset, recnum;
     char *buf;
 
+    isfree = (link == FREECLUSTER);
+
+#if CONF_WITH_FAT32
+    /*
+     * handle 32-bit FAT
+     * entries are longword-aligned and the top 4 bits must be preserved
+     */
+    if (dm->m_32)
+    {
+        ULONG f32;
+
+        offset = (LONG)cl << 2;
+        recnum = offset >> dm->m_rblog;
+        offset &= dm->m_rbm;
+
+        buf = getrec(recnum,dm->m_fatofd,1) + offset;
+        f32 = *(ULONG *)buf;
+        swpl(f32);
+
+        if (dm->m_fmap)
+            fmap_set(dm,cl,isfree);
+        else if (dm->m_32 & M32_FREEVALID)  /* keep the count in step */
+        {
+            if (isfree && (f32 & 0x0fffffffL))
+                dm->m_freecl++;
+            else if (!isfree && !(f32 & 0x0fffffffL))
+                dm->m_freecl--;
+        }
+        if (dm->m_32 & M32_FSIVALID)
+            dm->m_32 |= M32_FSIDIRTY;
+
+        f32 = (f32 & 0xf0000000L) | (link & 0x0fffffffL);
+        swpl(f32);
+        *(ULONG *)buf = f32;
+        return;
+    }
+#endif
+
     offset = dm->m_16 ? (LONG)cl << 1 : ((LONG)cl + (cl >> 1));
     recnum = offset >> dm->m_rblog;
     offset &= dm->m_rbm;
@@ -53,8 +151,11 @@ void clfix(CLNO cl, CLNO link, DMD *dm)
     if (dm->m_16)
     {
         buf = getrec(recnum,dm->m_fatofd,1);
-        swpw(link);
-        *(CLNO *)(buf+offset) = link;
+        if (dm->m_fmap)
+            fmap_set(dm,cl,isfree);
+        f = (UWORD)link;
+        swpw(f);
+        *(UWORD *)(buf+offset) = f;
         return;
     }
 
@@ -63,12 +164,12 @@ void clfix(CLNO cl, CLNO link, DMD *dm)
      */
     if (cl & 1)
     {
-        link = link << 4;
+        link12 = (UWORD)(link << 4);
         mask = 0x000f;
     }
     else
     {
-        link = link & 0x0fff;
+        link12 = (UWORD)link & 0x0fff;
         mask = 0xf000;
     }
 
@@ -83,7 +184,7 @@ void clfix(CLNO cl, CLNO link, DMD *dm)
 
     /* update */
     swpw(f);
-    f = (f & mask) | link;
+    f = (f & mask) | link12;
     swpw(f);
 
     /* write back */
@@ -92,6 +193,9 @@ void clfix(CLNO cl, CLNO link, DMD *dm)
     if (spans)
         buf = getrec(recnum+1,dm->m_fatofd,1);
     *(UBYTE *)buf = LOBYTE(f);
+
+    if (dm->m_fmap)
+        fmap_set(dm,cl,isfree);
 }
 
 
@@ -99,19 +203,39 @@ void clfix(CLNO cl, CLNO link, DMD *dm)
 **  getrealcl -
 **      get the contents of the fat entry indexed by 'cl'.
 **
-**  returns 16-bit value
-**      for FAT12: 0xffff if entry contains the end of file marker
-**                 otherwise, the contents of the entry
-**      for FAT16: the contents of the entry
+**  returns
+**      ENDOFCHAIN if entry contains an end of file marker
+**      otherwise, the contents of the entry (for FAT32, only
+**      the low 28 bits)
 **
 **      M01.0.1.03
 */
 CLNO getrealcl(CLNO cl, DMD *dm)
 {
-    CLNO f;
+    UWORD f;
     LONG offset, recnum;
     char *buf;
 
+#if CONF_WITH_FAT32
+    /*
+     * handle 32-bit FAT
+     */
+    if (dm->m_32)
+    {
+        ULONG f32;
+
+        offset = (LONG)cl << 2;
+        recnum = offset >> dm->m_rblog;
+        offset &= dm->m_rbm;
+        f32 = *(ULONG *)(getrec(recnum,dm->m_fatofd,0) + offset);
+        swpl(f32);
+        f32 &= 0x0fffffffL;
+        if (f32 >= 0x0ffffff8L)     /* handle end of chain */
+            f32 = ENDOFCHAIN;
+        return f32;
+    }
+#endif
+
     offset = dm->m_16 ? (LONG)cl << 1 : ((LONG)cl + (cl >> 1));
     recnum = offset >> dm->m_rblog;
     offset &= dm->m_rbm;
@@ -123,8 +247,12 @@ CLNO getrealcl(CLNO cl, DMD *dm)
      */
     if (dm->m_16)
     {
-        f = *(CLNO *)buf;
+        f = *(UWORD *)buf;
         swpw(f);
+#if CONF_WITH_FAT32
+        if (f >= 0xfff8)            /* handle end of chain */
+            return ENDOFCHAIN;
+#endif
         return f;
     }
 
@@ -139,14 +267,14 @@ CLNO getrealcl(CLNO cl, DMD *dm)
     swpw(f);
 
     if (cl & 1)
-        cl = f >> 4;
+        f >>= 4;
     else
-        cl = f & 0x0fff;
+        f &= 0x0fff;
 
-    if ((cl&0x0ff8) == 0x0ff8)  /* handle end of chain */
-        cl = ENDOFCHAIN;
+    if ((f&0x0ff8) == 0x0ff8)   /* handle end of chain */
+        return ENDOFCHAIN;
 
-    return cl;
+    return f;
 }
 
 
@@ -168,6 +296,433 @@ CLNO getclnum(CLNO cl, OFD *of)
 }
 
 
+/*
+ * getfcbcl - get the starting cluster number from a directory entry
+ *
+ * the high word is ignored except on FAT32, since other systems may
+ * use it for something else on FAT12/FAT16
+ */
+CLNO getfcbcl(const FCB *f, const DMD *dm)
+{
+    UWORD lo;
+
+    lo = f->f_clust;
+    swpw(lo);
+#if CONF_WITH_FAT32
+    if (dm->m_32)
+    {
+        UWORD hi = f->f_clusthi;
+        swpw(hi);
+        return MAKE_ULONG(hi,lo);
+    }
+#endif
+
+    return lo;
+}
+
+
+/*
+ * setfcbcl - set the starting cluster number in a directory entry
+ */
+void setfcbcl(FCB *f, CLNO cl)
+{
+    UWORD w;
+
+    w = (UWORD)cl;
+    swpw(w);
+    f->f_clust = w;
+#if CONF_WITH_FAT32
+    w = (UWORD)(cl >> 16);
+    swpw(w);
+    f->f_clusthi = w;
+#endif
+}
+
+
+/*
+ * cluster run (extent) cache
+ *
+ * to avoid following the FAT chain from the start of a file for every
+ * seek, the runs of consecutive clusters found so far in the chain of
+ * an open file or directory are remembered in an extent list, in
+ * ascending order of position within the file.  the list is extended
+ * as the chain is followed by nextcl() or seekcl().  when the list is
+ * full, further clusters are found from the FAT as before.
+ *
+ * there is a small, fixed number of lists: when none is free, the one
+ * used least recently is taken over.  a list is only used by an OFD if
+ * it still belongs to that OFD and the starting cluster is unchanged.
+ * every OFD must be passed to release_extents() before it is freed:
+ * otherwise its list is not free for reuse until it is taken over.
+ */
+#define NUM_EXTLISTS    8       /* number of extent lists */
+#define NUM_EXTENTS     16      /* max number of extents per list */
+
+typedef struct
+{
+    CLNO  e_index;      /* position in chain of first cluster (0 = first) */
+    CLNO  e_start;      /* first cluster number */
+    CLNO  e_len;        /* number of clusters */
+} EXTENT;
+
+typedef struct _extlist EXTLIST;
+struct _extlist
+{
+    OFD   *x_ofd;       /* owner, or NULL if free */
+    CLNO  x_strtcl;     /* starting cluster of file when list was built */
+    WORD  x_count;      /* number of extents in use */
+    ULONG x_stamp;      /* time of last use, for LRU replacement */
+    EXTENT x_ext[NUM_EXTENTS];
+};
+
+static EXTLIST extlist[NUM_EXTLISTS];
+static ULONG ext_clock;
+
+
+/*
+ * ext_get - get the extent list for an OFD
+ *
+ * if it has none and 'create' is set, a list is assigned to it containing
+ * just the first cluster.  returns NULL if there is no list (or if the OFD
+ * is for the FAT/root, which use pseudo-clusters).
+ */
+static EXTLIST *ext_get(OFD *p, BOOL create)
+{
+    EXTLIST *x, *y;
+
+    if (!p->o_dnode || !p->o_strtcl)
+        return NULL;
+
+    x = p->o_ext;
+    if (!x || (x->x_ofd != p) || (x->x_strtcl != p->o_strtcl))
+    {
+        if (!create)
+            return NULL;
+
+        for (x = y = extlist; y < extlist+NUM_EXTLISTS; y++)
+        {
+            if (!y->x_ofd)
+            {
+                x = y;
+                break;
+            }
+            if (y->x_stamp < x->x_stamp)
+                x = y;
+        }
+
+        x->x_ofd = p;
+        x->x_strtcl = p->o_strtcl;
+        x->x_count = 1;
+        x->x_ext[0].e_index = 0;
+        x->x_ext[0].e_start = p->o_strtcl;
+        x->x_ext[0].e_len = 1;
+        p->o_ext = x;
+    }
+
+    x->x_stamp = ++ext_clock;
+
+    return x;
+}
+
+
+/*
+ * ext_append - record that cluster 'next' follows cluster 'cl' in the
+ * chain, if 'cl' is the last cluster in the extent list
+ */
+static void ext_append(EXTLIST *x, CLNO cl, CLNO next)
+{
+    EXTENT *e = &x->x_ext[x->x_count-1];
+
+    if (e->e_start+e->e_len-1 != cl)
+        return;
+
+    if (next == cl+1)
+    {
+        e->e_len++;
+        return;
+    }
+
+    if (x->x_count >= NUM_EXTENTS)
+        return;
+
+    e[1].e_index = e->e_index + e->e_len;
+    e[1].e_start = next;
+    e[1].e_len = 1;
+    x->x_count++;
+}
+
+
+/*
+ * ext_next - return the cluster following 'cl', or 0 if unknown
+ */
+static CLNO ext_next(EXTLIST *x, CLNO cl)
+{
+    EXTENT *e, *last = x->x_ext + x->x_count - 1;
+
+    for (e = x->x_ext; e <= last; e++)
+    {
+        if ((cl >= e->e_start) && (cl < e->e_start+e->e_len))
+        {
+            if (cl < e->e_start+e->e_len-1)
+                return cl + 1;
+            return (e < last) ? e[1].e_start : 0;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * release_extents - free the extent list of an OFD that is being freed
+ */
+void release_extents(OFD *p)
+{
+    EXTLIST *x = p->o_ext;
+
+    if (x && (x->x_ofd == p))
+        x->x_ofd = NULL;
+    p->o_ext = NULL;
+}
+
+
+/*
+**  seekcl -
+**      get the cluster number of cluster 'idx' (0 = first) in the chain
+**      for the file.  if 'curcl' is non-zero, it is cluster 'curidx' of
+**      the chain and may be used as a starting point.
+**
+**  returns
+**      ENDOFCHAIN if the chain is too short
+**
+*/
+CLNO seekcl(OFD *p, CLNO idx, CLNO curidx, CLNO curcl)
+{
+    EXTLIST *x;
+    EXTENT *e;
+    CLNO i, cl, next;
+    WORD lo, hi, mid;
+
+    if (!p->o_dnode)            /* if no dir node, must be FAT/root */
+        return p->o_strtcl + idx;
+
+    x = ext_get(p,TRUE);
+    if (x)
+    {
+        /*
+         * binary search for the last extent starting at or before 'idx'
+         */
+        for (lo = 0, hi = x->x_count-1; lo < hi; )
+        {
+            mid = (lo + hi + 1) / 2;
+            if (x->x_ext[mid].e_index <= idx)
+                lo = mid;
+            else hi = mid - 1;
+        }
+        e = &x->x_ext[lo];
+        if (idx < e->e_index+e->e_len)
+            return e->e_start + (idx - e->e_index);
+
+        /* beyond the end of the list: continue from its last cluster */
+        i = e->e_index + e->e_len - 1;
+        cl = e->e_start + e->e_len - 1;
+    }
+    else
+    {
+        i = 0;
+        cl = p->o_strtcl;
+    }
+
+    if (curcl && (curidx > i) && (curidx <= idx))
+    {
+        i = curidx;
+        cl = curcl;
+    }
+
+    for ( ; i < idx; i++)
+    {
+        next = getrealcl(cl,p->o_dmd);
+        if (endofchain(next))
+            return ENDOFCHAIN;
+        if (x)
+            ext_append(x,cl,next);
+        cl = next;
+    }
+
+    return cl;
+}
+
+
+/*
+ * discard_fmap - free the free cluster bitmap for a drive
+ *
+ * it will be rebuilt from the FAT when next needed
+ */
+void discard_fmap(DMD *dm)
+{
+    if (dm->m_fmap)
+    {
+        xmfree(dm->m_fmap);
+        dm->m_fmap = NULL;
+    }
+    dm->m_32 &= ~M32_FREEVALID; /* the count may be wrong too */
+}
+
+
+/*
+ * fmap_search - search the free cluster bitmap for a free cluster
+ * in the range [first,last)
+ *
+ * returns 0 if there is none
+ */
+static CLNO fmap_search(const UBYTE *map, ULONG first, ULONG last)
+{
+    ULONG cl;
+
+    for (cl = first; cl < last; )
+    {
+        if (((cl & 31) == 0) && !*(const ULONG *)(map+FMAP_BYTE(cl)))
+        {
+            cl += 32;           /* skip 32 allocated clusters at a time */
+            continue;
+        }
+        if (map[FMAP_BYTE(cl)] & FMAP_BIT(cl))
+            return cl;
+        cl++;
+    }
+
+    return 0;
+}
+
+
+/*
+ * fmap_runlen - return the number of consecutive free clusters starting
+ * at cluster 'cl', up to a maximum of 'max' (and below 'last')
+ */
+static CLNO fmap_runlen(const UBYTE *map, ULONG cl, ULONG last, CLNO max)
+{
+    CLNO n;
+
+    for (n = 0; (n < max) && (cl < last); n++, cl++)
+        if (!(map[FMAP_BYTE(cl)] & FMAP_BIT(cl)))
+            break;
+
+    return n;
+}
+
+
+/*
+ * fmap_findrun - search the free cluster bitmap for a run of 'want' free
+ * clusters in the range [first,last)
+ *
+ * returns the start of the first such run; if there is none, returns
+ * the start of the longest run found (or 0 if there are no free clusters
+ * at all), with the length in *bestlen
+ */
+static CLNO fmap_findrun(const UBYTE *map, ULONG first, ULONG last, CLNO want, CLNO *bestlen)
+{
+    CLNO cl, n, best = 0;
+
+    *bestlen = 0;
+    while ((cl = fmap_search(map,first,last)))
+    {
+        n = fmap_runlen(map,cl,last,want);
+        if (n > *bestlen)
+        {
+            best = cl;
+            *bestlen = n;
+            if (n == want)
+                break;
+        }
+        first = (ULONG)cl + n;
+    }
+
+    return best;
+}
+
+
+/*
+**  findfree -
+**      find a run of up to 'want' contiguous free clusters.  if the
+**      cluster after cluster 'cl' (normally the current last cluster of
+**      the file) is free, the run starts there, to keep files contiguous.
+**      otherwise, the first run of 'want' free clusters is used, starting
+**      the search at the drive's allocation rover; if there is no run
+**      that long, the longest run found is used.
+**
+**      the length of the run is returned in *got; it is always 1 if
+**      there is not enough memory for the free cluster bitmap.
+**
+**  returns
+**      the first cluster number of the run, or 0 if the disk is full
+*/
+static CLNO findfree(DMD *dm, CLNO cl, CLNO want, CLNO *got)
+{
+    CLNO i, rover, n;
+    ULONG maxcl = (ULONG)dm->m_numcl + 2;   /* 1 more than highest cluster */
+    UBYTE *map;
+
+    *got = 1;
+
+#if CONF_WITH_FAT32
+    load_fsinfo(dm);            /* for the initial rover */
+#endif
+    rover = (cl < 2) ? dm->m_rover : cl;
+    if ((rover < 2) || (rover >= maxcl))
+        rover = 2;
+
+    map = build_fmap(dm);
+    if (map)
+    {
+        if (dm->m_freecl == 0)
+            return 0;
+        if (want > dm->m_freecl)
+            want = dm->m_freecl;
+
+        n = 0;
+        if (cl >= 2)
+        {
+            n = fmap_runlen(map,(ULONG)cl+1,maxcl,want);
+            if (n)
+                cl++;
+        }
+        if (!n)
+        {
+            cl = fmap_findrun(map,rover,maxcl,want,&n);
+            if (n < want)
+            {
+                rover = fmap_findrun(map,2,rover,want,&i);
+                if (i > n)
+                {
+                    cl = rover;
+                    n = i;
+                }
+            }
+        }
+        if (!n)
+            return 0;
+
+        dm->m_rover = cl + n - 1;
+        *got = n;
+        return cl;
+    }
+
+    /*
+     * no bitmap, so search the FAT.  the following code carefully
+     * avoids allowing overflow in CLNO variables
+     */
+    for (i = 0; i < dm->m_numcl; i++, rover++)  /* look at every cluster once */
+    {
+        if (!getrealcl(rover,dm))       /* check for empty cluster */
+            return rover;
+        if (rover == dm->m_numcl+1)     /* wrap at max cluster num */
+            rover = 1;
+    }
+
+    return 0;
+}
+
+
 /*
 **  nextcl -
 **      get the cluster number which follows the cluster indicated in the curcl
@@ -179,11 +734,30 @@ CLNO getclnum(CLNO cl, OFD *of)
 **
 */
 int nextcl(OFD *p, int wrtflg)
+{
+    return nextcl_run(p,wrtflg,1);
+}
+
+
+/*
+**  nextcl_run -
+**      like nextcl(), but if we are writing and a new cluster must be
+**      allocated, try to allocate a contiguous run of 'want' clusters
+**      (the number still needed by the caller, including this one) and
+**      link them into the chain in one step.  the following clusters are
+**      then found by subsequent calls to nextcl() in the normal way.
+**
+**  returns
+**      E_OK    if success,
+**      -1      if error
+**
+*/
+int nextcl_run(OFD *p, int wrtflg, CLNO want)
 {
     DMD     *dm;
-    CLNO    i;
-    CLNO    rover;
+    EXTLIST *x;
     CLNO    cl, cl2;                                /*  M01.01.03   */
+    CLNO    i, n;
 
     cl = p->o_curcl;
     dm = p->o_dmd;
@@ -199,40 +773,41 @@ int nextcl(OFD *p, int wrtflg)
     }
     else
     {
-        cl2 = getrealcl(cl,dm);
+        x = ext_get(p,FALSE);
+        if (!x || !(cl2 = ext_next(x,cl)))
+            cl2 = getrealcl(cl,dm);
     }
 
     if (wrtflg && endofchain(cl2))  /* end of file, allocate new clusters */
     {
-        /* the following code carefully avoids allowing overflow in CLNO variables */
-        rover = (cl < 2) ? 2 : cl;  /* start search at first or current cluster */
-        for (i = 0; i < dm->m_numcl; i++, rover++)  /* look at every cluster once */
-        {
-            if (!getrealcl(rover,dm))       /* check for empty cluster */
-                break;
-            if (rover == dm->m_numcl+1)     /* wrap at max cluster num */
-                rover = 1;
-        }
-        cl2 = rover;
+        cl2 = findfree(dm,cl,want ? want : 1,&n);
+        if (!cl2)
+            return -1;
 
-        if (i < dm->m_numcl)
+        /*
+         * link the run, starting from the end so that the chain is
+         * never attached to unallocated clusters
+         */
+        clfix(cl2+n-1,ENDOFCHAIN,dm);
+        for (i = n-1; i > 0; i--)
+            clfix(cl2+i-1,cl2+i,dm);
+        if (cl)
+            clfix(cl,cl2,dm);
+        else
         {
-            clfix(cl2,ENDOFCHAIN,dm);
-            if (cl)
-                clfix(cl,cl2,dm);
-            else
-            {
-                p->o_strtcl = cl2;
-                p->o_flag |= O_DIRTY;
-            }
+            p->o_strtcl = cl2;
+            p->o_flag |= O_DIRTY;
         }
-        else
-            return -1;
     }
 
     if (endofchain(cl2))
         return -1;
 
+    /* remember where the chain goes (this also starts a new list) */
+    x = ext_get(p,TRUE);
+    if (x && cl)
+        ext_append(x,cl,cl2);
+
 retcl:
     p->o_curcl = cl2;
     p->o_currec = cl2rec(cl2,dm);
@@ -243,30 +818,40 @@ retcl:
 
 
 /*
- * countfree16 - fast scan of FAT16 filesystem to count free clusters
+ * countfree - fast scan of FAT16/FAT32 filesystem to count free clusters
+ *
+ * if 'map' is not NULL, the free clusters are also marked in it
  */
-static CLNO countfree16(DMD *dm)
+static CLNO countfree(DMD *dm, UBYTE *map)
 {
-    int recnum, offset;
-    CLNO free, clnum;
+    RECNO recnum;
+    int offset, size;
+    ULONG clnum, maxcl = (ULONG)dm->m_numcl + 2;
+    CLNO free;
     char *buf;
 
-    for (clnum = 2, free = 0; clnum < dm->m_numcl+2; )
+    size = dm->m_32 ? sizeof(ULONG) : sizeof(UWORD);  /* size of FAT entry */
+
+    for (clnum = 2, free = 0; clnum < maxcl; )
     {
         /*
          * get the next FAT record
          */
-        recnum = (clnum * sizeof(CLNO)) >> dm->m_rblog;
-        offset = (clnum * sizeof(CLNO)) & dm->m_rbm;
+        recnum = (clnum * size) >> dm->m_rblog;
+        offset = (clnum * size) & dm->m_rbm;
         buf = getrec(recnum, dm->m_fatofd, 0);
 
         /*
-         * scan the FAT record, counting free slots
+         * scan the FAT record, counting free slots.  for FAT32, the
+         * top 4 bits of the (little-endian) entry are ignored
          */
-        for ( ; (offset < dm->m_recsiz) && (clnum < (dm->m_numcl+2)); offset += sizeof(CLNO), clnum++)
+        for ( ; (offset < dm->m_recsiz) && (clnum < maxcl); offset += size, clnum++)
         {
-            if (*(CLNO *)(buf+offset) == 0)
-                free++;
+            if (size == sizeof(ULONG) ? (*(ULONG *)(buf+offset) & 0xffffff0fL) : *(UWORD *)(buf+offset))
+                continue;
+            free++;
+            if (map)
+                map[FMAP_BYTE(clnum)] |= FMAP_BIT(clnum);
         }
     }
 
@@ -274,14 +859,157 @@ static CLNO countfree16(DMD *dm)
 }
 
 
+/*
+ * build_fmap - build the free cluster bitmap for a drive, if it does
+ * not already exist
+ *
+ * returns a pointer to the bitmap, or NULL if it would be bigger than
+ * FMAP_MAXSIZE or there is not enough memory
+ */
+static UBYTE *build_fmap(DMD *dm)
+{
+    UBYTE *map;
+    CLNO cl, free;
+    LONG size;
+
+    if (dm->m_fmap)
+        return dm->m_fmap;
+
+    /* one bit per cluster number, rounded up to a multiple of 32 */
+    size = (((LONG)dm->m_numcl + 2 + 31) >> 5) * sizeof(ULONG);
+    if (size > FMAP_MAXSIZE)
+        return NULL;
+    map = xmxalloc_os(size,MX_PREFTTRAM);
+    if (!map)
+        return NULL;
+    memset(map,0x00,size);
+
+    /* if we get a read error, we must release the bitmap */
+    memcpy(bakbuf,errbuf,sizeof(errbuf));
+    if (setjmp(errbuf))
+    {
+        xmfree(map);
+        longjmp(bakbuf,1);
+    }
+
+    if (dm->m_16 || dm->m_32)
+        free = countfree(dm,map);
+    else
+    {
+        for (cl = 2, free = 0; cl < dm->m_numcl+2; cl++)
+        {
+            if (!getrealcl(cl,dm))
+            {
+                free++;
+                map[FMAP_BYTE(cl)] |= FMAP_BIT(cl);
+            }
+        }
+    }
+
+    memcpy(errbuf,bakbuf,sizeof(errbuf));
+
+    dm->m_fmap = map;
+    dm->m_freecl = free;
+    if (dm->m_32)                   /* correct the FSInfo count if necessary */
+    {
+        dm->m_32 |= M32_FREEVALID;
+        if (dm->m_32 & M32_FSIVALID)
+            dm->m_32 |= M32_FSIDIRTY;
+    }
+
+    return map;
+}
+
+
+#if CONF_WITH_FAT32
+/*
+ * load_fsinfo - get the free cluster count and the next free cluster
+ * hint from the FSInfo sector of a FAT32 drive, if not yet done
+ *
+ * the values are only hints, so they are checked for sanity
+ */
+static void load_fsinfo(DMD *dm)
+{
+    FSINFO *fsi;
+    ULONG n;
+
+    if (!dm->m_32 || (dm->m_32 & M32_FSILOADED))
+        return;
+
+    dm->m_32 |= M32_FSILOADED;
+    if (!dm->m_fsinfo)
+        return;
+
+    fsi = (FSINFO *)getsysrec(dm,dm->m_fsinfo,0);
+    if ((fsi->fsi_sig1 != FSI_SIG1) || (fsi->fsi_sig2 != FSI_SIG2)
+     || (fsi->fsi_sig3 != FSI_SIG3))
+        return;
+
+    dm->m_32 |= M32_FSIVALID;
+
+    n = fsi->fsi_freecl;
+    swpl(n);
+    if (!dm->m_fmap && (n <= dm->m_numcl))
+    {
+        dm->m_freecl = n;
+        dm->m_32 |= M32_FREEVALID;
+    }
+
+    n = fsi->fsi_nextfree;
+    swpl(n);
+    if ((n >= 2) && (n < (ULONG)dm->m_numcl+2))
+        dm->m_rover = n;
+}
+
+
+/*
+ * sync_fsinfo - update the FSInfo sector of FAT32 drive 'drv' (or
+ * of all FAT32 drives, if 'drv' is negative) if necessary
+ *
+ * this is called by sync_buffers(), before it writes the dirty buffers
+ */
+void sync_fsinfo(int drv)
+{
+    DMD *dm;
+    FSINFO *fsi;
+    ULONG n;
+    int i;
+
+    for (i = 0; i < BLKDEVNUM; i++)
+    {
+        if ((drv >= 0) && (i != drv))
+            continue;
+        dm = drvtbl[i];
+        if (!dm || !(dm->m_32 & M32_FSIDIRTY))
+            continue;
+
+        /* clear the flag first, since getsysrec() may call sync_buffers() */
+        dm->m_32 &= ~M32_FSIDIRTY;
+        fsi = (FSINFO *)getsysrec(dm,dm->m_fsinfo,1);
+
+        n = (dm->m_fmap || (dm->m_32 & M32_FREEVALID)) ? dm->m_freecl : 0xffffffffUL;
+        swpl(n);
+        fsi->fsi_freecl = n;
+
+        n = (dm->m_rover >= 2) ? dm->m_rover : 0xffffffffUL;
+        swpl(n);
+        fsi->fsi_nextfree = n;
+    }
+}
+#endif
+
+
 /*      Function 0x36   d_free
                 get disk free space data into buffer *
         Error returns
                 ERR
 
-        The code is optimised for 16-bit FATs.  The 12-bit case is more
-        complex, since the entry for a cluster can span logical records,
-        and therefore we do it the old, slow way.
+        Normally the count is maintained in the free cluster bitmap (or,
+        for FAT32, initialised from the FSInfo sector).  If there is not
+        enough memory for that, we scan the FAT: the code is optimised for
+        16-bit and 32-bit FATs.  The 12-bit case is more complex, since
+        the entry for a cluster can span logical records, and therefore we
+        do it the old, slow way.
 */
 long xgetfree(long *buf, int drv)
 {
@@ -295,9 +1023,19 @@ long xgetfree(long *buf, int drv)
         return ERR;
 
     dm = drvtbl[n];
-    if (dm->m_16)
+    sync_buffers(n);        /* Dfree() is a convenient point to write buffers */
+
+#if CONF_WITH_FAT32
+    load_fsinfo(dm);
+    if (dm->m_32 & M32_FREEVALID)   /* count from FSInfo, or maintained */
+        free = dm->m_freecl;
+    else
+#endif
+    if (build_fmap(dm))
+        free = dm->m_freecl;
+    else if (dm->m_16 || dm->m_32)
     {
-        free = countfree16(dm);
+        free = countfree(dm,NULL);
     }
     else
     {
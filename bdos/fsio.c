@@ -27,6 +27,18 @@ static void addit(OFD *p, long siz, int flg);
 static long xrw(int wrtflg, OFD *p, long len, char *ubufr);
 static void usrio(int rwflg, int num, long strt, char *ubuf, DMD *dm);
 
+/* TRUE iff BCB 'b' holds one of the 'num' data records from 'strt' */
+#define USRIO_OVERLAP(b,dm,strt,num)                                \
+    (((b)->b_bufdrv == (dm)->m_drvnum) && ((b)->b_buftyp == BT_DATA) \
+     && ((b)->b_bufrec >= (strt)) && ((b)->b_bufrec < (strt)+(num)))
+#if CONF_BDOS_READAHEAD
+static char *seqrec(OFD *p, RECNO recn);
+static void seqio(int num, RECNO strt, char *ubuf, OFD *p);
+#else
+#define seqrec(p,recn)          getrec(recn,p,0)
+#define seqio(num,strt,ubuf,p)  usrio(0,num,strt,ubuf,(p)->o_dmd)
+#endif
+
 
 /*
  * eof - check for end of file
@@ -97,7 +109,7 @@ long    xlseek(long n, int h, int flg)
 
 long ixlseek(OFD *p,long n)
 {
-    CLNO clnum, clx, curnum, i;
+    CLNO clnum, clx, curnum = 0;
     DMD *dm = p->o_dmd;
 
     if ((n < 0) || (n > p->o_fileln))
@@ -115,10 +127,23 @@ long ixlseek(OFD *p,long n)
     clnum = n >> dm->m_clblog;
 
     /*
-     * if that's beyond where we are, we can chain forward;
-     * otherwise, we need to start from the beginning
+     * note: if we're seeking to a position which is at a cluster boundary,
+     * we actually point to the cluster before that.  this unobvious action
+     * is because, when the read point is at the start of a cluster, xrw()
+     * starts its processing by handling whole clusters.  this occurs in
+     * either the middle or tail section processing, but in both cases,
+     * xrw() always chains to the next cluster before doing the actual read.
+     *
+     * see the code in xrw() if you need to know more ...
      */
-    if (p->o_curcl && (n >= p->o_bytnum))   /* OK, we can chain forward */
+    if ((n&dm->m_clbm) == 0)    /* go one less if on cluster boundary */
+        clnum--;
+
+    /*
+     * if we have a current cluster, seekcl() may be able to chain
+     * forward from it
+     */
+    if (p->o_curcl)
     {
         /*
          * calculate the current position in units of 1 cluster
@@ -128,36 +153,19 @@ long ixlseek(OFD *p,long n)
         /*
          * if we're currently at the end of a cluster, we haven't yet read
          * in the cluster that really corresponds to our position, so we
-         * need to allow for that.  See the comments further below for why
-         * we also do this when we're at the beginning of a cluster ...
+         * need to allow for that.  See the comments above for why we also
+         * do this when we're at the beginning of a cluster ...
          */
         if (((p->o_curbyt == 0) || (p->o_curbyt == dm->m_clsizb)) && p->o_bytnum)
             curnum--;
-
-        clnum -= curnum;
-        clx = p->o_curcl;
     }
-    else            /* we have to start at the beginning */
-        clx = p->o_strtcl;
 
     /*
-     * note: if we're seeking to a position which is at a cluster boundary,
-     * we actually point to the cluster before that.  this unobvious action
-     * is because, when the read point is at the start of a cluster, xrw()
-     * starts its processing by handling whole clusters.  this occurs in
-     * either the middle or tail section processing, but in both cases,
-     * xrw() always chains to the next cluster before doing the actual read.
-     *
-     * see the code in xrw() if you need to know more ...
+     * find the cluster, using the extent list for the file if possible
      */
-    if ((n&dm->m_clbm) == 0)    /* go one less if on cluster boundary */
-        clnum--;
-
-    for (i = 0; i < clnum; i++) {
-        clx = getclnum(clx,p);
-        if (endofchain(clx))
-            return EINTRN;      /* FAT chain is shorter than filesize says ... */
-    }
+    clx = seekcl(p,clnum,curnum,p->o_curcl);
+    if (endofchain(clx))
+        return EINTRN;          /* FAT chain is shorter than filesize says ... */
 
     p->o_curcl = clx;
     p->o_currec = cl2rec(clx,dm);
@@ -307,6 +315,12 @@ static void addit(OFD *p, long siz, int flg)
  * between handling of header and tail sections, we do i/o in terms of
  * whole clusters.
  *
+ * A read of less than a cluster that starts where the previous read of
+ * the file ended is treated as sequential: it is done via the buffers,
+ * and the rest of the current cluster is read ahead at the same time,
+ * so that programs reading a file in small pieces do not need one disk
+ * access per record.
+ *
  *  returns
  *      1. nbr of bytes read/written from/to the file, or
  *      2. pointer (see above)
@@ -321,9 +335,11 @@ static long xrw(int wrtflg, OFD *p, long len, char *ubufr)
     RECNO recn, num;
     int hdrrec, lsiz;
     RECNO last, nrecs;                  /* multi-sector variables */
-    int lflg;
+    int lflg, extra;
     long nbyts;
     long rc,bytpos,lenrec,lenmid;
+    char *iobuf = NULL;                 /* user buffer for pending i/o */
+    BOOL seq = FALSE;
 
     /* determine where we currently are in the file */
 
@@ -331,6 +347,12 @@ static long xrw(int wrtflg, OFD *p, long len, char *ubufr)
 
     bytpos = p->o_bytnum;               /*  starting file position      */
 
+#if CONF_BDOS_READAHEAD
+    /* is this a small sequential read of an ordinary file? */
+    if (!wrtflg && ubufr && p->o_dnode && (p != dm->m_fatofd))
+        seq = (bytpos == p->o_seqpos) && (len < dm->m_clsizb);
+#endif
+
     /*
      * get logical record number to start i/o with
      * (bytn will be byte offset into sector # recn)
@@ -349,7 +371,7 @@ static long xrw(int wrtflg, OFD *p, long len, char *ubufr)
         /* #bytes left in current record ) */
 
         lenxfr = min(len,dm->m_recsiz-bytn);
-        bufp = getrec(recn,p,wrtflg);   /* get desired record  */
+        bufp = seq ? seqrec(p,recn) : getrec(recn,p,wrtflg);    /* get desired record  */
         addit(p,(long) lenxfr,1);       /* update ofd          */
         len -= lenxfr;                  /* nbr left to do      */
         recn++;                         /* starting w/ next    */
@@ -372,6 +394,9 @@ static long xrw(int wrtflg, OFD *p, long len, char *ubufr)
     lenmid = len - lentail;             /*  Is there a Middle ? */
     if ( lenmid )
     {
+        last = nrecs = 0L;
+        nbyts = lflg = 0;
+
         hdrrec = recn & dm->m_clrm;
 
         if (hdrrec)
@@ -387,7 +412,20 @@ static long xrw(int wrtflg, OFD *p, long len, char *ubufr)
             if ( hdrrec > lenmid >> dm->m_rblog )       /* M00.14.01 */
                 hdrrec = lenmid >> dm->m_rblog; /* M00.14.01 */
 
-            usrio(wrtflg,hdrrec,recn,ubufr,dm);
+            /*
+             * unless they are read from the buffers, the header records
+             * are left pending, so that they can be transferred by the
+             * same request as the following clusters if these are
+             * contiguous (the file position is updated immediately)
+             */
+            if (seq)
+                seqio(hdrrec,recn,ubufr,p);
+            else
+            {
+                last = recn;
+                nrecs = hdrrec;
+                iobuf = ubufr;
+            }
             ubufr += (lsiz = hdrrec << dm->m_rblog);
             lenmid -= lsiz;
             addit(p,(long) lsiz,1);
@@ -400,12 +438,21 @@ static long xrw(int wrtflg, OFD *p, long len, char *ubufr)
         num = lenrec >> dm->m_clrlog;
         tailrec = lenrec & dm->m_clrm;
 
-        last = nrecs = 0L;
-        nbyts = lflg = 0;
+        if (!nrecs)             /* no header records pending */
+            iobuf = ubufr;
+        else if (!num)          /* no clusters to combine them with */
+            usrio(wrtflg,nrecs,last,iobuf,dm);
+
+        /*
+         * if we are writing, any new clusters needed for the rest of
+         * the request are allocated contiguously if possible (including
+         * the one for the tail records & bytes)
+         */
+        extra = (tailrec || lentail) ? 1 : 0;
 
         while (num--)           /*  for each whole cluster...   */
         {
-            rc = nextcl(p,wrtflg);
+            rc = nextcl_run(p,wrtflg,min(num+1+extra,(RECNO)dm->m_numcl));
 
             /*
              *  if eof or non-contiguous cluster, or last cluster
@@ -424,7 +471,7 @@ static long xrw(int wrtflg, OFD *p, long len, char *ubufr)
                     lflg = 1;
 mulio:
                 if (nrecs)
-                    usrio(wrtflg,nrecs,last,ubufr,dm);
+                    usrio(wrtflg,nrecs,last,iobuf,dm);
                 ubufr += nbyts;
                 addit(p,nbyts,0);
                 if (rc)
@@ -432,6 +479,7 @@ mulio:
                 last = p->o_currec;
                 nrecs = dm->m_clsiz;
                 nbyts = dm->m_clsizb;
+                iobuf = ubufr;
                 if ((!num) && lflg)
                 {
                     lflg = 0;
@@ -448,7 +496,9 @@ mulio:
                 goto eof;
             lsiz = tailrec << dm->m_rblog;
             addit(p,(long) lsiz,1);
-            usrio(wrtflg,tailrec,p->o_currec,ubufr,dm);
+            if (seq)
+                seqio(tailrec,p->o_currec,ubufr,p);
+            else usrio(wrtflg,tailrec,p->o_currec,ubufr,dm);
             ubufr += lsiz;
         }
     }
@@ -467,7 +517,8 @@ mulio:
             recn = 0;
         }
 
-        bufp = getrec((RECNO)p->o_currec+recn,p,wrtflg);
+        recn += p->o_currec;
+        bufp = seq ? seqrec(p,recn) : getrec(recn,p,wrtflg);
         addit(p,(long) lentail,1);
 
         if (!ubufr)
@@ -479,6 +530,8 @@ mulio:
     } /*  end tail bytes  */
 
 eof:
+    if (!wrtflg)
+        p->o_seqpos = p->o_bytnum;
     rc = p->o_bytnum - bytpos;
 
     return(rc);
@@ -496,11 +549,58 @@ static void usrio(int rwflg, int num, long strt, char *ubuf, DMD *dm)
 {
     BCB *b;
 
-    for (b = bufl[BI_DATA]; b; b = b->b_link)
-        if ((b->b_bufdrv == dm->m_drvnum) &&
-            (b->b_bufrec >= strt) &&
-            (b->b_bufrec < strt+num))
-            flush(b);
+    /*
+     * the buffers for records that are about to be overwritten are
+     * discarded; there is no point in writing them first
+     */
+    if (rwflg)
+    {
+        for (b = bufl[BI_DATA]; b; b = b->b_link)
+            if (USRIO_OVERLAP(b,dm,strt,num))
+            {
+                b->b_dirty = 0;
+                flush(b);
+            }
+    }
 
     longjmp_rwabs(rwflg, (long)ubuf, num, strt+dm->m_recoff[BT_DATA], dm->m_drvnum);
+
+    /*
+     * after a read, the records that have been modified in the buffers
+     * are copied from there.  this avoids writing the buffers before
+     * the read, as a separate request.
+     */
+    if (!rwflg)
+    {
+        for (b = bufl[BI_DATA]; b; b = b->b_link)
+            if (USRIO_OVERLAP(b,dm,strt,num) && b->b_dirty)
+                memcpy(ubuf+((b->b_bufrec-strt)<<dm->m_rblog),b->b_bufr,dm->m_recsiz);
+    }
+}
+
+
+#if CONF_BDOS_READAHEAD
+/*
+ * seqrec - like getrec(), for a sequential read: the rest of the
+ * current cluster is read ahead if the record is not in memory
+ */
+static char *seqrec(OFD *p, RECNO recn)
+{
+    readahead(p->o_dmd,recn,(int)(p->o_currec+p->o_dmd->m_clsiz-recn));
+
+    return getrec(recn,p,0);
+}
+
+
+/*
+ * seqio - like usrio(), for a sequential read: the records (which must
+ * be in the current cluster) are copied from the buffers
+ */
+static void seqio(int num, RECNO strt, char *ubuf, OFD *p)
+{
+    int recsiz = p->o_dmd->m_recsiz;
+
+    for ( ; num > 0; num--, strt++, ubuf += recsiz)
+        memcpy(ubuf,seqrec(p,strt),recsiz);
 }
+#endif
@@ -61,6 +61,9 @@
  */
 #define ILLEGAL_FNAME_CHARACTERS " *,:;<=>?[]|"
 
+/* the following characters are disallowed in a long filename */
+#define ILLEGAL_LFN_CHARACTERS  "*:<>?|\""
+
 
 /*
  * forward prototypes
@@ -161,36 +164,55 @@ long ixcreat(char *name, char attr)
     else
         pos = 0;
 
-    /* now scan for empty space */
-
-    /*  M01.01.SCC.FS.02  */
-    while( !( f = scan(dn,n,0xff,&pos) ) )
+#if CONF_WITH_VFAT
+    /*
+     * a long name needs a run of entries: lfn_create() finds them,
+     * writes all but the last, and gives us the 8.3 alias to use
+     */
+    if ((attr != FA_VOL) && lfn_is_long(s))
+    {
+        if ((pos = lfn_create(dn,s,a)) < 0)
+            return pos;
+        ixlseek(fd,pos);
+        f = (FCB *)ixread(fd,32L,NULL);
+    }
+    else
+#endif
     {
-        /*  not in current dir, need to grow  */
-        if (!fd->o_dnode)           /*  but can't grow root  */
-            return EACCDN;
+        /* now scan for empty space */
 
-        if ( nextcl(fd,1) )
-            return EACCDN;
+        /*  M01.01.SCC.FS.02  */
+        while( !( f = scan(dn,n,0xff,&pos) ) )
+        {
+            /*  not in current dir, need to grow  */
+            if (!fd->o_dnode)           /*  but can't grow root  */
+                return EACCDN;
 
-        f = dirinit(dn);
-        pos = 0;
-    }
+            if ( nextcl(fd,1) )
+                return EACCDN;
 
-    builds(s,a);
-    pos -= 32;
+            f = dirinit(dn);
+            pos = 0;
+        }
+
+        builds(s,a);
+        pos -= 32;
+    }
     f->f_attrib = attr;
-    for (i = 0; i < 10; i++)
+    for (i = 0; i < sizeof(f->f_fill); i++)
         f->f_fill[i] = 0;
     f->f_td.time = current_time;
     swpw(f->f_td.time);
     f->f_td.date = current_date;
     swpw(f->f_td.date);
-    f->f_clust = 0;
+    setfcbcl(f,0);
     f->f_fileln = 0;
     ixlseek(fd,pos);
     ixwrite(fd,11L,a);              /* write name, set dirty flag */
     ixclose(fd,CL_DIR);             /* partial close to flush */
+#if CONF_WITH_DIRINDEX
+    discard_dirindex(dn->d_drv,dn);
+#endif
     ixlseek(fd,pos);
     s = (char*) ixread(fd,32L,NULL);
     f2 = rc = opnfil((FCB*)s,dn,(f->f_attrib&FA_RO)?RO_MODE:RW_MODE);
@@ -286,15 +308,16 @@ static long makopn(FCB *f, DND *dn, int h, int mod)
     dn->d_files = p;
 
     if (p2)
-    {       /* steal time/date,startcl,fileln (a bit clumsily) */
-        memcpy(&p->o_td,&p2->o_td,sizeof(DOSTIME)+sizeof(CLNO)+sizeof(long));
+    {       /* steal time/date,startcl,fileln */
+        p->o_td = p2->o_td;
+        p->o_strtcl = p2->o_strtcl;
+        p->o_fileln = p2->o_fileln;
         /* not used yet... TBA *********/
         p2->o_thread = p;
     }
     else
     {
-        p->o_strtcl = f->f_clust;       /*  1st cluster of file */
-        swpw(p->o_strtcl);
+        p->o_strtcl = getfcbcl(f,dm);   /*  1st cluster of file */
         p->o_fileln = f->f_fileln;      /*  init length of file */
         swpl(p->o_fileln);
         p->o_td.date = f->f_td.date;    /* note: OFD time/date are  */
@@ -374,7 +397,10 @@ static void sftdel(FTAB *sftp)
     /*  if no other sft entries with same OFD, delete ofd  */
 
     if (sftofdsrch(ofd) == NULL)
+    {
+        release_extents(ofd);
         xmfreblk((int *)ofd);
+    }
 }
 
 
@@ -447,8 +473,6 @@ long xclose(int h)
 long ixclose(OFD *fd, int part)
 {                                   /*  M01.01.03                   */
     OFD *p, **q;
-    int i;                          /*  M01.01.03                   */
-    BCB *b;
 
     /*
      * if the file or folder has been modified, we need to make sure
@@ -470,9 +494,10 @@ long ixclose(OFD *fd, int part)
         ixlseek(fd->o_dirfil,fd->o_dirbyt); /* start of dir entry */
         fcb = (FCB *)ixread(fd->o_dirfil,32L,NULL);
         attr = fcb->f_attrib;               /* get attributes */
-        memcpy(&fcb->f_td,&fd->o_td,10);    /* copy date/time, start, length */
-        swpw(fcb->f_clust);                 /*  & fixup byte order */
-        swpl(fcb->f_fileln);
+        fcb->f_td = fd->o_td;               /* copy date/time (little-endian), */
+        setfcbcl(fcb,fd->o_strtcl);         /*  start,                         */
+        fcb->f_fileln = fd->o_fileln;       /*  length                         */
+        swpl(fcb->f_fileln);                /*  & fixup byte order             */
 
         if (part & CL_DIR)
             fcb->f_fileln = 0L;             /* dir lengths on disk are zero */
@@ -499,11 +524,9 @@ long ixclose(OFD *fd, int part)
             return EINTRN;  /* some kind of internal error */
     }
 
-    /* only flush to appropriate drive ***** TBA ******/
+    /* write any dirty buffers for this drive */
 
-    for (i = 0; i < 2; i++)
-        for (b = bufl[i]; b; b = b->b_link)
-            flush(b);
+    sync_buffers(fd->o_dmd->m_drvnum);
 
     return E_OK;
 }
@@ -566,16 +589,19 @@ long ixdel(DND *dn, FCB *f, long pos)
 {
     OFD *fd;
     DMD *dm;
-    int n2;
-    int n;
+    CLNO n, n2;
+    int i;
     char c;
+#if CONF_WITH_VFAT
+    UBYTE sum = lfn_checksum(f->f_name);
+#endif
 
     for (fd = dn->d_files; fd; fd = fd->o_link)
         if (fd->o_dirbyt == pos)
-            for (n = 0; n < OPNFILES; n++)
-                if (sft[n].f_ofd == fd)
+            for (i = 0; i < OPNFILES; i++)
+                if (sft[i].f_ofd == fd)
                 {
-                    if (sft[n].f_own == run)
+                    if (sft[i].f_own == run)
                         ixclose(fd,0);
                     else
                         return EACCDN;
@@ -585,8 +611,7 @@ long ixdel(DND *dn, FCB *f, long pos)
      * Traverse this file's chain of allocated clusters, freeing them.
      */
     dm = dn->d_drv;
-    n = f->f_clust;
-    swpw(n);
+    n = getfcbcl(f,dm);
 
     while (n && !endofchain(n))
     {
@@ -602,7 +627,13 @@ long ixdel(DND *dn, FCB *f, long pos)
     ixlseek(fd,pos);
     c = (char)ERASE_MARKER;
     ixwrite(fd,1L,&c);
+#if CONF_WITH_VFAT
+    lfn_erase(fd,pos,sum);          /* and any long name entries */
+#endif
     ixclose(fd,CL_DIR);
+#if CONF_WITH_DIRINDEX
+    discard_dirindex(dm,dn);
+#endif
 
     /*
      * NOTE that the preceding routines that do physical disk operations
@@ -623,6 +654,11 @@ BOOL contains_illegal_characters(const char *test)
     const char *ref = ILLEGAL_FNAME_CHARACTERS;
     const char *t;
 
+#if CONF_WITH_VFAT
+    if (lfn_is_long(test))
+        ref = ILLEGAL_LFN_CHARACTERS;
+#endif
+
     while(*ref)
     {
         for (t = test; *t; t++)
@@ -0,0 +1,772 @@
+/*
+ * fsvfat.c - VFAT long filename support for the file system
+ *
+ * Copyright (C) 2017 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+/*
+ * Long filenames are stored on disk as a run of FA_LFN entries in front
+ * of the normal directory entry, which holds a unique 8.3 alias of the
+ * name.  Each LFN entry holds 13 UCS-2 characters and a checksum of the
+ * alias, so that entries orphaned by a non-VFAT system can be detected.
+ *
+ * GEMDOS characters are stored as the corresponding code points 0-255;
+ * characters outside this range are returned as '_'.  Names are
+ * compared without regard to case.
+ *
+ * Lookups by long name are done by scan() in fsdir.c: the entries of
+ * a long name are collected by lfn_collect() as the directory is read,
+ * and compared by lfn_match() when the normal entry is reached, so a
+ * single pass over the directory is sufficient.
+ */
+
+/* #define ENABLE_KDEBUG */
+
+#include "config.h"
+#include "portab.h"
+#include "fs.h"
+#include "mem.h"
+#include "gemerror.h"
+#include "string.h"
+#include "kprint.h"
+
+#if CONF_WITH_VFAT
+
+/*
+ * characters that are valid in a long name but not in an 8.3 name;
+ * they are replaced by '_' in the alias
+ */
+#define LFN_ONLY_CHARACTERS " +,;=[]"
+
+#define LFN_MAXTAIL     256     /* numeric tails ~1 to ~255 are used */
+
+/* offsets of the characters within an LFN entry */
+static const UBYTE lfn_offset[LFN_CHARS] =
+    { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+
+/*
+ * the long name currently being collected
+ */
+static struct {
+    char name[LFN_MAXENT*LFN_CHARS+1];
+    UBYTE ord;          /* ordinal of last entry collected, 0 if none */
+    UBYTE sum;          /* alias checksum from the entries */
+} lfn;
+
+
+/*
+ *  lfn_namelen - return the length of a name (up to a NUL or SLASH),
+ *                ignoring trailing spaces and periods
+ */
+static int lfn_namelen(const char *s)
+{
+    int i, len;
+
+    for (i = len = 0; s[i] && (s[i] != SLASH); i++)
+        if ((s[i] != ' ') && (s[i] != '.'))
+            len = i + 1;
+
+    return len;
+}
+
+
+/*
+ *  lfn_is_long - check if a name (up to a NUL or SLASH) needs a long
+ *                filename, i.e. it cannot be represented as an 8.3 name
+ *
+ *  names containing wildcards are never long
+ */
+BOOL lfn_is_long(const char *s)
+{
+    const char *p;
+    int base, ext;
+    BOOL rc = FALSE;
+
+    if ((s[0] == '.') && (!s[1] || (s[1] == SLASH)))
+        return FALSE;           /* '.' */
+    if ((s[0] == '.') && (s[1] == '.') && (!s[2] || (s[2] == SLASH)))
+        return FALSE;           /* '..' */
+
+    for (p = s, base = 0, ext = -1; *p && (*p != SLASH); p++)
+    {
+        if ((*p == '*') || (*p == '?'))
+            return FALSE;
+        if (strchr(LFN_ONLY_CHARACTERS,*p))
+            rc = TRUE;
+        if (*p == '.')
+        {
+            if ((ext >= 0) || !base)
+                rc = TRUE;      /* several periods, or a leading one */
+            ext = 0;
+        }
+        else if (ext >= 0)
+            ext++;
+        else base++;
+    }
+
+    if ((base > LEN_ZNODE) || (ext > LEN_ZEXT))
+        rc = TRUE;
+
+    return rc;
+}
+
+
+/*
+ *  lfn_checksum - compute the checksum of an 8.3 name in directory format
+ */
+UBYTE lfn_checksum(const char *name)
+{
+    UBYTE sum = 0;
+    int i;
+
+    for (i = 0; i < 11; i++)
+        sum = ((sum & 1) ? 0x80 : 0) + (sum >> 1) + (UBYTE)name[i];
+
+    return sum;
+}
+
+
+/*
+ *  lfn_reset - discard any partially-collected long name
+ */
+void lfn_reset(void)
+{
+    lfn.ord = 0;
+}
+
+
+/*
+ *  lfn_collect - add the characters from an LFN entry to the long name
+ *
+ *  entries must be presented in directory order; if they are not in
+ *  sequence, the name collected so far is discarded
+ */
+void lfn_collect(const FCB *f)
+{
+    const UBYTE *e = (const UBYTE *)f;
+    char *d;
+    UWORD c;
+    int i, ord;
+
+    ord = e[0] & LFN_ORDMASK;
+
+    if (e[0] & LFN_LAST)
+    {
+        lfn.ord = 0;
+        if (!ord || (ord > LFN_MAXENT))
+            return;
+        lfn.sum = e[13];
+        lfn.name[ord*LFN_CHARS] = '\0';
+    }
+    else if (!ord || (ord != lfn.ord-1) || (e[13] != lfn.sum))
+    {
+        lfn.ord = 0;
+        return;
+    }
+
+    lfn.ord = ord;
+    d = lfn.name + (ord-1) * LFN_CHARS;
+    for (i = 0; i < LFN_CHARS; i++)
+    {
+        c = e[lfn_offset[i]] | ((UWORD)e[lfn_offset[i]+1] << 8);
+        if (!c)
+        {
+            *d = '\0';
+            break;
+        }
+        *d++ = (c < 0x100) ? (char)c : '_';
+    }
+}
+
+
+/*
+ *  lfn_name - return the long name collected for the normal directory
+ *             entry 'f', or NULL if it has none
+ *
+ *  the collected name is discarded in either case
+ */
+static const char *lfn_name(const FCB *f)
+{
+    BOOL valid;
+
+    valid = (lfn.ord == 1) && (f->f_name[0] != (char)ERASE_MARKER)
+            && (lfn.sum == lfn_checksum(f->f_name));
+    lfn.ord = 0;
+
+    return valid ? lfn.name : NULL;
+}
+
+
+/*
+ *  lfn_match - check if the long name collected for the normal directory
+ *              entry 'f' is the name 'n' (up to a NUL or SLASH)
+ */
+BOOL lfn_match(const FCB *f, const char *n)
+{
+    const char *s;
+    int len;
+
+    if (!(s = lfn_name(f)))
+        return FALSE;
+
+    len = lfn_namelen(n);
+    if (strncasecmp(s,n,len) != 0)
+        return FALSE;
+
+    return s[len] ? FALSE : TRUE;
+}
+
+
+/*
+ *  lfn_shortchar - convert a character of a long name for use in an alias
+ */
+static char lfn_shortchar(char c)
+{
+    if (strchr(LFN_ONLY_CHARACTERS,c))
+        return '_';
+
+    return toupper(c);
+}
+
+
+/*
+ *  lfn_basis - build the basis of the alias for a long name, in
+ *              directory format, and return the length of its name part
+ */
+static int lfn_basis(const char *name, int len, char *a)
+{
+    int i, j, k, dot;
+
+    for (dot = len-1; dot > 0; dot--)   /* find last period (not leading) */
+        if (name[dot] == '.')
+            break;
+    if (dot <= 0)
+        dot = len;
+
+    memset(a,' ',11);
+
+    for (i = k = 0; (i < dot) && (k < LEN_ZNODE); i++)
+        if ((name[i] != ' ') && (name[i] != '.'))
+            a[k++] = lfn_shortchar(name[i]);
+    if (!k)
+        a[k++] = '_';
+
+    for (i = dot+1, j = LEN_ZNODE; (i < len) && (j < 11); i++)
+        if (name[i] != ' ')
+            a[j++] = lfn_shortchar(name[i]);
+
+    return k;
+}
+
+
+/*
+ *  lfn_tail - if 'e' is the alias 'a' with a numeric tail, return the
+ *             value of the tail; otherwise return 0
+ */
+static UWORD lfn_tail(const char *e, const char *a, int baselen)
+{
+    int i, t, nd;
+    UWORD n;
+
+    if (memcmp(e+LEN_ZNODE,a+LEN_ZNODE,LEN_ZEXT) != 0)
+        return 0;
+
+    for (t = 0; (t < LEN_ZNODE) && (e[t] != '~'); t++)
+        ;
+    for (i = t+1, n = 0; (i < LEN_ZNODE) && (e[i] >= '0') && (e[i] <= '9'); i++)
+        n = n * 10 + e[i] - '0';
+    if ((i == t+1) || (i > LEN_ZNODE))
+        return 0;
+    nd = i - t - 1;                     /* number of digits */
+    for ( ; i < LEN_ZNODE; i++)
+        if (e[i] != ' ')
+            return 0;
+
+    if ((t != min(baselen,LEN_ZNODE-1-nd)) || (memcmp(e,a,t) != 0))
+        return 0;
+
+    return n;
+}
+
+
+/*
+ *  lfn_settail - add numeric tail 'n' to the alias basis 'a'
+ */
+static void lfn_settail(char *a, int baselen, UWORD n)
+{
+    char digits[4];
+    int i, nd;
+
+    for (nd = 0; n; n /= 10)
+        digits[nd++] = '0' + n % 10;
+
+    i = min(baselen,LEN_ZNODE-1-nd);
+    a[i++] = '~';
+    while(nd)
+        a[i++] = digits[--nd];
+    while(i < LEN_ZNODE)
+        a[i++] = ' ';
+}
+
+
+/*
+ *  lfn_setent - fill in LFN entry number 'ord' for a long name
+ */
+static void lfn_setent(UBYTE *e, const char *name, int len, int ord, UBYTE sum)
+{
+    int i, j, k;
+
+    bzero(e,sizeof(FCB));
+    e[0] = ord;
+    e[11] = FA_LFN;
+    e[13] = sum;
+
+    for (i = 0, k = (ord-1) * LFN_CHARS; i < LFN_CHARS; i++, k++)
+    {
+        j = lfn_offset[i];
+        if (k < len)
+            e[j] = name[k];         /* high byte is zero */
+        else if (k > len)
+            e[j] = e[j+1] = 0xff;   /* padding after the terminating NUL */
+    }
+}
+
+
+/*
+ *  lfn_create - create the long name entries for a new file
+ *
+ *  a unique alias is chosen and returned in 'alias' (in directory
+ *  format), and space is found (growing the directory if necessary)
+ *  for the LFN entries followed by the normal entry.  the LFN entries
+ *  are written; the normal entry must be written by the caller.
+ *
+ *  returns
+ *      offset of the normal entry within the directory, or
+ *      ERANGE  if the name is too long
+ *      EACCDN  if the name is empty, or no alias or space is available
+ */
+long lfn_create(DND *dn, const char *name, char *alias)
+{
+    OFD *fd;
+    FCB *f;
+    UBYTE used[LFN_MAXTAIL/8];
+    UBYTE e[sizeof(FCB)];
+    LONG pos, start, end;
+    UWORD tail;
+    UBYTE sum;
+    int len, baselen, nent, run, i;
+
+    fd = dn->d_ofd;
+    len = lfn_namelen(name);
+    if (!len)
+        return EACCDN;
+    if (len > LFN_MAXLEN)
+        return ERANGE;
+    nent = (len + LFN_CHARS - 1) / LFN_CHARS;
+
+    baselen = lfn_basis(name,len,alias);
+    bzero(used,sizeof(used));
+
+    /*
+     * in a single pass over the directory, note the numeric tails
+     * that are in use with this basis, and find the first run of free
+     * entries that is long enough
+     */
+    start = -1L;
+    end = pos = 0L;
+    run = 0;
+    ixlseek(fd,0L);
+    while ((f = (FCB *)ixread(fd,32L,NULL)))
+    {
+        end = fd->o_bytnum;
+        if (f->f_name[0] == 0x00)       /* rest of directory is free */
+        {
+            end -= 32;
+            break;
+        }
+        if (f->f_name[0] == (char)ERASE_MARKER)
+        {
+            if (!run++)
+                pos = end - 32;
+            if ((run > nent) && (start < 0))
+                start = pos;
+            continue;
+        }
+        run = 0;
+        if ((f->f_attrib != FA_LFN) && !(f->f_attrib & FA_VOL))
+        {
+            tail = lfn_tail(f->f_name,alias,baselen);
+            if (tail && (tail < LFN_MAXTAIL))
+                used[tail>>3] |= 1 << (tail & 7);
+        }
+    }
+
+    for (tail = 1; tail < LFN_MAXTAIL; tail++)
+        if (!(used[tail>>3] & (1 << (tail & 7))))
+            break;
+    if (tail >= LFN_MAXTAIL)
+        return EACCDN;
+    lfn_settail(alias,baselen,tail);
+    sum = lfn_checksum(alias);
+
+    KDEBUG(("lfn_create(%s): alias=%11.11s, %d entries\n",name,alias,nent));
+
+    /*
+     * if there was no suitable run, use the free space at the end of
+     * the directory (including any free entries just before it)
+     */
+    if (start < 0)
+    {
+        start = run ? pos : end;
+
+        for (i = 0, pos = start; i <= nent; i++, pos += 32)
+        {
+            ixlseek(fd,pos);
+            if (ixread(fd,32L,NULL))
+                continue;
+
+            /* need to grow the directory (but can't grow root) */
+            if (!fd->o_dnode)
+                return EACCDN;
+            if (nextcl(fd,1))
+                return EACCDN;
+            dirinit(dn);
+        }
+    }
+
+    /*
+     * write the LFN entries, last part of the name first
+     */
+    for (i = nent, pos = start; i > 0; i--, pos += 32)
+    {
+        lfn_setent(e,name,len,i,sum);
+        if (i == nent)
+            e[0] |= LFN_LAST;
+        ixlseek(fd,pos);
+        ixwrite(fd,32L,e);
+    }
+
+    return pos;
+}
+
+
+/*
+ *  lfn_erase - mark the LFN entries (if any) that precede the directory
+ *              entry at offset 'pos' as erased
+ *
+ *  'sum' is the checksum of the entry's name
+ */
+void lfn_erase(OFD *fd, LONG pos, UBYTE sum)
+{
+    const UBYTE *e;
+    char c = (char)ERASE_MARKER;
+    int ord;
+    BOOL last;
+
+    for (ord = 1; (ord <= LFN_MAXENT) && (pos >= 32); ord++)
+    {
+        pos -= 32;
+        ixlseek(fd,pos);
+        e = (const UBYTE *)ixread(fd,32L,NULL);
+        if (!e || (e[11] != FA_LFN) || (e[13] != sum)
+         || ((e[0] & LFN_ORDMASK) != ord))
+            break;
+        last = (e[0] & LFN_LAST) ? TRUE : FALSE;
+        ixlseek(fd,pos);
+        ixwrite(fd,1L,&c);
+        if (last)
+            break;
+    }
+}
+
+
+/*
+ * MiNT-compatible directory functions
+ */
+
+/* modes for Dpathconf() */
+#define DP_MAXREQ       -1      /* highest mode supported */
+#define DP_IOPEN        0       /* max number of open files */
+#define DP_MAXLINKS     1       /* max number of links to a file */
+#define DP_PATHMAX      2       /* max length of a full path */
+#define DP_NAMEMAX      3       /* max length of a filename */
+#define DP_ATOMIC       4       /* bytes that can be written atomically */
+#define DP_TRUNC        5       /* filename truncation */
+#define DP_CASE         6       /* filename case handling */
+
+#define DP_NOTRUNC      0       /* long names are not truncated */
+#define DP_CASEINSENS   2       /* case preserved, but not significant */
+
+/* flag for Dopendir() */
+#define DOPEN_COMPAT    0x0001  /* return 8.3 names without an index */
+
+/*
+ * directory handles
+ *
+ * while a handle is open, the directory's DND is kept in dirtbl[] like
+ * a current directory, so that it is not freed by makdnd()
+ */
+#define NUM_DIRHANDLES  8
+
+typedef struct {
+    PD    *dh_own;              /* owner, NULL if free */
+    DND   *dh_dnd;              /* the directory */
+    LONG  dh_pos;               /* offset of next entry */
+    WORD  dh_slot;              /* index in dirtbl[] */
+    WORD  dh_flag;              /* flag from Dopendir() */
+} DIRHANDLE;
+
+static DIRHANDLE dirhandles[NUM_DIRHANDLES];
+
+
+/*
+ *  getdirh - validate a directory handle
+ */
+static DIRHANDLE *getdirh(long handle)
+{
+    DIRHANDLE *dh;
+
+    for (dh = dirhandles; dh < dirhandles+NUM_DIRHANDLES; dh++)
+        if ((long)dh == handle)
+            break;
+
+    if ((dh >= dirhandles+NUM_DIRHANDLES) || (dh->dh_own != run))
+        return NULL;
+
+    /* the DND is lost if the media has changed */
+    if (dirtbl[dh->dh_slot].dnd != dh->dh_dnd)
+        return NULL;
+
+    return dh;
+}
+
+
+/*
+ *  freedirh - release a directory handle
+ */
+static void freedirh(DIRHANDLE *dh)
+{
+    if (dirtbl[dh->dh_slot].dnd == dh->dh_dnd)
+        decr_curdir_usage(dh->dh_slot);
+    dh->dh_own = NULL;
+}
+
+
+/*
+ *  xpathconf - get file system limits for a path
+ *
+ *  Function 0x124  Dpathconf
+ *
+ *  Error returns:
+ *                  EPTHNF
+ *                  EINVFN
+ */
+long xpathconf(char *name, int mode)
+{
+    DND *dn;
+    const char *s;
+
+    if ((long)(dn = findit(name,&s,0)) < 0)
+        return (long)dn;
+    if (!dn)
+        return EPTHNF;
+
+    switch(mode) {
+    case DP_MAXREQ:
+        return DP_CASE;
+    case DP_IOPEN:
+        return OPNFILES;
+    case DP_MAXLINKS:
+        return 1;
+    case DP_PATHMAX:
+        return MAXPATHLEN;
+    case DP_NAMEMAX:
+        return LFN_MAXLEN;
+    case DP_ATOMIC:
+        return dn->d_drv->m_recsiz;
+    case DP_TRUNC:
+        return DP_NOTRUNC;
+    case DP_CASE:
+        return DP_CASEINSENS;
+    }
+
+    return EINVFN;
+}
+
+
+/*
+ *  xopendir - open a directory for reading
+ *
+ *  Function 0x128  Dopendir
+ *
+ *  Error returns:
+ *                  EPTHNF
+ *                  ENHNDL
+ */
+long xopendir(char *name, int flag)
+{
+    DIRHANDLE *dh;
+    DND *dn;
+    const char *s;
+    int slot;
+
+    if ((long)(dn = findit(name,&s,1)) < 0)
+        return (long)dn;
+    if (!dn)
+        return EPTHNF;
+
+    for (dh = dirhandles; dh < dirhandles+NUM_DIRHANDLES; dh++)
+        if (!dh->dh_own)
+            break;
+    if (dh >= dirhandles+NUM_DIRHANDLES)
+        return ENHNDL;
+
+    if ((slot = incr_curdir_usage(dn)) < 0)
+        return ENHNDL;
+
+    dh->dh_own = run;
+    dh->dh_dnd = dn;
+    dh->dh_pos = 0L;
+    dh->dh_slot = slot;
+    dh->dh_flag = flag;
+
+    return (long)dh;
+}
+
+
+/*
+ *  xreaddir - read the next entry from a directory
+ *
+ *  Function 0x129  Dreaddir
+ *
+ *  unless the directory was opened in compatibility mode, the name is
+ *  the long name if there is one, and is preceded by a 4-byte index
+ *  (the entry's start cluster)
+ *
+ *  Error returns:
+ *                  EIHNDL
+ *                  ENMFIL
+ *                  ERANGE
+ */
+long xreaddir(int len, long handle, char *buf)
+{
+    DIRHANDLE *dh;
+    DND *dn;
+    OFD *fd;
+    FCB *f;
+    const char *s;
+    char shortname[LEN_ZFNAME];
+    LONG index;
+    int n;
+
+    if (!(dh = getdirh(handle)))
+        return EIHNDL;
+
+    dn = dh->dh_dnd;
+    if (!(fd = dn->d_ofd))
+        fd = makofd(dn);        /* makofd() also updates dn->d_ofd */
+
+    ixlseek(fd,dh->dh_pos);
+    lfn_reset();
+
+    while ((f = (FCB *)ixread(fd,32L,NULL)) && f->f_name[0])
+    {
+        if (f->f_attrib == FA_LFN)
+        {
+            if (f->f_name[0] != (char)ERASE_MARKER)
+                lfn_collect(f);
+            continue;
+        }
+
+        s = lfn_name(f);
+        if ((f->f_name[0] == (char)ERASE_MARKER) || (f->f_attrib & FA_VOL))
+            continue;
+
+        if ((dh->dh_flag & DOPEN_COMPAT) || !s)
+        {
+            packit(f->f_name,shortname);
+            s = shortname;
+        }
+
+        n = strlen(s) + 1;
+        if (!(dh->dh_flag & DOPEN_COMPAT))
+            n += sizeof(LONG);
+        if (n > len)
+            return ERANGE;      /* entry will be returned again */
+
+        if (!(dh->dh_flag & DOPEN_COMPAT))
+        {
+            index = getfcbcl(f,dn->d_drv);
+            memcpy(buf,&index,sizeof(LONG));
+            buf += sizeof(LONG);
+        }
+        strcpy(buf,s);
+
+        dh->dh_pos = fd->o_bytnum;
+        return E_OK;
+    }
+
+    dh->dh_pos = fd->o_bytnum;
+    return ENMFIL;
+}
+
+
+/*
+ *  xrewinddir - return to the start of a directory
+ *
+ *  Function 0x12A  Drewinddir
+ *
+ *  Error returns:
+ *                  EIHNDL
+ */
+long xrewinddir(long handle)
+{
+    DIRHANDLE *dh;
+
+    if (!(dh = getdirh(handle)))
+        return EIHNDL;
+
+    dh->dh_pos = 0L;
+
+    return E_OK;
+}
+
+
+/*
+ *  xclosedir - close a directory handle
+ *
+ *  Function 0x12B  Dclosedir
+ *
+ *  Error returns:
+ *                  EIHNDL
+ */
+long xclosedir(long handle)
+{
+    DIRHANDLE *dh;
+
+    if (!(dh = getdirh(handle)))
+        return EIHNDL;
+
+    freedirh(dh);
+
+    return E_OK;
+}
+
+
+/*
+ *  close_dirhandles - close the directory handles owned by a process
+ *                     that is terminating
+ */
+void close_dirhandles(PD *p)
+{
+    DIRHANDLE *dh;
+
+    for (dh = dirhandles; dh < dirhandles+NUM_DIRHANDLES; dh++)
+        if (dh->dh_own == p)
+            freedirh(dh);
+}
+
+#endif /* CONF_WITH_VFAT */
@@ -31,12 +31,206 @@ long ccfreeit;
 
 
 /*
- *  ffit - find first fit for requested memory in ospool
+ *  free lists
+ *
+ *  the free MDs of an MPB are kept on mp_mfl, doubly linked via m_link
+ *  & m_prev, and grouped by size class: a block of n bytes is in class
+ *  log2(n).  mp_class[] points to the first MD of each class that is
+ *  present, and mp_classmap has a bit set for each of these, so the
+ *  smallest class that can satisfy a request is found at once.  the
+ *  allocated MDs are on mp_mal, doubly linked the same way.
+ *
+ *  in addition, each MD points to the MDs for the blocks just below and
+ *  just above it, so that a freed block can be merged with free
+ *  neighbours without searching.
+ */
+#define IN_CLASS(m,c)   (((m)->m_length >> (c)) == 1)
+
+static WORD md_class(LONG length);
+static WORD next_class(ULONG map, WORD c);
+static void class_insert(MD *m, MPB *mp);
+static void class_remove(MD *m, MPB *mp);
+static MD *class_fit(MPB *mp, WORD c, LONG amount);
+static void mal_insert(MD *m, MPB *mp);
+static void mal_remove(MD *m, MPB *mp);
+static void merge_higher(MD *m, MPB *mp);
+
+
+/*
+ *  md_class - return the size class of a block of 'length' bytes
+ */
+static WORD md_class(LONG length)
+{
+    WORD c;
+
+    for (c = 0; length > 1; length >>= 1)
+        c++;
+
+    return c;
+}
+
+
+/*
+ *  next_class - return the lowest class >= c present in 'map', or -1
+ */
+static WORD next_class(ULONG map, WORD c)
+{
+    if (c >= MP_CLASSES)
+        return -1;
+
+    map &= 0xffffffffUL << c;
+    if (!map)
+        return -1;
+
+    for (c = 0; !(map & 1); map >>= 1)
+        c++;
+
+    return c;
+}
+
+
+/*
+ *  class_insert - put a free MD on the free list, at the start of its class
+ */
+static void class_insert(MD *m, MPB *mp)
+{
+    MD *next;
+    WORD c, k;
+
+    c = md_class(m->m_length);
+    k = next_class(mp->mp_classmap,c);
+    next = (k >= 0) ? mp->mp_class[k] : NULL;
+
+    /* link m in before 'next', or at the end */
+    m->m_link = next;
+    m->m_prev = next ? next->m_prev : mp->mp_tail;
+    if (m->m_prev)
+        m->m_prev->m_link = m;
+    else
+        mp->mp_mfl = m;
+    if (next)
+        next->m_prev = m;
+    else
+        mp->mp_tail = m;
+
+    mp->mp_class[c] = m;
+    mp->mp_classmap |= 1UL << c;
+    m->m_flags |= MF_FREE;
+}
+
+
+/*
+ *  class_remove - take a free MD off the free list
+ *
+ *  this must be done before the length of the MD is changed
+ */
+static void class_remove(MD *m, MPB *mp)
+{
+    WORD c;
+
+    c = md_class(m->m_length);
+    if (mp->mp_class[c] == m)
+    {
+        if (m->m_link && IN_CLASS(m->m_link,c))
+            mp->mp_class[c] = m->m_link;
+        else
+        {
+            mp->mp_class[c] = NULL;
+            mp->mp_classmap &= ~(1UL << c);
+        }
+    }
+
+    if (m->m_prev)
+        m->m_prev->m_link = m->m_link;
+    else
+        mp->mp_mfl = m->m_link;
+    if (m->m_link)
+        m->m_link->m_prev = m->m_prev;
+    else
+        mp->mp_tail = m->m_prev;
+
+    m->m_flags &= ~MF_FREE;
+}
+
+
+/*
+ *  class_fit - return the smallest free MD of class 'c' with at least
+ *  'amount' bytes (the lowest one if there are several), or NULL
+ */
+static MD *class_fit(MPB *mp, WORD c, LONG amount)
+{
+    MD *m, *best;
+
+    for (m = mp->mp_class[c], best = NULL; m && IN_CLASS(m,c); m = m->m_link)
+    {
+        if (m->m_length < amount)
+            continue;
+        if (!best || (m->m_length < best->m_length)
+         || ((m->m_length == best->m_length) && (m->m_start < best->m_start)))
+            best = m;
+    }
+
+    return best;
+}
+
+
+/*
+ *  mal_insert - put an MD at the start of the allocated list
+ */
+static void mal_insert(MD *m, MPB *mp)
+{
+    m->m_prev = NULL;
+    m->m_link = mp->mp_mal;
+    if (m->m_link)
+        m->m_link->m_prev = m;
+    mp->mp_mal = m;
+}
+
+
+/*
+ *  mal_remove - take an MD off the allocated list
+ */
+static void mal_remove(MD *m, MPB *mp)
+{
+    if (m->m_prev)
+        m->m_prev->m_link = m->m_link;
+    else
+        mp->mp_mal = m->m_link;
+    if (m->m_link)
+        m->m_link->m_prev = m->m_prev;
+}
+
+
+/*
+ *  merge_higher - if the block just above 'm' is free, merge it into 'm'
+ *
+ *  'm' must not be on the free list
+ */
+static void merge_higher(MD *m, MPB *mp)
+{
+    MD *f;
+
+    f = m->m_higher;
+    if (!f || !(f->m_flags & MF_FREE) || (m->m_start + m->m_length != f->m_start))
+        return;
+
+    class_remove(f,mp);
+    m->m_length += f->m_length;
+    m->m_higher = f->m_higher;
+    if (m->m_higher)
+        m->m_higher->m_lower = m;
+    xmfremd(f);
+}
+
+
+/*
+ *  ffit - find the best fit for requested memory in ospool
  */
 MD *ffit(long amount, MPB *mp)
 {
-    MD *p, *q, *p1;     /* free list is composed of MD's */
+    MD *q, *p1;     /* free list is composed of MD's */
     LONG maxval;
+    WORD c;
 
 #ifdef ENABLE_KDEBUG
     if (mp == &pmd)
@@ -54,19 +248,20 @@ MD *ffit(long amount, MPB *mp)
     ++ccffit;
 #endif
 
-    p = (MD *)mp;
-    if ((q = mp->mp_mfl) == NULL)   /* get free list pointer */
+    if (mp->mp_mfl == NULL)         /* get free list pointer */
     {
         KDEBUG(("BDOS ffit: null free list ptr\n"));
         return NULL;
     }
 
     /*
-     * handle request for maximum free block
+     * handle request for maximum free block: it is in the highest class
      */
     if (amount == -1L)
     {
-        for (maxval = 0L; q; p = q, q = p->m_link)
+        for (c = MP_CLASSES-1; !(mp->mp_classmap & (1UL << c)); c--)
+            ;
+        for (maxval = 0L, q = mp->mp_class[c]; q && IN_CLASS(q,c); q = q->m_link)
             if (q->m_length > maxval)
                 maxval = q->m_length;
 
@@ -84,14 +279,15 @@ MD *ffit(long amount, MPB *mp)
     amount = (amount + 3) & ~3;
 
     /*
-     * look for first free space that's large enough
-     * (this could be changed to a best-fit quite easily)
+     * look for the smallest free space that's large enough, first in
+     * the class of the request, then in the next class present
      */
-    for ( ; q; p = q, q = p->m_link)
-    {
-        if (q->m_length >= amount)
-            break;
-    }
+    c = md_class(amount);
+    q = NULL;
+    if (mp->mp_classmap & (1UL << c))
+        q = class_fit(mp,c,amount);
+    if (!q && ((c = next_class(mp->mp_classmap,c+1)) >= 0))
+        q = class_fit(mp,c,amount);
     if (!q)
     {
         KDEBUG(("BDOS ffit: Not enough contiguous memory\n"));
@@ -99,7 +295,7 @@ MD *ffit(long amount, MPB *mp)
     }
 
     if (q->m_length == amount)
-        p->m_link = q->m_link;  /* take the whole thing */
+        class_remove(q,mp);     /* take the whole thing */
     else
     {
         /* break it up - 1st allocate a new MD to describe the remainder */
@@ -114,11 +310,17 @@ MD *ffit(long amount, MPB *mp)
             return NULL;
         }
 
+        class_remove(q,mp);
+
         /* init new MD for remaining memory on free chain */
         p1->m_length = q->m_length - amount;
         p1->m_start = q->m_start + amount;
-        p1->m_link = q->m_link;
-        p->m_link = p1;
+        p1->m_lower = q;
+        p1->m_higher = q->m_higher;
+        if (p1->m_higher)
+            p1->m_higher->m_lower = p1;
+        q->m_higher = p1;
+        class_insert(p1,mp);
 
         /* adjust old MD for allocated memory on allocated chain */
         q->m_length = amount;
@@ -127,8 +329,7 @@ MD *ffit(long amount, MPB *mp)
     /*
      * link allocated block into allocated list & mark owner of block
      */
-    q->m_link = mp->mp_mal;
-    mp->mp_mal = q;
+    mal_insert(q,mp);
     q->m_own = run;
 
     KDEBUG(("BDOS ffit: start=%p, length=%ld\n",q->m_start,q->m_length));
@@ -141,7 +342,7 @@ MD *ffit(long amount, MPB *mp)
  */
 void freeit(MD *m, MPB *mp)
 {
-    MD *p, *q, *f;
+    MD *f;
 
 #ifdef ENABLE_KDEBUG
     if (mp == &pmd)
@@ -159,64 +360,38 @@ void freeit(MD *m, MPB *mp)
     ++ccfreeit;
 #endif
 
-    /*
-     * first, find it in the allocated list
-     */
-    for (p = mp->mp_mal, q = NULL; p; q = p, p = p->m_link)
-        if (m->m_start == p->m_start)
-            break;
-
-    if (!p)
+    if (m->m_flags & MF_FREE)
     {
-        KDEBUG(("BDOS freeit: invalid MD address %p\n",m));
+        KDEBUG(("BDOS freeit: MD at %p is already free\n",m));
         return;
     }
 
     /*
-     * snip it out
-     */
-    if (q)
-        q->m_link = p->m_link;
-    else
-        mp->mp_mal = p->m_link;
-
-    /*
-     * find where to add it to the free list
-     * (the free list is maintained in ascending sequence)
-     *
-     * p -> MD to be added
+     * snip it out of the allocated list
      */
-    for (f = mp->mp_mfl, q = NULL; f; q = f, f = f-> m_link)
-        if (p->m_start <= f->m_start)
-            break;
+    mal_remove(m,mp);
 
     /*
-     * insert it
+     * coalesce with free neighbours if possible
      */
-    p->m_link = f;          /* f -> next higher block */
-    if (q)
-        q->m_link = p;
-    else
-        mp->mp_mfl = p;
+    merge_higher(m,mp);             /* join to higher neighbour */
+
+    f = m->m_lower;
+    if (f && (f->m_flags & MF_FREE) && (f->m_start + f->m_length == m->m_start))
+    {                               /* join to lower neighbour */
+        class_remove(f,mp);
+        f->m_length += m->m_length;
+        f->m_higher = m->m_higher;
+        if (f->m_higher)
+            f->m_higher->m_lower = f;
+        xmfremd(m);
+        m = f;
+    }
 
     /*
-     * finally, coalesce free blocks if possible
+     * finally, put it on the free list
      */
-    if (f)
-        if (p->m_start + p->m_length == f->m_start)
-        { /* join to higher neighbor */
-            p->m_length += f->m_length;
-            p->m_link = f->m_link;
-            xmfremd(f);
-        }
-
-    if (q)
-        if (q->m_start + q->m_length == p->m_start)
-        { /* join to lower neighbor */
-            q->m_length += p->m_length;
-            q->m_link = p->m_link;
-            xmfremd(p);
-        }
+    class_insert(m,mp);
 }
 
 
@@ -225,7 +400,7 @@ void freeit(MD *m, MPB *mp)
  */
 WORD shrinkit(MD *m, MPB *mp, LONG newlen)
 {
-    MD *f, *p, *q;
+    MD *f;
 
     /*
      * Create a memory descriptor for the freed portion of memory.
@@ -239,20 +414,17 @@ WORD shrinkit(MD *m, MPB *mp, LONG newlen)
 
     f->m_start = m->m_start + newlen;
     f->m_length = m->m_length - newlen;
+    f->m_lower = m;
+    f->m_higher = m->m_higher;
+    if (f->m_higher)
+        f->m_higher->m_lower = f;
+    m->m_higher = f;
 
     /*
-     * Add it to the free list.
+     * Merge it with a free block above, and add it to the free list.
      */
-    for (p = mp->mp_mfl, q = NULL; p; q = p, p = p->m_link)
-        if (f->m_start <= p->m_start)
-            break;
-
-    f->m_link = p;
-
-    if (q)
-        q->m_link = f;
-    else
-        mp->mp_mfl = f;
+    merge_higher(f,mp);
+    class_insert(f,mp);
 
     /*
      * Update existing memory descriptor.
@@ -261,3 +433,56 @@ WORD shrinkit(MD *m, MPB *mp, LONG newlen)
 
     return 0;
 }
+
+
+/*
+ *  reserveit - remove a memory descriptor from the allocated list,
+ *  leaving the memory permanently allocated
+ */
+void reserveit(MD *m, MPB *mp)
+{
+    mal_remove(m,mp);
+
+    if (m->m_lower)
+        m->m_lower->m_higher = m->m_higher;
+    if (m->m_higher)
+        m->m_higher->m_lower = m->m_lower;
+
+    xmfremd(m);
+}
+
+
+/*
+ *  mpb_init - empty the free & allocated lists of an MPB
+ */
+void mpb_init(MPB *mp)
+{
+    WORD c;
+
+    mp->mp_mfl = mp->mp_mal = mp->mp_tail = NULL;
+    mp->mp_classmap = 0UL;
+    for (c = 0; c < MP_CLASSES; c++)
+        mp->mp_class[c] = NULL;
+}
+
+
+/*
+ *  addfree - add a block described by a new MD to the free list
+ */
+void addfree(MD *m, MPB *mp)
+{
+    m->m_own = NULL;
+    m->m_lower = m->m_higher = NULL;
+    class_insert(m,mp);
+}
+
+
+/*
+ *  growfree - extend a free block by 'size' bytes
+ */
+void growfree(MD *m, MPB *mp, LONG size)
+{
+    class_remove(m,mp);
+    m->m_length += size;
+    class_insert(m,mp);
+}
@@ -38,10 +38,9 @@ void *xmgetblk(WORD memtype);
 
 /*  MGET - wrapper around xmgetblk */
 #define MGET(x)         ((x *)xmgetblk(MEMTYPE_ ## x))
-#define MEMTYPE_MDBLOCK 0   /* the 4 types of valid request, all needing 64 bytes */
-#define MEMTYPE_DMD     1
-#define MEMTYPE_DND     2
-#define MEMTYPE_OFD     3
+#define MEMTYPE_DMD     0   /* the 3 types of valid request, each with its */
+#define MEMTYPE_DND     1   /*  own slab cache (see osmem.c)               */
+#define MEMTYPE_OFD     2
 
 /*  xmfreblk - free up memory allocated through mgetblk */
 void xmfreblk(void *m);
@@ -64,6 +63,8 @@ long xmfree(void *addr);
 long xsetblk(int n, void *blk, long len);
 /* mxalloc */
 void *xmxalloc(long amount, int mode);
+/* mxalloc for internal BDOS use */
+void *xmxalloc_os(long amount, int mode);
 /* srealloc */
 void *srealloc(long amount);
 
@@ -73,6 +74,20 @@ void *srealloc(long amount);
 #define MX_PREFSTRAM 2
 #define MX_PREFTTRAM 3
 #define MX_MODEMASK  0x03   /* mask for supported mode bits */
+#define MX_STATS     0x1000 /* EmuTOS extension: get pool statistics */
+
+/*
+ * pool statistics returned by Mxalloc(buf,MX_STATS|mode), where 'buf'
+ * points to an MXSTATS and 'mode' selects the pool(s) as usual.  no
+ * other mode bits may be set, otherwise this is a normal allocation.
+ */
+typedef struct {
+    LONG mx_free;       /* total free memory */
+    LONG mx_largest;    /* largest free block */
+    LONG mx_nfree;      /* number of free blocks */
+    LONG mx_used;       /* total allocated memory */
+    LONG mx_nused;      /* number of allocated blocks */
+} MXSTATS;
 
 #if CONF_WITH_ALT_RAM
 /* declare additional memory */
@@ -91,12 +106,20 @@ void set_owner(void *addr, PD *p);
  * in iumem.c
  */
 
-/* find first fit for requested memory in ospool */
+/* find best fit for requested memory in ospool */
 MD *ffit(long amount, MPB *mp);
 /* Free up a memory descriptor */
 void freeit(MD *m, MPB *mp);
 /* shrink a memory descriptor */
 WORD shrinkit(MD *m, MPB *mp, LONG newlen);
+/* remove a memory descriptor, keeping its memory allocated */
+void reserveit(MD *m, MPB *mp);
+/* empty the lists of an MPB */
+void mpb_init(MPB *mp);
+/* add a new free block */
+void addfree(MD *m, MPB *mp);
+/* extend a free block */
+void growfree(MD *m, MPB *mp, LONG size);
 
 
 #endif /* MEM_H */
@@ -28,58 +28,77 @@
 #include "nls.h"
 #include "fs.h"
 #include "mem.h"
+#include "string.h"
 #include "kprint.h"
 
 /*
  *  local constants
  */
-#define NUM_OSM_BLOCKS  118         /* more than TOS, probably larger than necessary */
-#define LEN_OSM_BLOCK   (2+64)      /* in bytes */
+#define NUM_OSM_SLABS   30          /* about the same size as TOS's pool */
+#define NUM_MD_SLABS    2           /* of these, kept back for MDs if possible */
+#define SLAB_BLOCKS     4           /* 64-byte objects per slab */
+#define LEN_OSM_BLOCK   (2+64)      /* in bytes, including control word */
+/* size of a slab, in bytes: */
+#define SLAB_SIZE       (sizeof(SLAB)+SLAB_BLOCKS*LEN_OSM_BLOCK)
 /* size of os memory pool, in words: */
-#define LENOSM          (LEN_OSM_BLOCK*NUM_OSM_BLOCKS/sizeof(WORD))
+#define LENOSM          (NUM_OSM_SLABS*SLAB_SIZE/sizeof(WORD))
 
 
 /*
  *  local typedefs
+ *
+ *  each type of object (DMD, DND, OFD, MD) has its own slab cache.  a
+ *  slab is a header followed by as many objects of that type as fit
+ *  in it, and each object is preceded by a control word containing its
+ *  offset from the start of the slab: positive if the object is in use,
+ *  negative if it is free.  the free objects in a slab are kept in a
+ *  list, linked through their first longword.
  */
-#define MDS_PER_BLOCK   3
-
-typedef struct {
-    MD md;
-    WORD index;         /* if used, 0-2, else -1 */
-} MDEXT;
+typedef struct _slabcache SLABCACHE;
+
+typedef struct _slab SLAB;
+struct _slab {
+    SLAB *s_next;           /* next slab in same list */
+    SLAB *s_prev;           /* previous slab in c_partial, or NULL */
+    SLABCACHE *s_cache;     /* cache that the slab belongs to */
+    void *s_free;           /* first free object, or NULL */
+    WORD s_inuse;           /* number of objects in use */
+    WORD s_grown;           /* TRUE iff allocated from the memory pools */
+};
 
-typedef struct _mdb MDBLOCK;
-struct _mdb {
-    MDBLOCK *mdb_next;
-    MDEXT entry[MDS_PER_BLOCK];
+struct _slabcache {
+    SLAB *c_partial;        /* slabs with free objects */
+    WORD c_size;            /* object size in bytes (even) */
+    WORD c_count;           /* objects per slab */
+    WORD c_free;            /* total free objects in c_partial */
+    WORD c_grow;            /* TRUE iff slabs may come from the memory pools */
 };
 
+#define CACHE_MD        (MEMTYPE_OFD+1)     /* MDs follow the MGET() types */
+#define NUM_CACHES      (CACHE_MD+1)
+
 
 /*
  *  internal variables
  */
-static WORD osmptr;
-static WORD osmlen;
 static WORD osmem[LENOSM];
+static SLAB *freeslabs;     /* unused slabs from osmem[] */
+static WORD nfreeslabs;     /* number of slabs in freeslabs */
+static SLABCACHE caches[NUM_CACHES];
 
 
 /*
- *  root - root array for 'quick' pool
- *
- *  root is an array of ptrs to memblocks of size 'i' paragraphs, where
- *  'i' is the index into the array (a paragraph is 16 bytes).  Each
- *  list is singly linked.  Items on the list are deleted/added in LIFO
- *  order from the root.
+ *  root - free chain of 64-byte blocks added by FOLDRnnn.PRG
  *
- *  note: MAXQUICK used to be 20, but 5 (indexes 0-4) is now all we need,
- *  and we actually only use index 4 (all blocks are 64 bytes).
+ *  for compatibility with TOS, this is the chain for blocks of 4
+ *  paragraphs, root[4].  the control word of each block contains 4
+ *  rather than an offset, so such blocks are returned to this chain
+ *  when they are freed.
  */
 #define MAXQUICK    5
+#define FOLDR_INDEX 4
 WORD *root[MAXQUICK];
 
-static MDBLOCK *mdbroot;    /* root for partially-used MDBLOCKs */
-
 
 /*
  *  local debug counters
@@ -90,243 +109,281 @@ static LONG dbggtblk;
 
 
 /*
- * getosm - get a block of memory from the main o/s memory pool
- * (as opposed to the 'fast' list of freed blocks).
- *
- * Treats the os pool as a large array of integers, allocating from the base.
- *
- * Arguments:
- *  n -  number of words
+ *  slab_link - put a slab at the start of its cache's partial list
  */
-static WORD *getosm(WORD n)
+static void slab_link(SLABCACHE *c, SLAB *s)
 {
-    WORD *m;
+    s->s_prev = NULL;
+    s->s_next = c->c_partial;
+    if (s->s_next)
+        s->s_next->s_prev = s;
+    c->c_partial = s;
+}
+
+
+/*
+ *  slab_unlink - remove a slab from its cache's partial list
+ */
+static void slab_unlink(SLABCACHE *c, SLAB *s)
+{
+    if (s->s_prev)
+        s->s_prev->s_next = s->s_next;
+    else
+        c->c_partial = s->s_next;
+    if (s->s_next)
+        s->s_next->s_prev = s->s_prev;
+}
+
 
-    if (n > osmlen)
+/*
+ *  slab_add - give a new slab to a cache, carving it up into free objects
+ */
+static void slab_add(SLABCACHE *c, SLAB *s, WORD grown)
+{
+    char *obj;
+    WORD i;
+
+    s->s_cache = c;
+    s->s_free = NULL;
+    s->s_inuse = 0;
+    s->s_grown = grown;
+    obj = (char *)(s+1) + sizeof(WORD);
+    for (i = 0; i < c->c_count; i++, obj += c->c_size + sizeof(WORD))
     {
-        /* not enough room */
-        dbggtosm++;
-        return 0;
+        *((WORD *)obj - 1) = -(WORD)(obj - (char *)s);
+        *(void **)obj = s->s_free;
+        s->s_free = obj;
     }
 
-    m = &osmem[osmptr];         /*  start at base               */
-    osmptr += n;                /*  new base                    */
-    osmlen -= n;                /*  new length of free block    */
-    return m;                   /*  allocated memory            */
+    slab_link(c,s);
+    c->c_free += c->c_count;
+}
+
+
+/*
+ *  take_freeslab - take a slab from the os memory pool, provided that
+ *  more than 'reserve' slabs are left in it
+ */
+static SLAB *take_freeslab(WORD reserve)
+{
+    SLAB *s;
+
+    if (nfreeslabs <= reserve)
+        return NULL;
+
+    s = freeslabs;
+    freeslabs = s->s_next;
+    nfreeslabs--;
+
+    return s;
 }
 
 
 /*
- *  unlink_mdblock - unlinks an MDBLOCK from the mdb chain
+ *  slab_alloc - allocate a zeroed object from a cache
  *
- *  returns -1 iff the MDBLOCK is not on the mdb chain
+ *  returns NULL iff the cache has no free objects
  */
-static WORD unlink_mdblock(MDBLOCK *mdb)
+static void *slab_alloc(SLABCACHE *c)
 {
-    MDBLOCK *prev, *next;
+    SLAB *s;
+    void *obj;
 
-    next = mdb->mdb_next;
-    mdb->mdb_next = NULL;   /* neatness */
+    s = c->c_partial;
+    if (!s)
+        return NULL;
+
+    obj = s->s_free;
+    s->s_free = *(void **)obj;
+    *((WORD *)obj - 1) = -*((WORD *)obj - 1);   /* mark as in use */
+    c->c_free--;
+
+    if (++s->s_inuse == c->c_count)     /* slab is now full */
+        slab_unlink(c,s);
 
-    if (mdb == mdbroot)     /* first on mdb chain? */
+    bzero(obj,c->c_size);
+
+    return obj;
+}
+
+
+/*
+ *  slab_free - free an object allocated by slab_alloc()
+ *
+ *  an empty slab is released if its cache has other free objects left:
+ *  slabs from the os memory pool become available to all caches, and
+ *  slabs from the memory pools are returned to them.
+ */
+static void slab_free(void *m)
+{
+    SLABCACHE *c;
+    SLAB *s;
+    WORD offset;
+
+    offset = *((WORD *)m - 1);
+    if (offset == FOLDR_INDEX)
     {
-        mdbroot = next;     /* yes, just point root to next */
-        return 0;
+        *((WORD **) m) = root[FOLDR_INDEX];
+        root[FOLDR_INDEX] = m;
+        return;
     }
 
-    /*
-     * find previous MDBLOCK
-     */
-    for (prev = mdbroot; prev; prev = prev->mdb_next)
+    if ((offset < (WORD)(sizeof(SLAB)+sizeof(WORD))) || (offset >= (WORD)SLAB_SIZE))
+    {
+        /*  bad control word, or already free  */
+        KDEBUG(("slab_free: bad control word (0x%x), stack at 0x%p\n",offset,&m));
+#ifdef ENABLE_KDEBUG
+        while(1)
+            ;
+#endif
+        dbgfreblk++;
+        return;
+    }
+
+    s = (SLAB *)((char *)m - offset);
+    c = s->s_cache;
+
+    *((WORD *)m - 1) = -offset;         /* mark as free */
+    *(void **)m = s->s_free;
+    s->s_free = m;
+    c->c_free++;
+
+    if (s->s_inuse-- == c->c_count)     /* slab was full */
+        slab_link(c,s);
+
+    if ((s->s_inuse == 0) && (c->c_free > c->c_count))
     {
-        if (prev->mdb_next == mdb)
+        slab_unlink(c,s);
+        c->c_free -= c->c_count;
+        if (s->s_grown)
+        {
+            KDEBUG(("slab_free(): returning slab at %p to memory pools\n",s));
+            xmfree(s);
+        }
+        else
         {
-            prev->mdb_next = next; /* just snip it out */
-            return 0;
+            s->s_next = freeslabs;
+            freeslabs = s;
+            nfreeslabs++;
         }
     }
-
-    KDEBUG(("unlink_mdblock(): cannot unlink MDBLOCK at %p, not on mdb chain\n",mdb));
-    return -1;
 }
 
 
 /*
- *  xmgetmd - get an MD
+ *  obj_alloc - allocate a zeroed object of the type of a cache
+ *
+ *  when the cache has no free objects, we try, in order:
+ *    . a free slab from the os memory pool
+ *    . a block added by FOLDRnnn.PRG
+ *    . if the cache allows it, a new slab from the memory pools
  *
- *  To create a single pool for all osmem requests, MDs are grouped in
- *  blocks of 3 called MDBLOCKs which occupy 58 bytes.  MDBLOCKs are
- *  handled as follows:
- *    . they are linked in a chain, initially empty
- *    . when the first MD is required, an MDBLOCK is obtained via
- *      xmgetblk() and put on the chain, and the first slot is allocated
- *    . MDs are obtained from existing partially-used MDBLOCKS
- *    . when an MDBLOCK is full, it is removed from the chain
- *    . when an MD in a full MDBLOCK is freed, the MDBLOCK is put back
- *      on the chain
- *    . when the MDBLOCK is totally unused, it is put back on the normal
- *      free chain
+ *  the MD cache cannot grow, so caches that can leave the last few
+ *  slabs of the os memory pool to it, unless everything else fails.
+ *
+ *  returns NULL iff all of these fail
  */
-MD *xmgetmd(void)
+static void *obj_alloc(SLABCACHE *c)
 {
-    MDBLOCK *mdb = mdbroot;
-    MD *md;
-    WORD i, avail;
+    SLAB *s;
+    WORD *m;
+
+    if ( (m = slab_alloc(c)) )
+        return m;
 
-    if (!mdb)
+    if ( (s = take_freeslab(c->c_grow ? NUM_MD_SLABS : 0)) )
     {
-        mdb = MGET(MDBLOCK);
-        if (!mdb)
-            return NULL;
-
-        /* initialise new MDBLOCK */
-        mdb->mdb_next = NULL;
-        for (i = 0; i < MDS_PER_BLOCK; i++)
-            mdb->entry[i].index = -1;   /* unused */
-        mdbroot = mdb;
-        KDEBUG(("xmgetmd(): got new MDBLOCK at %p\n",mdb));
+        slab_add(c,s,FALSE);
+        return slab_alloc(c);
     }
 
-    /*
-     * allocate MD from MDBLOCK
-     */
-    for (i = 0, avail = 0, md = NULL; i < MDS_PER_BLOCK; i++)
+    if ( (m = root[FOLDR_INDEX]) )
     {
-        if (mdb->entry[i].index < 0)
-        {
-            if (!md)                /* not yet allocated */
-            {
-                mdb->entry[i].index = i;
-                md = &mdb->entry[i].md;
-                KDEBUG(("xmgetmd(): got MD at %p\n",md));
-            }
-            else avail++;
-        }
+        root[FOLDR_INDEX] = *((WORD **) m);
+        *(m - 1) = FOLDR_INDEX;
+        bzero(m,c->c_size);
+        return m;
     }
 
-    if (!md)
+    if (c->c_grow && (s = xmxalloc_os(SLAB_SIZE,MX_PREFTTRAM)))
     {
-        KDEBUG(("xmgetmd(): MDBLOCK at %p is invalid, no free entries\n",mdb));
-        return NULL;
+        KDEBUG(("obj_alloc(): got slab at %p from memory pools\n",s));
+        slab_add(c,s,TRUE);
+        return slab_alloc(c);
     }
 
-    /*
-     * remove full MDBLOCK from mdb chain
-     */
-    if (avail == 0)
+    if (c->c_grow && (s = take_freeslab(0)))
     {
-        KDEBUG(("xmgetmd(): MDBLOCK at %p is now full\n",mdb));
-        if (unlink_mdblock(mdb) == 0)
-            KDEBUG(("xmgetmd(): removed MDBLOCK at %p from mdb chain\n",mdb));
+        slab_add(c,s,FALSE);
+        return slab_alloc(c);
     }
 
-    return md;
+    dbggtosm++;
+    return NULL;
 }
 
 
 /*
- *  xmfremd - free an MD
+ *  xmgetmd - get an MD
+ *
+ *  MDs are needed to allocate from the memory pools, so the MD cache
+ *  cannot grow into them.  if there is no room left, we return NULL
+ *  (the request will fail).
  */
-void xmfremd(MD *md)
+MD *xmgetmd(void)
 {
-    MDBLOCK *mdb;
-    MDEXT *entry;
-    WORD i, avail;
+    MD *md;
 
-    i = *(WORD *)(md+1);            /* word following MD */
-    if ((i < 0) || (i >= MDS_PER_BLOCK))
-    {
-        KDEBUG(("xmfremd(): MD at %p not freed, invalid index %d\n",md,i));
-        return;
-    }
+    md = obj_alloc(&caches[CACHE_MD]);
 
-    entry = (MDEXT *)md - i;        /* point to first entry */
-    mdb = (MDBLOCK *)((char *)entry - sizeof(MDBLOCK *));
+    KDEBUG(("xmgetmd(): got MD at %p\n",md));
 
-    mdb->entry[i].index = -1;       /* mark as free */
-    KDEBUG(("xmfremd(): MD at %p freed\n",md));
+    return md;
+}
 
-    for (i = 0, avail = 0; i < MDS_PER_BLOCK; i++)
-        if (mdb->entry[i].index < 0)
-            avail++;
 
-    switch(avail) {
-    case 3:             /* remove from mdb chain & put on free chain */
-        KDEBUG(("xmfremd(): MDBLOCK at %p is now empty\n",mdb));
-        if (unlink_mdblock(mdb) == 0)
-        {
-            xmfreblk(mdb);          /* move to free chain */
-            KDEBUG(("xmfremd(): MDBLOCK at %p moved to free chain\n",mdb));
-        }
-        break;
-    case 2:
-        break;
-    case 1:             /* add to mdb chain */
-        mdb->mdb_next = mdbroot;
-        mdbroot = mdb;
-        KDEBUG(("xmfremd(): MDBLOCK at %p now has free entry, moved to mdb chain\n",mdb));
-        break;
-    default:
-        KDEBUG(("xmfremd(): MDBLOCK at %p is invalid, %d free entries\n",mdb,avail));
-        break;
-    }
+/*
+ *  xmfremd - free an MD
+ */
+void xmfremd(MD *md)
+{
+    KDEBUG(("xmfremd(): MD at %p freed\n",md));
+    slab_free(md);
 }
 
 
 /*
- *  xmgetblk - get a block of memory from the o/s pool.
+ *  xmgetblk - get a DMD, DND or OFD from its slab cache.
  *
- * First try to get a block from the 'fast' list, anchored by root[4],
- * a list of blocks of size 64 bytes.  This list is singly linked and
- * blocks are deleted/removed in LIFO order from the root.  If there
- * are no free blocks on the list, we call getosm to get a block from
- * the os memory pool.
- *
- * If we cannot get memory for an MDBLOCK, we return NULL (the request
- * will fail).  Otherwise we will attempt to free up DNDs to make space
- * and if that fails, the system will be halted.
+ * If the cache has no free objects, we add a slab to it, from the os
+ * memory pool or else from the memory pools (see obj_alloc()).  If that
+ * fails, we will attempt to free up DNDs to make space and if that
+ * fails, the system will be halted.
  *
  * Arguments:
  *  memtype: the type of request
  */
 void *xmgetblk(WORD memtype)
 {
-    WORD i, j, w, *m, *q, **r;
+    SLABCACHE *c;
+    void *m;
+    WORD j;
 
-    if ((memtype < MEMTYPE_MDBLOCK) || (memtype > MEMTYPE_OFD))
+    if ((memtype < MEMTYPE_DMD) || (memtype > MEMTYPE_OFD))
     {
         dbggtblk++;
         return NULL;
     }
 
-    /*
-     *  allocate block
-     */
-    i = 4;                          /* always from root[4] */
-    w = 32;                         /* number of words */
+    c = &caches[memtype];
 
     /*
-     * we should execute the following loop a maximum of twice: the second
-     * time only if we're allocating a DMD/DND/OFD & no memory is available
+     * we should call free_available_dnds() a maximum of twice: the
+     * second time only if the first call did not free a whole slab
      */
-    for (j = 0; ; j++)
+    for (j = 0; ; )
     {
-        if ( *(r = &root[i]) )      /* there is an item on the free list */
-        {
-            m = *r;                 /* get first item on list   */
-            *r = *((WORD **) m);    /* root points to next item */
-            break;
-        }
-
-        /* nothing on free list, try pool */
-        if ( (m = getosm(w+1)) )    /* include size of control word */
-        {
-            *m++ = i;               /* put size in control word */
-            break;
-        }
-
-        /* no memory available for an MDBLOCK, that's (sort of) OK */
-        if (memtype == MEMTYPE_MDBLOCK)
+        if ( (m = obj_alloc(c)) )
             break;
 
         /*
@@ -336,21 +393,13 @@ void *xmgetblk(WORD memtype)
          * worked, but we're here again, then it lied and we should quit
          * to avoid an infinite loop
          */
-        if ((j >= 2) || (free_available_dnds() == 0))
+        if ((j++ >= 2) || (free_available_dnds() == 0))
         {
             kcprintf(_("\033EOut of internal memory.\nUse FOLDR100.PRG to get more.\nSystem halted!\n"));
             halt();                         /*  halt system                  */
         }
     }
 
-    /*
-     *  zero out the block
-     */
-
-    if ( (q = m) )
-        for (j = 0; j < w; j++)
-            *q++ = 0;
-
     return m;
 }
 
@@ -360,28 +409,7 @@ void *xmgetblk(WORD memtype)
  */
 void xmfreblk(void *m)
 {
-    WORD i;
-
-    i = *(((WORD *)m) - 1);
-
-    if (i != 4)
-    {
-        /*  bad index  */
-        KDEBUG(("xmfreblk: bad index (0x%x), stack at 0x%p\n",i,&m));
-#ifdef ENABLE_KDEBUG
-        while(1)
-            ;
-#endif
-        dbgfreblk++;
-    }
-    else
-    {
-        /*  ok to free up  */
-        *((WORD **) m) = root[i];
-        root[i] = m;
-        if (*((WORD **)m) == m)
-            KDEBUG(("xmfreblk: Circular link in root[0x%x] at 0x%p\n",i,m));
-    }
+    slab_free(m);
 }
 
 
@@ -390,8 +418,28 @@ void xmfreblk(void *m)
  */
 void osmem_init(void)
 {
-    osmlen = LENOSM;
-    mdbroot = NULL;
+    static const WORD size[NUM_CACHES] = { sizeof(DMD), sizeof(DND), sizeof(OFD), sizeof(MD) };
+    SLABCACHE *c;
+    SLAB *s;
+    WORD i;
+
+    freeslabs = NULL;
+    nfreeslabs = NUM_OSM_SLABS;
+    for (i = 0, s = (SLAB *)osmem; i < NUM_OSM_SLABS; i++, s = (SLAB *)((char *)s + SLAB_SIZE))
+    {
+        s->s_next = freeslabs;
+        freeslabs = s;
+    }
+
+    for (i = 0, c = caches; i < NUM_CACHES; i++, c++)
+    {
+        c->c_partial = NULL;
+        c->c_size = (size[i] + 1) & ~1;
+        c->c_count = (SLAB_SIZE - sizeof(SLAB)) / (c->c_size + sizeof(WORD));
+        c->c_free = 0;
+        c->c_grow = (i != CACHE_MD);
+    }
+
     dbgfreblk = 0;
     dbggtosm = 0;
     dbggtblk = 0;
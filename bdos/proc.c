@@ -76,15 +76,12 @@ static void reserve_blocks(PD *pd, MPB *mpb);
  */
 static void reserve_blocks(PD *p, MPB *mpb)
 {
-    MD *m, **q;
-
-    for (m = *(q = &mpb->mp_mal); m; m = *q) {
-        if (m->m_own == p) {
-            *q = m->m_link; /* pouf ! like magic */
-            xmfremd(m);
-        } else {
-            q = &m->m_link;
-        }
+    MD *m, *next;
+
+    for (m = mpb->mp_mal; m; m = next) {
+        next = m->m_link;
+        if (m->m_own == p)
+            reserveit(m,mpb);   /* pouf ! like magic */
     }
 }
 
@@ -126,6 +123,10 @@ static void ixterm(PD *r)
         if (r == sft[i].f_own)
             xclose(i+NUMSTD);
 
+#if CONF_WITH_VFAT
+    close_dirhandles(r);
+#endif
+
 
     /* decrement usage counts for current directories */
 
@@ -142,6 +143,21 @@ static void ixterm(PD *r)
     if(has_alt_ram)
         free_all_owned(r, &pmdalt);
 #endif
+
+    /*
+     * make sure that everything the process wrote is on disk.  we must
+     * not return to the process via the normal error handling, so any
+     * error is intercepted here.  the buffers that could not be written
+     * stay dirty: they are retried later, and the error is reported by
+     * the next call that writes them.  a media change is still noticed
+     * by the next access to the drive, which discards them.
+     */
+    memcpy(bakbuf, errbuf, sizeof(errbuf));
+    if (!setjmp(errbuf))
+        sync_buffers(-1);
+    else
+        postpone_sync();
+    memcpy(errbuf, bakbuf, sizeof(errbuf));
 }
 
 
@@ -25,6 +25,7 @@
 #include "biosbind.h"
 #include "xbiosbind.h"
 #include "kprint.h"
+#include "string.h"
 #include "../bios/tosvars.h"
 
 
@@ -226,6 +227,66 @@ long xsetblk(int n, void *blk, long len)
     return E_OK;
 }
 
+/*
+ *  add_stats - add the statistics of a memory pool to an MXSTATS
+ */
+static void add_stats(MXSTATS *st, MPB *mp)
+{
+    MD *m;
+
+    for (m = mp->mp_mfl; m; m = m->m_link)
+    {
+        st->mx_free += m->m_length;
+        st->mx_nfree++;
+        if (m->m_length > st->mx_largest)
+            st->mx_largest = m->m_length;
+    }
+
+    for (m = mp->mp_mal; m; m = m->m_link)
+    {
+        st->mx_used += m->m_length;
+        st->mx_nused++;
+    }
+}
+
+/*
+ *  get_stats - fill in an MXSTATS for the pool(s) selected by 'mode'
+ *
+ *  returns a pointer to the MXSTATS, or NULL if the mode is invalid
+ */
+static void *get_stats(MXSTATS *st, int mode)
+{
+    if (((long)st <= 0L) || ((long)st & 1))
+        return NULL;
+
+    bzero(st,sizeof(MXSTATS));
+
+    switch(mode) {
+    case MX_STRAM:
+        add_stats(st,&pmd);
+        break;
+#if CONF_WITH_ALT_RAM
+    case MX_TTRAM:
+        if (has_alt_ram)
+            add_stats(st,&pmdalt);
+        break;
+#endif
+    case MX_PREFSTRAM:
+    case MX_PREFTTRAM:
+        add_stats(st,&pmd);
+#if CONF_WITH_ALT_RAM
+        if (has_alt_ram)
+            add_stats(st,&pmdalt);
+#endif
+        break;
+    default:
+        /* unknown mode */
+        return NULL;
+    }
+
+    return st;
+}
+
 /*
  *  xmxalloc - Function 0x44 (Mxalloc)
  */
@@ -236,6 +297,18 @@ void *xmxalloc(long amount, int mode)
 
     KDEBUG(("BDOS: Mxalloc(%ld,0x%04x)\n",amount,mode));
 
+    /*
+     * EmuTOS extension: if mode is exactly MX_STATS plus a pool selector,
+     * 'amount' points to an MXSTATS to be filled in with the fragmentation
+     * statistics of the pool(s).  MX_STATS combined with any other bits
+     * is not a statistics request, and is handled like a normal Mxalloc()
+     * (the unsupported bits are ignored as usual).
+     */
+    if ((mode & ~MX_MODEMASK) == MX_STATS) {
+        ret_value = get_stats((MXSTATS *)amount,mode & MX_MODEMASK);
+        goto ret;
+    }
+
     mode &= MX_MODEMASK;    /* ignore unsupported bits */
 
     /*
@@ -332,6 +405,24 @@ ret:
     return ret_value;
 }
 
+/*
+ *  xmxalloc_os - allocate memory for internal use by the BDOS
+ *
+ *  this is like xmxalloc(), but the memory does not belong to any
+ *  process, so it is not freed when the current process terminates.
+ *  it must be released explicitly via xmfree().
+ */
+void *xmxalloc_os(long amount, int mode)
+{
+    void *p;
+
+    p = xmxalloc(amount,mode);
+    if (p)
+        set_owner(p,NULL);
+
+    return p;
+}
+
 /*
  *  srealloc - Function 0x15 (Srealloc)
  *
@@ -397,10 +488,12 @@ long xmaddalt(UBYTE *start, LONG size)
         return -1;
 
     /* if the new block is just after a free one, just extend it */
-    for (p = pmdalt.mp_mfl; p; p = p->m_link) {
-        if (p->m_start + p->m_length == start) {
-            p->m_length += size;
-            return 0;
+    if (has_alt_ram) {
+        for (p = pmdalt.mp_mfl; p; p = p->m_link) {
+            if (p->m_start + p->m_length == start) {
+                growfree(p,&pmdalt,size);
+                return 0;
+            }
         }
     }
 
@@ -420,20 +513,11 @@ long xmaddalt(UBYTE *start, LONG size)
 
     md->m_start = start;
     md->m_length = size;
-    md->m_own = NULL;
-    if (has_alt_ram) {
-        /* some alternative RAM has already been registered, just insert it
-         * to the beginning of the free block list.
-         */
-        p = pmdalt.mp_mfl;
-        pmdalt.mp_mfl = md;
-        md->m_link = p;
-    } else {
-        md->m_link = NULL;
-        pmdalt.mp_mfl = md;
-        pmdalt.mp_mal = NULL;
+    if (!has_alt_ram) {
+        mpb_init(&pmdalt);
         has_alt_ram = 1;
     }
+    addfree(md,&pmdalt);
 
     return 0;
 }
@@ -470,6 +554,8 @@ long total_alt_ram(void)
  */
 void umem_init(void)
 {
+    MD *md;
+
     /* get the MPB */
     Getmpb((long)&pmd);
 
@@ -478,6 +564,17 @@ void umem_init(void)
     end_stram = start_stram + pmd.mp_mfl->m_length;
     KDEBUG(("umem_init(): start_stram=%p, end_stram=%p\n",start_stram,end_stram));
 
+    /*
+     * the initial MD is in the system variables, which have no room
+     * for the fields used by our free lists, so we replace it with
+     * one of our own (the os memory pool has just been initialised)
+     */
+    md = xmgetmd();
+    md->m_start = start_stram;
+    md->m_length = end_stram - start_stram;
+    mpb_init(&pmd);
+    addfree(md,&pmd);
+
 #if CONF_WITH_ALT_RAM
     /* there is no known alternative RAM initially */
     has_alt_ram = 0;
@@ -101,7 +101,8 @@ void acsi_init(void)
 LONG acsi_rw(WORD rw, LONG sector, WORD count, UBYTE *buf, WORD dev)
 {
     WORD maxsecs_per_io = 128;  /* default, should probably be 255 */
-    BOOL use_tmpbuf = FALSE;
+    WORD maxsecs_tmpbuf = maxsecs_per_io;
+    BOOL use_tmpbuf = FALSE, shift_down = FALSE;
     int retry;
     int err = 0;
     UBYTE *p, *tmp_buf = NULL;
@@ -116,23 +117,37 @@ LONG acsi_rw(WORD rw, LONG sector, WORD count, UBYTE *buf, WORD dev)
     if (((LONG)buf & 1L) || (buf >= phystop)) {
 #if CONF_WITH_FRB
         tmp_buf = get_frb_cookie();
-        if (maxsecs_per_io > FRB_SECS)
-            maxsecs_per_io = FRB_SECS;
+        if (maxsecs_tmpbuf > FRB_SECS)
+            maxsecs_tmpbuf = FRB_SECS;
 #endif
         if (!tmp_buf) {
             tmp_buf = dskbufp;
-            if (maxsecs_per_io > DSKBUF_SECS)
-                maxsecs_per_io = DSKBUF_SECS;
+            if (maxsecs_tmpbuf > DSKBUF_SECS)
+                maxsecs_tmpbuf = DSKBUF_SECS;
         }
         use_tmpbuf = TRUE;
+
+        /*
+         * when reading into an odd address in ST-RAM, we can avoid the
+         * (small) intermediate buffer by reading into the following
+         * (even) address, then moving the data down by one byte.  this
+         * is not possible for the last sector of the request, since it
+         * would overwrite the byte following the buffer.
+         */
+        if (!rw && ((LONG)buf & 1L) && (buf + (LONG)count * SECTOR_SIZE <= phystop))
+            shift_down = TRUE;
     }
 
     while(count > 0) {
         WORD numsecs;
 
-        numsecs = (count>maxsecs_per_io) ? maxsecs_per_io : count;
-
-        p = use_tmpbuf ? tmp_buf : buf;
+        if (shift_down && (count > 1)) {
+            numsecs = (count-1 > maxsecs_per_io) ? maxsecs_per_io : count-1;
+            p = buf + 1;
+        } else {
+            numsecs = (count > maxsecs_tmpbuf) ? maxsecs_tmpbuf : count;
+            p = use_tmpbuf ? tmp_buf : buf;
+        }
         if (rw && use_tmpbuf)
             memcpy(p, buf, (LONG)numsecs * SECTOR_SIZE);
 
@@ -148,7 +163,9 @@ LONG acsi_rw(WORD rw, LONG sector, WORD count, UBYTE *buf, WORD dev)
             return err;
         }
 
-        if (!rw && use_tmpbuf)
+        if (p == buf + 1)
+            memmove(buf, p, (LONG)numsecs * SECTOR_SIZE);
+        else if (!rw && use_tmpbuf)
             memcpy(buf, p, (LONG)numsecs * SECTOR_SIZE);
 
         count -= numsecs;
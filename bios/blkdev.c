@@ -49,6 +49,13 @@ BLKDEV blkdev[BLKDEVNUM];
 
 static PUN_INFO pun_info;
 
+#if CONF_WITH_BLKDEV_STATS
+static BLKSTAT blkstats[UNITSNUM];
+#define STAT_INC(unit,field)    blkstats[unit].field++
+#else
+#define STAT_INC(unit,field)
+#endif
+
 /*
  * Function prototypes
  */
@@ -59,6 +66,9 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
 static LONG bootcheck(void);
 static void bus_init(void);
 static WORD hd_boot_read(void);
+#if CONF_WITH_BLKDEV_STATS
+static WORD size_class(LONG count);
+#endif
 
 /* get intel words */
 static UWORD getiword(UBYTE *addr)
@@ -68,6 +78,14 @@ static UWORD getiword(UBYTE *addr)
     return value;
 }
 
+#if CONF_WITH_FAT32
+/* get intel longs */
+static ULONG getilong(UBYTE *addr)
+{
+    return MAKE_ULONG(getiword(addr+2), getiword(addr));
+}
+#endif
+
 /*
  * compute word checksum
  */
@@ -357,6 +375,9 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
     WORD psshift;
     UBYTE *bufstart = buf;
     GEOMETRY *geo;
+#if CONF_WITH_BLKDEV_STATS
+    ULONG start_time, elapsed;
+#endif
 
     KDEBUG(("rwabs(rw=%d, buf=%p, count=%ld, recnr=%u, dev=%d, lrecnr=%ld)\n",
             rw,buf,lcount,recnr,dev,lrecnr));
@@ -375,7 +396,7 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
         if ((dev < 0 ) || (dev >= BLKDEVNUM) || !blkdev[dev].valid)
             return EUNDEV;  /* unknown device */
 
-        if (blkdev[dev].bpb.recsiz == 0)/* invalid BPB, e.g. FAT32 or ext2 */
+        if (blkdev[dev].bpb.recsiz == 0)/* invalid BPB, e.g. ext2            */
             return ESECNF;              /* (this is an XHDI convention)    */
 
         /*
@@ -408,6 +429,7 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
         if (! (rw & RW_NOMEDIACH)) {
             if (blkdev_mediach(dev) != MEDIANOCHANGE) {
                 KDEBUG(("blkdev_rwabs(): media change detected\n"));
+                STAT_INC(unit,mediachanges);
                 return E_CHNG;
             }
         }
@@ -430,6 +452,7 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
             if (units[unit].status&UNIT_CHANGED) {
                 KDEBUG(("blkdev_rwabs(): media change detected\n"));
                 units[unit].status &= ~UNIT_CHANGED;
+                STAT_INC(unit,mediachanges);
                 return E_CHNG;
             }
         }
@@ -438,6 +461,13 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
     psshift = units[unit].psshift;
     geo = &blkdev[unit].geometry;
 
+#if CONF_WITH_BLKDEV_STATS
+    start_time = hz_200;
+    blkstats[unit].requests++;
+    blkstats[unit].sectors += lcount;
+    blkstats[unit].sizes[size_class(lcount)]++;
+#endif
+
     do {
         /* split the transfer to 15-bit count blocks (lowlevel functions take WORD count) */
         WORD scount = (lcount > CNTMAX) ? CNTMAX : lcount;
@@ -447,9 +477,13 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
                                             : disk_rw(unit, (rw & ~RW_NOTRANSLATE), lrecnr, scount, buf);
                 if (retval == E_CHNG)       /* no automatic retry on media change */
                     break;
+                if ((retval < 0) && (retries > 1))
+                    STAT_INC(unit,retries);
             } while((retval < 0) && (--retries > 0));
             if ((retval < 0L) && !(rw & RW_NOTRANSLATE))    /* only call etv_critic for logical requests */
                 retval = call_etv_critic((WORD)retval,dev);
+            if (retval == CRITIC_RETRY_REQUEST)
+                STAT_INC(unit,retries);
         } while(retval == CRITIC_RETRY_REQUEST);
         if (retval < 0)     /* error, retries exhausted */
             break;
@@ -465,6 +499,17 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
     if (retval == 0)
         units[unit].last_access = hz_200;
 
+#if CONF_WITH_BLKDEV_STATS
+    elapsed = hz_200 - start_time;
+    blkstats[unit].ticks += elapsed;
+    if (elapsed > blkstats[unit].max_ticks)
+        blkstats[unit].max_ticks = elapsed;
+    if (retval == E_CHNG)
+        blkstats[unit].mediachanges++;
+    else if (retval < 0)
+        blkstats[unit].errors++;
+#endif
+
     if (retval == E_CHNG)
         if (unit >= NUMFLOPPIES)
             disk_rescan(unit);
@@ -473,6 +518,41 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
 }
 
 
+#if CONF_WITH_BLKDEV_STATS
+
+/*
+ * size_class - get the histogram entry for a request of 'count' sectors
+ */
+static WORD size_class(LONG count)
+{
+    WORD n;
+
+    for (n = 0; (count > 1) && (n < BLKSTAT_SIZES-1); n++)
+        count >>= 1;
+
+    return n;
+}
+
+/*
+ * blkdev_stats - copy the I/O statistics of a physical unit to 'stats'
+ *
+ * if 'reset' is TRUE, the statistics are cleared afterwards
+ */
+LONG blkdev_stats(WORD unit, BLKSTAT *stats, BOOL reset)
+{
+    if ((unit < 0) || (unit >= UNITSNUM) || !units[unit].valid)
+        return EUNDEV;
+
+    memcpy(stats, &blkstats[unit], sizeof(BLKSTAT));
+    if (reset)
+        bzero(&blkstats[unit], sizeof(BLKSTAT));
+
+    return E_OK;
+}
+
+#endif /* CONF_WITH_BLKDEV_STATS */
+
+
 /*
  * get_shift - get #bits to shift left to convert from blocksize to bytes
  *
@@ -491,6 +571,72 @@ WORD get_shift(ULONG blocksize)
 }
 
 
+#if CONF_WITH_FAT32
+/*
+ * getbpb_fat32 - finish building the BPB for a FAT32 filesystem
+ *
+ * on entry, recsiz/clsiz/clsizb have been set up from the bootsector
+ */
+static LONG getbpb_fat32(BLKDEV *bdev, struct fat32_bs *b)
+{
+    BPB *bpb = &bdev->bpb;
+    ULONG tmp;
+    UWORD reserved;
+
+    /*
+     * GEMDOS always updates two copies of the FAT, so we only accept
+     * filesystems that have exactly two, mirrored, FATs
+     */
+    if ((b->fat != 2) || (getiword(b->flags) & FAT32_NOMIRROR) || getiword(b->version))
+    {
+        KDEBUG(("FAT32 filesystem with unsupported FAT layout/version\n"));
+        bpb->recsiz = 0;                    /* mark it for XHDI */
+        return 0L;
+    }
+
+    reserved = getiword(b->res);
+    if (reserved == 0)
+        reserved = 1;
+
+    /* the 16-bit fields are not valid for FAT32 */
+    bpb->rdlen = bpb->fsiz = bpb->fatrec = bpb->datrec = bpb->numcl = 0;
+
+    bpb->fsiz32 = getilong(b->spf32);
+    bpb->fatrec32 = reserved + bpb->fsiz32;
+    bpb->datrec32 = bpb->fatrec32 + bpb->fsiz32;
+
+    tmp = getilong(b->sec2);
+    tmp = (tmp > bpb->datrec32) ? (tmp - bpb->datrec32) / b->spc : 0;
+    bpb->numcl32 = tmp;
+    bpb->rootcl = getilong(b->rootcl);
+    if ((tmp == 0) || (tmp > MAX_FAT32_CLUSTERS)
+     || (bpb->rootcl < 2) || (bpb->rootcl >= tmp+2))
+    {
+        bpb->recsiz = 0;                    /* mark it for XHDI */
+        return 0L;
+    }
+
+    bpb->fsinfo = getiword(b->fsinfo);
+    if (bpb->fsinfo >= reserved)            /* includes 0xffff (none) */
+        bpb->fsinfo = 0;
+    bpb->b_flags = B_32;
+
+    /* additional geometry info */
+    bdev->geometry.sides = getiword(b->sides);
+    bdev->geometry.spt = getiword(b->spt);
+    memcpy(bdev->serial,b->serial,3);
+    memcpy(bdev->serial2,b->serial2,4);
+
+    KDEBUG(("bpb32[dev=%d] = {\n  fsiz = %lu;\n  fatrec = %lu;\n  datrec = %lu;\n",
+            (int)(bdev-blkdev),bpb->fsiz32,bpb->fatrec32,bpb->datrec32));
+    KDEBUG(("  numcl = %lu;\n  rootcl = %lu;\n  fsinfo = %u;\n}\n",
+            bpb->numcl32,bpb->rootcl,bpb->fsinfo));
+
+    return (LONG)bpb;
+}
+#endif
+
+
 /*
  * blkdev_getbpb - Get BIOS parameter block
  *
@@ -561,9 +707,18 @@ LONG blkdev_getbpb(WORD dev)
     KDEBUG(("bootsector[dev=%d] = {\n  ...\n  res = %d;\n  hid = %d;\n}\n",
             dev,getiword(b->res),getiword(b->hid)));
 
+    /* nor if the cluster size in bytes does not fit in the BPB */
+    if ((ULONG)recsiz * b->spc > 32768UL)
+        return 0L;
+
     bdev->bpb.recsiz = recsiz;
     bdev->bpb.clsiz = b->spc;
     bdev->bpb.clsizb = bdev->bpb.clsiz * bdev->bpb.recsiz;
+
+#if CONF_WITH_FAT32
+    if (getiword(b->spf) == 0)              /* only FAT32 has this */
+        return getbpb_fat32(bdev,(struct fat32_bs *)dskbufp);
+#endif
     tmp = getiword(b->dir);
     if (bdev->bpb.recsiz != 0)
         bdev->bpb.rdlen = (tmp * 32) / bdev->bpb.recsiz;
@@ -592,7 +747,7 @@ LONG blkdev_getbpb(WORD dev)
     if (tmp == 0L)
         tmp = MAKE_ULONG(getiword(b16->sec2+2), getiword(b16->sec2));
     tmp = (tmp - bdev->bpb.datrec) / b->spc;
-    if (tmp > MAX_FAT16_CLUSTERS)           /* FAT32 - unsupported */
+    if (tmp > MAX_FAT16_CLUSTERS)           /* should be FAT32 - unsupported */
     {
         bdev->bpb.recsiz = 0;               /* mark it for XHDI */
         return 0L;
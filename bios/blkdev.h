@@ -23,6 +23,7 @@
  */
 #define MAX_FAT12_CLUSTERS  4078    /* architectural constants */
 #define MAX_FAT16_CLUSTERS  65518
+#define MAX_FAT32_CLUSTERS  0x0ffffff5UL
 
 #define MAX_LOGSEC_SIZE     16384L
 
@@ -81,6 +82,42 @@ struct fat16_bs {
   /* 1fe */  UBYTE cksum[2];
 };
 
+/* FAT32 bootsector */
+struct fat32_bs {
+  /*   0 */  UBYTE bra[2];
+  /*   2 */  UBYTE loader[6];
+  /*   8 */  UBYTE serial[3];
+  /*   b */  UBYTE bps[2];    /* bytes per sector */
+  /*   d */  UBYTE spc;       /* sectors per cluster */
+  /*   e */  UBYTE res[2];    /* number of reserved sectors */
+  /*  10 */  UBYTE fat;       /* number of FATs */
+  /*  11 */  UBYTE dir[2];    /* number of DIR root entries (always 0) */
+  /*  13 */  UBYTE sec[2];    /* total number of sectors (always 0) */
+  /*  15 */  UBYTE media;     /* media descriptor */
+  /*  16 */  UBYTE spf[2];    /* sectors per FAT (always 0) */
+  /*  18 */  UBYTE spt[2];    /* sectors per track */
+  /*  1a */  UBYTE sides[2];  /* number of sides */
+  /*  1c */  UBYTE hid[4];    /* number of hidden sectors */
+  /*  20 */  UBYTE sec2[4];   /* total number of sectors */
+  /*  24 */  UBYTE spf32[4];  /* sectors per FAT */
+  /*  28 */  UBYTE flags[2];  /* FAT mirroring flags */
+  /*  2a */  UBYTE version[2];/* filesystem version */
+  /*  2c */  UBYTE rootcl[4]; /* first cluster of root directory */
+  /*  30 */  UBYTE fsinfo[2]; /* sector number of FSInfo sector */
+  /*  32 */  UBYTE bkboot[2]; /* sector number of backup bootsector */
+  /*  34 */  UBYTE reserved[12];
+  /*  40 */  UBYTE ldn;       /* logical drive number */
+  /*  41 */  UBYTE dirty;     /* dirty filesystem flags */
+  /*  42 */  UBYTE ext;       /* extended signature */
+  /*  43 */  UBYTE serial2[4]; /* extended serial number */
+  /*  47 */  UBYTE label[11]; /* volume label */
+  /*  52 */  UBYTE fstype[8]; /* file system type */
+  /*  5a */  UBYTE data[0x1a4];
+  /* 1fe */  UBYTE cksum[2];
+};
+
+#define FAT32_NOMIRROR  0x0080  /* in flags: only one FAT is active */
+
 
 struct _geometry        /* disk parameter block */
 {
@@ -152,6 +189,33 @@ struct _blkdev
 };
 typedef struct _blkdev  BLKDEV;
 
+#if CONF_WITH_BLKDEV_STATS
+
+/*
+ * I/O statistics for a physical unit, maintained by blkdev_rwabs().
+ * Times are in 200 Hz ticks, sizes are in physical sectors.
+ * sizes[n] counts the requests of 2^n to 2^(n+1)-1 sectors; the last
+ * entry also counts all larger requests.
+ */
+#define BLKSTAT_SIZES   8
+
+struct _blkstat
+{
+    ULONG       requests;       /* Rwabs() requests that reached the unit */
+    ULONG       sectors;        /* sectors requested */
+    ULONG       retries;        /* automatic & critical error handler retries */
+    ULONG       errors;         /* requests that failed */
+    ULONG       mediachanges;   /* requests rejected because of a media change */
+    ULONG       ticks;          /* cumulative request time */
+    ULONG       max_ticks;      /* longest request time */
+    ULONG       sizes[BLKSTAT_SIZES];   /* request size histogram */
+};
+typedef struct _blkstat BLKSTAT;
+
+LONG blkdev_stats(WORD unit, BLKSTAT *stats, BOOL reset);
+
+#endif
+
 /*
  * defined in blkdev.c, also used in floppy.c
  */
@@ -28,6 +28,21 @@
 #define  plane_offset   2       /* interleaved planes */
 
 
+#if CONF_WITH_VDI_16BIT
+/*
+ * In Truecolor modes, the console colours (0-15) are converted to
+ * RGB565 pixel values that match the default Falcon palette.
+ */
+static const UWORD tc_colours[16] = {
+    0xffff, 0xf800, 0x07e0, 0xffe0, 0x001f, 0xf81f, 0x07ff, 0xbdd7,
+    0x8c51, 0xa800, 0x0540, 0xad40, 0x0015, 0xa815, 0x0555, 0x0000
+};
+
+#define TC_PIXEL(col)   tc_colours[(col) & 0x0f]
+#define TC_CELL_WIDTH   (8 * sizeof(UWORD))     /* bytes in one cell row */
+#endif
+
+
 
 /*
  * internal prototypes
@@ -175,6 +190,27 @@ blank_out (int topx, int topy, int botx, int boty)
     /* # of lines in region - 1 */
     rows = (boty - topy + 1) * v_cel_ht;
 
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE) {
+        /* pack two pixels into a LONG, 16 pixels per cell pair */
+        ULONG pixels = TC_PIXEL(color);
+        int i;
+
+        pixels |= pixels << 16;
+
+        for (row = rows; row--;) {
+            for (pair = pairs; pair--;) {
+                for (i = 0; i < 8; i++) {
+                    *(ULONG*)addr = pixels;
+                    addr += sizeof(ULONG);
+                }
+            }
+            addr += offs;       /* skip non-region area with stride advance */
+        }
+        return;
+    }
+#endif
+
     if (v_planes > 1) {
         /* Color modes are optimized for handling 2 planes at once */
         ULONG pair_planes[4];        /* bits on screen for 8 planes max */
@@ -262,10 +298,19 @@ cell_addr(int x, int y)
     if ( y >= v_cel_my )
         y = v_cel_my;           /* clipped y */
 
-    /* X displacement = even(X) * v_planes + Xmod2 */
-    disx = (LONG)v_planes * (x & ~1);
-    if ( x & 1 ) {              /* Xmod2 = 0 ? */
-        disx++;                 /* Xmod2 = 1 */
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE) {
+        /* packed pixels: every cell has its own bytes */
+        disx = (LONG)TC_CELL_WIDTH * x;
+    }
+    else
+#endif
+    {
+        /* X displacement = even(X) * v_planes + Xmod2 */
+        disx = (LONG)v_planes * (x & ~1);
+        if ( x & 1 ) {          /* Xmod2 = 0 ? */
+            disx++;             /* Xmod2 = 1 */
+        }
     }
 
     /* Y displacement = Y // cell conversion factor */
@@ -319,6 +364,24 @@ cell_xfer(UBYTE * src, UBYTE * dst)
         bg = v_col_bg;
     }
 
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE) {
+        UWORD fgpixel = TC_PIXEL(fg), bgpixel = TC_PIXEL(bg);
+        int i;
+
+        for (i = v_cel_ht; i--; ) {
+            UWORD *pixel = (UWORD *)dst;
+            UBYTE mask;
+
+            for (mask = 0x80; mask; mask >>= 1)
+                *pixel++ = (*src & mask) ? fgpixel : bgpixel;
+            dst += line_wr;
+            src += fnt_wr;
+        }
+        return;
+    }
+#endif
+
     src_sav = src;
     dst_sav = dst;
 
@@ -465,6 +528,21 @@ neg_cell(UBYTE * cell)
 
     v_stat_0 |= M_CRIT;                 /* start of critical section. */
 
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE) {
+        for (len = cell_len; len--; ) {
+            ULONG *addr = (ULONG *)cell;
+            int i;
+
+            for (i = 0; i < TC_CELL_WIDTH / sizeof(ULONG); i++, addr++)
+                *addr = ~*addr;
+            cell += v_lin_wr;
+        }
+        v_stat_0 &= ~M_CRIT;            /* end of critical section. */
+        return;
+    }
+#endif
+
     for (plane = v_planes; plane--; ) {
         UBYTE * addr = cell;            /* top of current dest plane */
 
@@ -529,6 +607,13 @@ static BOOL next_cell(void)
 
     v_cur_cx += 1;                      /* next cell to right */
 
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE) {
+        v_cur_ad += TC_CELL_WIDTH;      /* cells are contiguous */
+        return 0;                       /* indicate no wrap needed */
+    }
+#endif
+
     /* if X is even, move to next word in the plane */
     if ( v_cur_cx & 1 ) {
         /* x is odd */
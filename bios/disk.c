@@ -515,16 +515,23 @@ static int atari_partition(UWORD unit,LONG *devices_available)
                         next_extended = start + first_extended;
                     }
                     break;
+#if !CONF_WITH_FAT32
                 case 0x0b:
                 case 0x0c:
+#endif
                 case 0x83:      /* any Linux partition, including ext2 */
                     /*
-                     * note that FAT32 & Linux partitions occupy drive letters,
-                     * but are not yet accessible to EmuTOS.  however, we allow
-                     * access via XHDI for MiNT's benefit.
+                     * note that Linux (and, if not configured, FAT32)
+                     * partitions occupy drive letters, but are not
+                     * accessible to EmuTOS.  however, we allow access
+                     * via XHDI for MiNT's benefit.
                      */
-                    KDEBUG((" %s partition: not yet supported\n",(type==0x83)?"Linux":"FAT32"));
+                    KDEBUG((" %s partition: not supported\n",(type==0x83)?"Linux":"FAT32"));
                     /* drop through */
+#if CONF_WITH_FAT32
+                case 0x0b:      /* FAT32 */
+                case 0x0c:      /* FAT32 (LBA) */
+#endif
                 case 0x01:
                 case 0x04:
                 case 0x06:
@@ -863,6 +870,41 @@ LONG disk_rw(UWORD unit, UWORD rw, ULONG sector, UWORD count, UBYTE *buf)
     return ret;
 }
 
+/*
+ * Unit read throughput
+ *
+ * this is only supported by drivers whose xxx_ioctl() implements
+ * GET_THROUGHPUT; the others return an error
+ */
+LONG disk_throughput(UWORD unit, ULONG *rate)
+{
+    UWORD major = unit - NUMFLOPPIES;
+    LONG ret;
+    WORD bus, reldev;
+    MAYBE_UNUSED(reldev);
+
+    bus = GET_BUS(major);
+    reldev = major - bus * DEVICES_PER_BUS;
+
+    switch(bus) {
+#if CONF_WITH_IDE
+    case IDE_BUS:
+        ret = ide_ioctl(reldev,GET_THROUGHPUT,rate);
+        break;
+#endif /* CONF_WITH_IDE */
+#if CONF_WITH_SDMMC
+    case SDMMC_BUS:
+        ret = sd_ioctl(reldev,GET_THROUGHPUT,rate);
+        break;
+#endif /* CONF_WITH_SDMMC */
+    default:
+        ret = EUNDEV;
+    }
+
+    KDEBUG(("disk_throughput(%d) returned %ld\n",unit,ret));
+    return ret;
+}
+
 /*==== XBIOS functions ====================================================*/
 
 LONG DMAread(LONG sector, WORD count, UBYTE *buf, WORD major)
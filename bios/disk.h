@@ -45,6 +45,8 @@
                                 /*   [1] sector size (in bytes)       */
 #define GET_DISKNAME        21  /* get name of specified drive:       */
                                 /* arg -> return data (max 40 chars)  */
+#define GET_THROUGHPUT      22  /* measure read rate of spec. drive:  */
+                                /* arg -> ULONG: rate in KB/sec       */
 #define GET_MEDIACHANGE     30  /* return status as per Mediach() call*/
                                 /* arg is NULL                        */
 
@@ -93,6 +95,7 @@ extern UNIT units[];
 LONG disk_inquire(UWORD unit, ULONG *blocksize, ULONG *deviceflags, char *productname, UWORD stringlen);
 LONG disk_get_capacity(UWORD unit, ULONG *blocks, ULONG *blocksize);
 LONG disk_rw(UWORD unit, UWORD rw, ULONG sector, UWORD count, UBYTE *buf);
+LONG disk_throughput(UWORD unit, ULONG *rate);
 
 /* xbios functions */
 
@@ -31,6 +31,7 @@
 #include "delay.h"
 #include "processor.h"
 #include "cookie.h"
+#include "biosmem.h"
 #ifdef MACHINE_AMIGA
 #include "amiga.h"
 #endif
@@ -84,6 +85,9 @@
 /*
  * structure to track floppy drive state
  */
+/* the largest track/side that the track cache can hold (HD diskettes) */
+#define TRACK_CACHE_SECS    18
+
 struct flop_info {
     WORD rate;          /* rate selected via Floprate() */
     WORD actual_rate;   /* value to send to 1772 controller */
@@ -95,6 +99,12 @@ struct flop_info {
     UBYTE wpstatus;     /* current write protect status */
     UBYTE wplatch;      /* latched copy of wpstatus */
 #endif
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+    UBYTE *tc_buf;      /* track cache buffer */
+    WORD tc_track;      /* track held in tc_buf, or -1 if none */
+    WORD tc_side;       /* side held in tc_buf */
+    WORD tc_spt;        /* sectors per track when tc_buf was filled */
+#endif
 };
 
 /*==== Internal prototypes ==============================================*/
@@ -113,6 +123,13 @@ static WORD flopwtrack(UBYTE *buf, WORD dev, WORD track, WORD side,
 /* initialise a floppy for hdv_init */
 static void flop_detect_drive(WORD dev);
 
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+/* discard the cached track of a drive */
+static void tcache_invalidate(WORD dev);
+#else
+#define tcache_invalidate(dev)
+#endif
+
 #if CONF_WITH_FDC
 
 /* called at start and end of a floppy access. */
@@ -200,6 +217,11 @@ static void falcon_wait(void);
  * state of the write-protect status bit.  finfo[].wplatch is a latched copy
  * of wpstatus.  see "handling of media change" below for more details.
  *
+ * finfo[].tc_buf, if non-NULL, points to an ST-RAM buffer holding a copy
+ * of one complete track/side of the current diskette, as identified by
+ * finfo[].tc_track, finfo[].tc_side and finfo[].tc_spt.  a tc_track of -1
+ * means the buffer is empty.  see "track cache" below for more details.
+ *
  * the flock system variable is used as following :
  * - floppy.c will set it before accessing to the DMA/FDC, and
  *   clear it at the end.
@@ -283,6 +305,10 @@ static void flop_init(WORD dev)
     finfo[dev].wpstatus = 0;
     finfo[dev].wplatch = 0;
 #endif
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+    finfo[dev].tc_buf = NULL;
+    finfo[dev].tc_track = -1;
+#endif
 }
 
 void flop_hdv_init(void)
@@ -339,6 +365,11 @@ static void flop_add_drive(WORD dev)
     /* FDC floppy device */
     finfo[dev].cur_track = 0;
 #endif
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+    /* we are called before the BDOS is initialised, so this is allowed */
+    finfo[dev].tc_buf = balloc_stram((ULONG)TRACK_CACHE_SECS*SECTOR_SIZE, FALSE);
+    finfo[dev].tc_track = -1;
+#endif
 
     /* Physical block device */
     units[dev].valid = 1;
@@ -434,8 +465,10 @@ LONG flop_mediach(WORD dev)
     /*
      * the latch has been set, so we have a possible or definite diskette
      * change.  we clear the latch & will report a change of some kind.
+     * whatever the outcome, the cached track can no longer be trusted.
      */
     fi->wplatch = FALSE;
+    tcache_invalidate(dev);
 
     /*
      * if the current status is clear, then we must have gone from a WP
@@ -490,6 +523,68 @@ LONG flop_mediach(WORD dev)
 }
 
 
+/*==== Track cache ========================================================*/
+
+/*
+ * reading a diskette one sector at a time is slow: after each sector,
+ * the FDC usually has to wait for almost a complete revolution before
+ * the next one comes round again.  when the BDOS reads a file in small
+ * pieces, this happens for nearly every sector.
+ *
+ * to avoid this, each drive may have a buffer that holds one complete
+ * track/side.  a partial-track read fills it on first access, and
+ * following reads of sectors of the same track/side are served from RAM.
+ * the buffer is invalidated when a write or format is done to the drive,
+ * when flop_mediach() detects a possible media change, and when the
+ * drive is deselected (since the diskette may then be swapped).
+ */
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+
+static void tcache_invalidate(WORD dev)
+{
+    finfo[dev].tc_track = -1;
+}
+
+static WORD floprw_cached(UBYTE *buf, WORD rw, WORD dev,
+                    WORD sect, WORD track, WORD side, WORD count, WORD spt)
+{
+    struct flop_info *f = &finfo[dev];
+    WORD err;
+
+    /*
+     * writes, whole-track reads, and tracks that don't fit in the buffer
+     * go straight to the diskette
+     */
+    if (((rw & RW_RW) != RW_READ) || !f->tc_buf
+     || (count >= spt) || (spt > TRACK_CACHE_SECS))
+        return floprw(buf, rw, dev, sect, track, side, count);
+
+    if ((f->tc_track != track) || (f->tc_side != side) || (f->tc_spt != spt)) {
+        KDEBUG(("floprw_cached(): filling cache, track=%d, side=%d\n",track,side));
+        err = floprw(f->tc_buf, RW_READ, dev, 1, track, side, spt);
+        if (err) {
+            /* e.g. a bad sector elsewhere on the track: read only what's needed */
+            tcache_invalidate(dev);
+            return floprw(buf, rw, dev, sect, track, side, count);
+        }
+        f->tc_track = track;
+        f->tc_side = side;
+        f->tc_spt = spt;
+    }
+
+    memcpy(buf, f->tc_buf + (LONG)(sect-1) * SECTOR_SIZE, (LONG)count * SECTOR_SIZE);
+
+    return 0;
+}
+
+#else
+
+#define floprw_cached(buf,rw,dev,sect,track,side,count,spt) \
+            floprw(buf,rw,dev,sect,track,side,count)
+
+#endif /* CONF_WITH_FLOPPY_TRACK_CACHE */
+
+
 LONG floppy_rw(WORD rw, UBYTE *buf, WORD cnt, LONG recnr, WORD spt,
                WORD sides, WORD dev)
 {
@@ -533,7 +628,7 @@ LONG floppy_rw(WORD rw, UBYTE *buf, WORD cnt, LONG recnr, WORD spt,
         numsecs = spt - start_relsec;
         KDEBUG(("floppy_rw() #1: track=%d, side=%d, start=%d, count=%d\n",
                 track,side,start_relsec+1,numsecs));
-        err = floprw(buf, rw, dev, start_relsec+1, track, side, numsecs);
+        err = floprw_cached(buf, rw, dev, start_relsec+1, track, side, numsecs, spt);
         if (err)
             return err;
         buf += SECTOR_SIZE * numsecs;
@@ -573,7 +668,7 @@ LONG floppy_rw(WORD rw, UBYTE *buf, WORD cnt, LONG recnr, WORD spt,
     numsecs = end_relsec - start_relsec + 1;
     KDEBUG(("floppy_rw() #3: track=%d, side=%d, start=%d, count=%d\n",
             track,side,start_relsec+1,numsecs));
-    err = floprw(buf, rw, dev, start_relsec+1, track, side, numsecs);
+    err = floprw_cached(buf, rw, dev, start_relsec+1, track, side, numsecs, spt);
     if (err)
         return err;
 
@@ -925,6 +1020,9 @@ static WORD floprw(UBYTE *userbuf, WORD rw, WORD dev,
 
     rw &= RW_RW;    /* remove any extraneous bits */
 
+    if (rw == RW_WRITE)
+        tcache_invalidate(dev);
+
     if ((rw == RW_WRITE) && (track == 0) && (sect == 1) && (side == 0)) {
         /* TODO, maybe media changed ? */
     }
@@ -1052,6 +1150,8 @@ static WORD flopwtrack(UBYTE *userbuf, WORD dev, WORD track, WORD side, WORD tra
     /* flush cache here so that track image is pushed to memory */
     flush_data_cache(userbuf,track_size);
 
+    tcache_invalidate(dev);
+
     f->cur_density = density;   /* used by floplock() */
     floplock(dev);
 
@@ -1308,6 +1408,10 @@ static void deselect(void)
 {
     select(-1,0);
     deselect_time = 0UL;
+
+    /* the diskette may be swapped from now on */
+    tcache_invalidate(0);
+    tcache_invalidate(1);
 }
 
 /*
@@ -204,6 +204,10 @@ struct IDE
 #define IDE_CMD_READ_MULTIPLE       0xc4
 #define IDE_CMD_WRITE_MULTIPLE      0xc5
 #define IDE_CMD_SET_MULTIPLE_MODE   0xc6
+#define IDE_CMD_READ_SECTOR_EXT     0x24    /* LBA48 versions of the above */
+#define IDE_CMD_WRITE_SECTOR_EXT    0x34
+#define IDE_CMD_READ_MULTIPLE_EXT   0x29
+#define IDE_CMD_WRITE_MULTIPLE_EXT  0x39
 
 #define IDE_MODE_CHS    (0 << 6)
 #define IDE_MODE_LBA    (1 << 6)
@@ -220,14 +224,23 @@ struct IDE
 
 #define IDE_ERROR_ABRT  (1 << 2)
 
+#define IDE_CMDSET_LBA48    (1 << 10)   /* in identify.cmds_supported[1] */
+
 /*
- * maximum number of sectors per physical i/o.  this MUST not exceed 256,
- * at least for LBA28-style commands.  the best performance is obtained
- * if this is a multiple of the sectors-per-interrupt value supported by
- * the drive(s) in multiple mode.
+ * maximum number of sectors per physical i/o.  this MUST not exceed 256
+ * for LBA28-style commands, or 65536 for LBA48-style commands.  the best
+ * performance is obtained if this is a multiple of the sectors-per-interrupt
+ * value supported by the drive(s) in multiple mode.
  */
-#define MAXSECS_PER_IO  32
+#define MAXSECS_PER_IO          256
+#define MAXSECS_PER_IO_LBA48    32767   /* i.e. no limit for Rwabs() requests */
+
+#define LBA28_MAXSECS   0x10000000UL    /* number of sectors addressable via LBA28 */
+
 
+/* PIO data transfer function (see ide_init_xfer()) */
+
+typedef void (*IDE_XFER)(volatile XFERWIDTH *port,UBYTE *buffer,ULONG bufferlen);
 
 /* interface/device info */
 
@@ -239,6 +252,9 @@ struct IFINFO {
     } dev[2];
     volatile struct IDE *base_address;
     BOOL twisted_cable;
+    volatile XFERWIDTH *data_port;  /* allowing for twisted cable */
+    IDE_XFER get_data[2];   /* indexed by need_byteswap */
+    IDE_XFER put_data[2];   /* indexed by need_byteswap */
 };
 
 #define DEVTYPE_NONE    0               /* for 'type' */
@@ -247,6 +263,7 @@ struct IFINFO {
 #define DEVTYPE_ATAPI   3
 
 #define MULTIPLE_MODE_ACTIVE    0x01    /* for 'options' */
+#define LBA48_ACTIVE            0x02
 
 
 /* timing stuff */
@@ -258,6 +275,10 @@ struct IFINFO {
 #define XFER_TIMEOUT    (CLOCKS_PER_SEC)    /* 1000ms for data xfer */
 #define LONG_TIMEOUT    (31*CLOCKS_PER_SEC) /* 31 seconds for reset (!)*/
 
+#define BENCH_SECTORS   64                  /* sectors per read when measuring throughput */
+#define BENCH_RANGE     65536UL             /* sectors stepped through (larger than drive caches) */
+#define BENCH_TICKS     CLOCKS_PER_SEC      /* minimum duration of measurement */
+
 static int has_ide;
 static struct IFINFO ifinfo[NUM_IDE_INTERFACES];
 static ULONG delay400ns;
@@ -282,6 +303,9 @@ static struct {
 static WORD clear_multiple_mode(UWORD ifnum,UWORD dev);
 static void ide_detect_devices(UWORD ifnum);
 static LONG ide_identify(WORD dev);
+static void ide_init_xfer(UWORD ifnum);
+static LONG ide_throughput(WORD dev,ULONG *rate);
+static void set_lba48_mode(WORD dev);
 static void set_multiple_mode(WORD dev,UWORD multi_io);
 static int wait_for_not_BSY(volatile struct IDE *interface,LONG timeout);
 
@@ -454,15 +478,21 @@ void ide_init(void)
     KDEBUG(("ide_init(): has_ide = 0x%02x\n",has_ide));
 #endif
 
-    /* detect devices */
-    for (i = 0, bitmask = 1; i < NUM_IDE_INTERFACES; i++, bitmask <<= 1)
-        if (has_ide&bitmask)
+    /* choose data transfer functions & detect devices */
+    for (i = 0, bitmask = 1; i < NUM_IDE_INTERFACES; i++, bitmask <<= 1) {
+        if (has_ide&bitmask) {
+            ide_init_xfer(i);
             ide_detect_devices(i);
+        }
+    }
 
-    /* set multiple mode for all devices that we have info for */
-    for (i = 0; i < DEVICES_PER_BUS; i++)
-        if (ide_identify(i) == 0)
+    /* set multiple mode & LBA48 for all devices that we have info for */
+    for (i = 0; i < DEVICES_PER_BUS; i++) {
+        if (ide_identify(i) == 0) {
+            set_lba48_mode(i);
             set_multiple_mode(i,identify.multiple_io_info);
+        }
+    }
 }
 
 static int ide_device_exists(WORD dev)
@@ -670,6 +700,25 @@ static void ide_rw_start(volatile struct IDE *interface,UWORD dev,ULONG sector,U
     IDE_WRITE_COMMAND_HEAD(cmd,IDE_MODE_LBA|IDE_DEVICE(dev)|(UBYTE)((sector>>24)&0x0f));
 }
 
+/*
+ * as above, for LBA48-style commands
+ *
+ * the sector count & LBA registers are written twice: first with the
+ * high-order bytes, then with the low-order ones.  since sector numbers
+ * are only 32 bits, LBA bits 32-47 are always zero.  a count of 0 means
+ * 65536 sectors.
+ */
+static void ide_rw_start48(volatile struct IDE *interface,UWORD dev,ULONG sector,UWORD count,UBYTE cmd)
+{
+    KDEBUG(("ide_rw_start48(0x%08lx, %u, %lu, %u, 0x%02x)\n", (ULONG)interface, dev, sector, count, cmd));
+
+    IDE_WRITE_SECTOR_NUMBER_SECTOR_COUNT((UBYTE)(sector>>24), HIBYTE(count));
+    IDE_WRITE_CYLINDER_HIGH_CYLINDER_LOW(0);
+    IDE_WRITE_SECTOR_NUMBER_SECTOR_COUNT(LOBYTE(sector), LOBYTE(count));
+    IDE_WRITE_CYLINDER_HIGH_CYLINDER_LOW((UWORD)((sector & 0xffff00) >> 8));
+    IDE_WRITE_COMMAND_HEAD(cmd,IDE_MODE_LBA|IDE_DEVICE(dev));
+}
+
 /*
  * perform a non-data-transfer command
  */
@@ -693,68 +742,134 @@ static LONG ide_nodata(UBYTE cmd,UWORD ifnum,UWORD dev,ULONG sector,UWORD count)
     return E_OK;
 }
 
+/*
+ * PIO data transfer functions
+ *
+ * these move data between a buffer and the data register of an interface,
+ * 32 bytes per loop iteration (the transfer length is always a multiple
+ * of SECTOR_SIZE).  there is a version for each direction and byteswap
+ * mode; ide_init_xfer() chooses the ones to use for each interface,
+ * according to the processor.
+ */
+#define REPEAT8(x)  x; x; x; x; x; x; x; x
+#if IDE_32BIT_XFER
+#define XFER_32BYTES(x) REPEAT8(x)
+#else
+#define XFER_32BYTES(x) REPEAT8(x); REPEAT8(x)
+#endif
+
+#define GET_DATA            *p++ = *port
+#define GET_DATA_SWAPPED    temp = *port; xferswap(temp); *p++ = temp
+#define PUT_DATA            *port = *p++
+#define PUT_DATA_SWAPPED    temp = *p++; xferswap(temp); *port = temp
+
+static void get_data(volatile XFERWIDTH *port,UBYTE *buffer,ULONG bufferlen)
+{
+    XFERWIDTH *p = (XFERWIDTH *)buffer;
+    ULONG n;
+
+    for (n = bufferlen / 32; n; n--) {
+        XFER_32BYTES(GET_DATA);
+    }
+}
+
+static void get_data_swapped(volatile XFERWIDTH *port,UBYTE *buffer,ULONG bufferlen)
+{
+    XFERWIDTH *p = (XFERWIDTH *)buffer;
+    XFERWIDTH temp;
+    ULONG n;
+
+    for (n = bufferlen / 32; n; n--) {
+        XFER_32BYTES(GET_DATA_SWAPPED);
+    }
+}
+
+static void put_data(volatile XFERWIDTH *port,UBYTE *buffer,ULONG bufferlen)
+{
+    XFERWIDTH *p = (XFERWIDTH *)buffer;
+    ULONG n;
+
+    for (n = bufferlen / 32; n; n--) {
+        XFER_32BYTES(PUT_DATA);
+    }
+}
+
+static void put_data_swapped(volatile XFERWIDTH *port,UBYTE *buffer,ULONG bufferlen)
+{
+    XFERWIDTH *p = (XFERWIDTH *)buffer;
+    XFERWIDTH temp;
+    ULONG n;
+
+    for (n = bufferlen / 32; n; n--) {
+        XFER_32BYTES(PUT_DATA_SWAPPED);
+    }
+}
+
 #if CONF_WITH_APOLLO_68080
 /* Apollo IDE data register can be read (but not written) using 32-bit access */
-static void ide_get_data_32(volatile struct IDE *interface,UBYTE *buffer,ULONG bufferlen,int need_byteswap)
+static void get_data_32(volatile XFERWIDTH *port,UBYTE *buffer,ULONG bufferlen)
 {
     ULONG *p = (ULONG *)buffer;
-    ULONG *end = (ULONG *)(buffer + bufferlen);
-    volatile ULONG_ALIAS *pdatareg = (volatile ULONG_ALIAS *)&interface->data;
-
-    if (need_byteswap) {
-        while (p < end) {
-            ULONG temp;
-            temp = *pdatareg;
-            swpw2(temp);
-            *p++ = temp;
-        }
-    } else {
-        while (p < end)
-            *p++ = *pdatareg;
+    volatile ULONG_ALIAS *pdatareg = (volatile ULONG_ALIAS *)port;
+    ULONG n;
+
+    for (n = bufferlen / 32; n; n--) {
+        REPEAT8(*p++ = *pdatareg);
+    }
+}
+
+static void get_data_32_swapped(volatile XFERWIDTH *port,UBYTE *buffer,ULONG bufferlen)
+{
+    ULONG *p = (ULONG *)buffer;
+    volatile ULONG_ALIAS *pdatareg = (volatile ULONG_ALIAS *)port;
+    ULONG n, temp;
+
+    for (n = bufferlen / 32; n; n--) {
+        REPEAT8(temp = *pdatareg; swpw2(temp); *p++ = temp);
     }
 }
 #endif /* CONF_WITH_APOLLO_68080 */
 
 /*
- * get data from IDE device
+ * choose the data transfer functions for an interface
+ *
+ * this must be called after twisted cable detection
  */
-static void ide_get_data(volatile struct IDE *interface,UBYTE *buffer,ULONG bufferlen,int need_byteswap)
+static void ide_init_xfer(UWORD ifnum)
 {
-    XFERWIDTH *p = (XFERWIDTH *)buffer;
-    XFERWIDTH *end = (XFERWIDTH *)(buffer + bufferlen);
+    struct IFINFO *info = ifinfo + ifnum;
+    volatile struct IDE *interface = info->base_address;
 
-    KDEBUG(("ide_get_data(0x%08lx, 0x%08lx, %lu, %d)\n", (ULONG)interface, (ULONG)buffer, bufferlen, need_byteswap));
+    if (info->twisted_cable)
+        interface = (volatile struct IDE *)(((ULONG)interface)+1);
+    info->data_port = &interface->data;
+
+    info->get_data[0] = get_data;
+    info->get_data[1] = get_data_swapped;
+    info->put_data[0] = put_data;
+    info->put_data[1] = put_data_swapped;
 
 #if CONF_WITH_APOLLO_68080
-    if (is_apollo_68080)
-    {
-        ide_get_data_32(interface, buffer, bufferlen, need_byteswap);
-        return;
+    if (is_apollo_68080) {
+        info->get_data[0] = get_data_32;
+        info->get_data[1] = get_data_32_swapped;
     }
 #endif
-
-    if (need_byteswap) {
-        while (p < end) {
-            XFERWIDTH temp;
-            temp = interface->data;
-            xferswap(temp);
-            *p++ = temp;
-        }
-    } else {
-        while (p < end)
-            *p++ = interface->data;
-    }
 }
 
 /*
  * read from the IDE device
+ *
+ * if 'buffer' is NULL, the data is read into dskbufp and discarded
  */
 static LONG ide_read(UBYTE cmd,UWORD ifnum,UWORD dev,ULONG sector,UWORD count,UBYTE *buffer,BOOL need_byteswap)
 {
     volatile struct IDE *interface = ifinfo[ifnum].base_address;
     struct IFINFO *info = ifinfo + ifnum;
-    UWORD spi;
+    IDE_XFER read_data = info->get_data[need_byteswap ? 1 : 0];
+    UWORD spi, i;
     UBYTE status1, status2;
+    BOOL lba48 = FALSE;
     LONG rc = 0L;
 
     KDEBUG(("ide_read(0x%02x, %u, %u, %lu, %u, 0x%08lx, %d)\n", cmd, ifnum, dev, sector, count, (ULONG)buffer, need_byteswap));
@@ -763,17 +878,24 @@ static LONG ide_read(UBYTE cmd,UWORD ifnum,UWORD dev,ULONG sector,UWORD count,UB
         return EREADF;
 
     /*
-     * if READ SECTOR and MULTIPLE MODE, set cmd & spi accordingly
+     * if READ SECTOR, set cmd & spi according to LBA48 & MULTIPLE MODE
      */
     spi = 1;
-    if ((cmd == IDE_CMD_READ_SECTOR)
-     && (info->dev[dev].options & MULTIPLE_MODE_ACTIVE)) {
-        cmd = IDE_CMD_READ_MULTIPLE;
-        spi = info->dev[dev].spi;
-        KDEBUG(("spi=%u\n", spi));
+    if (cmd == IDE_CMD_READ_SECTOR) {
+        if (info->dev[dev].options & LBA48_ACTIVE) {
+            cmd = IDE_CMD_READ_SECTOR_EXT;
+            lba48 = TRUE;
+        }
+        if (info->dev[dev].options & MULTIPLE_MODE_ACTIVE) {
+            cmd = lba48 ? IDE_CMD_READ_MULTIPLE_EXT : IDE_CMD_READ_MULTIPLE;
+            spi = info->dev[dev].spi;
+            KDEBUG(("spi=%u\n", spi));
+        }
     }
 
-    ide_rw_start(interface,dev,sector,count,cmd);
+    if (lba48)
+        ide_rw_start48(interface,dev,sector,count,cmd);
+    else ide_rw_start(interface,dev,sector,count,cmd);
 
     /*
      * each iteration of this loop handles one DRQ block
@@ -794,10 +916,11 @@ static LONG ide_read(UBYTE cmd,UWORD ifnum,UWORD dev,ULONG sector,UWORD count,UB
 
         rc = E_OK;
         if (status1 & IDE_STATUS_DRQ) {
-            if (info->twisted_cable) {
-                ide_get_data((volatile struct IDE *)(((ULONG)interface)+1),buffer,xferlen,need_byteswap);
-            } else {
-                ide_get_data(interface,buffer,xferlen,need_byteswap);
+            if (buffer) {
+                (*read_data)(info->data_port,buffer,xferlen);
+            } else {    /* discard data (one sector at a time) */
+                for (i = 0; i < numsecs; i++)
+                    (*read_data)(info->data_port,dskbufp,SECTOR_SIZE);
             }
         } else {
             rc = EREADF;
@@ -808,7 +931,8 @@ static LONG ide_read(UBYTE cmd,UWORD ifnum,UWORD dev,ULONG sector,UWORD count,UB
         if (rc)
             break;
 
-        buffer += xferlen;
+        if (buffer)
+            buffer += xferlen;
         count -= numsecs;
     }
 
@@ -821,27 +945,6 @@ static LONG ide_read(UBYTE cmd,UWORD ifnum,UWORD dev,ULONG sector,UWORD count,UB
     return rc;
 }
 
-/*
- * send data to IDE device
- */
-static void ide_put_data(volatile struct IDE *interface,UBYTE *buffer,ULONG bufferlen,int need_byteswap)
-{
-    XFERWIDTH *p = (XFERWIDTH *)buffer;
-    XFERWIDTH *end = (XFERWIDTH *)(buffer + bufferlen);
-
-    if (need_byteswap) {
-        while (p < end) {
-            XFERWIDTH temp;
-            temp = *p++;
-            xferswap(temp);
-            interface->data = temp;
-        }
-    } else {
-        while (p < end)
-            interface->data = *p++;
-    }
-}
-
 /*
  * write to the IDE device
  */
@@ -849,8 +952,10 @@ static LONG ide_write(UBYTE cmd,UWORD ifnum,UWORD dev,ULONG sector,UWORD count,U
 {
     volatile struct IDE *interface = ifinfo[ifnum].base_address;
     struct IFINFO *info = ifinfo + ifnum;
+    IDE_XFER write_data = info->put_data[need_byteswap ? 1 : 0];
     UWORD spi;
     UBYTE status1, status2;
+    BOOL lba48 = FALSE;
     LONG rc = 0L;
 
     KDEBUG(("ide_write(0x%02x, %u, %u, %lu, %u, 0x%08lx, %d)\n", cmd, ifnum, dev, sector, count, (ULONG)buffer, need_byteswap));
@@ -859,16 +964,23 @@ static LONG ide_write(UBYTE cmd,UWORD ifnum,UWORD dev,ULONG sector,UWORD count,U
         return EWRITF;
 
     /*
-     * if WRITE SECTOR and MULTIPLE MODE, set cmd & spi accordingly
+     * if WRITE SECTOR, set cmd & spi according to LBA48 & MULTIPLE MODE
      */
     spi = 1;
-    if ((cmd == IDE_CMD_WRITE_SECTOR)
-     && (info->dev[dev].options & MULTIPLE_MODE_ACTIVE)) {
-        cmd = IDE_CMD_WRITE_MULTIPLE;
-        spi = info->dev[dev].spi;
+    if (cmd == IDE_CMD_WRITE_SECTOR) {
+        if (info->dev[dev].options & LBA48_ACTIVE) {
+            cmd = IDE_CMD_WRITE_SECTOR_EXT;
+            lba48 = TRUE;
+        }
+        if (info->dev[dev].options & MULTIPLE_MODE_ACTIVE) {
+            cmd = lba48 ? IDE_CMD_WRITE_MULTIPLE_EXT : IDE_CMD_WRITE_MULTIPLE;
+            spi = info->dev[dev].spi;
+        }
     }
 
-    ide_rw_start(interface,dev,sector,count,cmd);
+    if (lba48)
+        ide_rw_start48(interface,dev,sector,count,cmd);
+    else ide_rw_start(interface,dev,sector,count,cmd);
 
     if (wait_for_not_BSY(interface,SHORT_TIMEOUT))
         return EWRITF;
@@ -887,11 +999,7 @@ static LONG ide_write(UBYTE cmd,UWORD ifnum,UWORD dev,ULONG sector,UWORD count,U
         rc = E_OK;
         status1 = IDE_READ_STATUS();    /* status, clear pending interrupt */
         if (status1 & IDE_STATUS_DRQ) {
-            if (info->twisted_cable) {
-                ide_put_data((volatile struct IDE *)(((ULONG)interface)+1),buffer,xferlen,need_byteswap);
-            } else {
-                ide_put_data(interface,buffer,xferlen,need_byteswap);
-            }
+            (*write_data)(info->data_port,buffer,xferlen);
         } else {
             rc = EWRITF;
         }
@@ -921,7 +1029,8 @@ LONG ide_rw(WORD rw,LONG sector,WORD count,UBYTE *buf,WORD dev,BOOL need_byteswa
     UBYTE *p = buf;
     UWORD ifnum;
     WORD maxsecs_per_io = MAXSECS_PER_IO;
-    BOOL use_tmpbuf = FALSE;
+    WORD maxsecs_tmpbuf;
+    BOOL use_tmpbuf = FALSE, shift_down = FALSE;
     LONG ret;
 
     if (!ide_device_exists(dev))
@@ -932,17 +1041,33 @@ LONG ide_rw(WORD rw,LONG sector,WORD count,UBYTE *buf,WORD dev,BOOL need_byteswa
 
     rw &= RW_RW;    /* we just care about read or write for now */
 
+    /*
+     * LBA28-style commands can only address the first 2^28 sectors
+     */
+    if (ifinfo[ifnum].dev[dev].options & LBA48_ACTIVE)
+        maxsecs_per_io = MAXSECS_PER_IO_LBA48;
+    else if ((ULONG)sector + count > LBA28_MAXSECS)
+        return ESECNF;
+
     /*
      * because ide_read()/ide_write() access the buffer with word (or long)
      * moves, we must use an intermediate buffer if the user buffer is not
-     * word-aligned, and the processor is a 68000 or 68010
+     * word-aligned, and the processor is a 68000 or 68010.
+     *
+     * to avoid many small transfers via this buffer when reading, we read
+     * into the following (even) address instead, then move the data down
+     * by one byte.  only the last sector of the request, which would
+     * overwrite the byte following the user buffer, is read via dskbufp.
      */
+    maxsecs_tmpbuf = maxsecs_per_io;
 #ifndef __mcoldfire__
     if (((LONG)buf & 1L) && (mcpu < 20))
     {
-        if (maxsecs_per_io > DSKBUF_SECS)
-            maxsecs_per_io = DSKBUF_SECS;
+        if (maxsecs_tmpbuf > DSKBUF_SECS)
+            maxsecs_tmpbuf = DSKBUF_SECS;
         use_tmpbuf = TRUE;
+        if (!rw)
+            shift_down = TRUE;
     }
 #endif
 
@@ -950,9 +1075,16 @@ LONG ide_rw(WORD rw,LONG sector,WORD count,UBYTE *buf,WORD dev,BOOL need_byteswa
     {
         UWORD numsecs;
 
-        numsecs = (count>maxsecs_per_io) ? maxsecs_per_io : count;
-
-        p = use_tmpbuf ? dskbufp : buf;
+        if (shift_down && (count > 1))
+        {
+            numsecs = (count-1 > maxsecs_per_io) ? maxsecs_per_io : count-1;
+            p = buf + 1;
+        }
+        else
+        {
+            numsecs = (count > maxsecs_tmpbuf) ? maxsecs_tmpbuf : count;
+            p = use_tmpbuf ? dskbufp : buf;
+        }
         if (rw && use_tmpbuf)
             memcpy(p,buf,(LONG)numsecs*SECTOR_SIZE);
 
@@ -966,7 +1098,9 @@ LONG ide_rw(WORD rw,LONG sector,WORD count,UBYTE *buf,WORD dev,BOOL need_byteswa
             return ret;
         }
 
-        if (!rw && use_tmpbuf)
+        if (p == buf + 1)
+            memmove(buf,p,(LONG)numsecs*SECTOR_SIZE);
+        else if (!rw && use_tmpbuf)
             memcpy(buf,p,(LONG)numsecs*SECTOR_SIZE);
 
         buf += (ULONG)numsecs*SECTOR_SIZE;
@@ -1025,6 +1159,25 @@ static void set_multiple_mode(WORD dev,UWORD multi_io)
     ifinfo[ifnum].dev[dev].spi = spi;
 }
 
+/*
+ * use LBA48-style commands if the device supports them.  this must be
+ * called with the IDENTIFY DEVICE data for the device in 'identify'.
+ */
+static void set_lba48_mode(WORD dev)
+{
+    UWORD ifnum;
+
+    if (!(identify.cmds_supported[1] & IDE_CMDSET_LBA48))
+        return;
+
+    ifnum = dev / 2;    /* i.e. primary IDE, secondary IDE, ... */
+    dev &= 1;           /* 0 or 1 */
+
+    KDEBUG(("Using LBA48 for ifnum %d dev %d\n",ifnum,dev));
+
+    ifinfo[ifnum].dev[dev].options |= LBA48_ACTIVE;
+}
+
 static LONG ide_identify(WORD dev)
 {
     LONG ret;
@@ -1060,8 +1213,13 @@ LONG ide_ioctl(WORD dev,UWORD ctrl,void *arg)
     case GET_DISKINFO:
         ret = ide_identify(dev);    /* reads into identify structure */
         if (ret >= 0) {
-            info[0] = MAKE_ULONG(identify.numsecs_lba28[1],
-                        identify.numsecs_lba28[0]);
+            if (!(identify.cmds_supported[1] & IDE_CMDSET_LBA48))
+                info[0] = MAKE_ULONG(identify.numsecs_lba28[1],
+                            identify.numsecs_lba28[0]);
+            else if (identify.maxsec_lba48[3] || identify.maxsec_lba48[2])
+                info[0] = 0xffffffffUL; /* we only handle 32-bit sector numbers */
+            else info[0] = MAKE_ULONG(identify.maxsec_lba48[1],
+                            identify.maxsec_lba48[0]);
             info[1] = SECTOR_SIZE;  /* note: could be different under ATAPI 7 */
             ret = E_OK;
         }
@@ -1082,9 +1240,60 @@ LONG ide_ioctl(WORD dev,UWORD ctrl,void *arg)
     case GET_MEDIACHANGE:
         ret = MEDIANOCHANGE;
         break;
+    case GET_THROUGHPUT:
+        ret = ide_throughput(dev,info);
+        break;
     }
 
     return ret;
 }
 
+/*
+ * measure the read throughput of a device
+ *
+ * we read consecutive groups of BENCH_SECTORS sectors from the start of
+ * the device (without byteswapping, and discarding the data) for at least
+ * BENCH_TICKS, and return the rate in KB/sec via 'rate'.  the sectors
+ * are stepped through a range of up to BENCH_RANGE sectors, so that we
+ * measure the data path rather than the drive's cache.
+ */
+static LONG ide_throughput(WORD dev,ULONG *rate)
+{
+    ULONG start, ticks, sectors, range, sector;
+    ULONG diskinfo[2];
+    UWORD ifnum;
+    LONG ret;
+
+    ret = ide_ioctl(dev,GET_DISKINFO,diskinfo);
+    if (ret < 0)
+        return ret;
+
+    range = (diskinfo[0] < BENCH_RANGE) ? diskinfo[0] : BENCH_RANGE;
+    if (range < BENCH_SECTORS)
+        return EUNDEV;
+    range -= range % BENCH_SECTORS;
+
+    ifnum = dev / 2;    /* i.e. primary IDE, secondary IDE, ... */
+    dev &= 1;           /* 0 or 1 */
+
+    start = hz_200;
+    sectors = 0UL;
+    sector = 0UL;
+    do {
+        ret = ide_read(IDE_CMD_READ_SECTOR,ifnum,dev,sector,BENCH_SECTORS,NULL,FALSE);
+        if (ret < 0)
+            return ret;
+        sectors += BENCH_SECTORS;
+        sector += BENCH_SECTORS;
+        if (sector >= range)
+            sector = 0UL;
+        ticks = hz_200 - start;
+    } while(ticks < BENCH_TICKS);
+
+    *rate = (sectors * CLOCKS_PER_SEC) / (ticks * (1024/SECTOR_SIZE));
+    KDEBUG(("ide_throughput(): %lu sectors in %lu ticks, %lu KB/sec\n",sectors,ticks,*rate));
+
+    return E_OK;
+}
+
 #endif /* CONF_WITH_IDE */
@@ -53,6 +53,16 @@ extern UWORD v_hz_rez;          /* screen horizontal resolution */
 extern UWORD v_vt_rez;          /* screen vertical resolution */
 extern UWORD v_bytes_lin;       /* width of line in bytes */
 
+/*
+ * TRUECOLOR_MODE is true when the screen holds packed 16-bit RGB565
+ * pixels rather than interleaved bitplanes (Falcon Truecolor modes)
+ */
+#if CONF_WITH_VDI_16BIT
+#define TRUECOLOR_MODE  (v_planes == 16)
+#else
+#define TRUECOLOR_MODE  0
+#endif
+
 extern void linea_init(void);   /* initialize variables */
 
 #endif /* LINEAVARS_H */
@@ -20,6 +20,7 @@
 #include "tosvars.h"
 #include "vectors.h"
 #include "coldfire.h"
+#include "asm.h"
 
 #if CONF_WITH_MFP || CONF_WITH_TT_MFP
 
@@ -78,6 +79,11 @@ void mfp_init(void)
 
     reset_mfp_regs(mfp);    /* reset the MFP registers */
     mfp->vr = 0x48;         /* vectors 0x40 to 0x4F, software end of interrupt */
+
+#if CONF_WITH_DMA_INTERRUPT
+    /* FDC/HDC completion wakes up timeout_gpip() */
+    mfpint(7, (LONG)int_dma);
+#endif
 }
 
 
@@ -177,6 +183,15 @@ int timeout_gpip(LONG delay)
         if((mfp->gpip & 0x20) == 0) {
             return 0;
         }
+#if CONF_WITH_DMA_INTERRUPT
+        /*
+         * sleep until the FDC/HDC interrupt (or the next timer tick, for
+         * the timeout).  if a program has replaced our interrupt handler,
+         * or interrupts are masked, we just keep polling.
+         */
+        if ((VEC_DMA == int_dma) && ((get_sr() & 0x0700) <= 0x0300))
+            dma_sleep();
+#endif
     }
     return 1;
 }
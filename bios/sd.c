@@ -102,6 +102,8 @@
  *  miscellaneous
  */
 #define SDV2_CSIZE_MULTIPLIER   1024    /* converts C_SIZE to sectors */
+#define SD_BENCH_SECTORS        64      /* sectors per request when measuring throughput */
+#define SD_BENCH_TICKS          CLOCKS_PER_SEC  /* minimum duration of measurement */
 #define DELAY_1_MSEC            delay_loop(loopcount_1_msec)
 
 /*
@@ -141,6 +143,7 @@ static int sd_special_read(UBYTE cmd,UBYTE *data);
 static int sd_wait_for_not_busy(LONG timeout);
 static int sd_wait_for_not_idle(UBYTE cmd,ULONG arg);
 static int sd_wait_for_ready(LONG timeout);
+static LONG sd_throughput(ULONG *rate);
 static LONG sd_write(UWORD drv,ULONG sector,UWORD count,UBYTE *buf);
 
 
@@ -262,6 +265,9 @@ UBYTE cardreg[16];
             rc = MEDIACHANGE;
         }
         break;
+    case GET_THROUGHPUT:
+        rc = sd_throughput(info);
+        break;
     default:
         rc = ERR;
     }
@@ -356,13 +362,48 @@ int i, rc;
     return 0L;
 }
 
+/*
+ *  measure the read throughput of the card
+ *
+ *  we repeatedly read SD_BENCH_SECTORS sectors from the start of the
+ *  card (discarding the data) for at least SD_BENCH_TICKS, and return
+ *  the rate in KB/sec via 'rate'
+ */
+static LONG sd_throughput(ULONG *rate)
+{
+ULONG start, ticks, sectors;
+
+    if (card.type == CARDTYPE_UNKNOWN)
+        if (sd_check(0))
+            return EDRVNR;
+
+    start = hz_200;
+    sectors = 0UL;
+    do {
+        if (sd_read(0,0UL,SD_BENCH_SECTORS,NULL)) {
+            card.type = CARDTYPE_UNKNOWN;   /* force reinitialisation */
+            return EREADF;
+        }
+        sectors += SD_BENCH_SECTORS;
+        ticks = hz_200 - start;
+    } while(ticks < SD_BENCH_TICKS);
+
+    *rate = (sectors * CLOCKS_PER_SEC) / (ticks * (1024/SECTOR_SIZE));
+    KDEBUG(("sd_throughput(): %lu sectors in %lu ticks, %lu KB/sec\n",sectors,ticks,*rate));
+
+    return 0L;
+}
+
 /*
  *  read one or more blocks
+ *
+ *  if 'buf' is NULL, the data is discarded
  */
 static LONG sd_read(UWORD drv,ULONG sector,UWORD count,UBYTE *buf)
 {
 LONG i, rc, rc2;
 LONG posn, incr;
+UWORD bufincr = buf ? SECTOR_SIZE : 0;
 
     spi_cs_assert();
 
@@ -385,7 +426,7 @@ LONG posn, incr;
     if ((count > 1) && (card.features&MULTIBLOCK_IO)) {
         rc = sd_command(CMD18,posn,0,R1,response);
         if (rc == 0L) {
-            for (i = 0; i < count; i++, buf += SECTOR_SIZE) {
+            for (i = 0; i < count; i++, buf += bufincr) {
                 rc = sd_receive_data(buf,SECTOR_SIZE,0);
                 if (rc)
                     break;
@@ -395,7 +436,7 @@ LONG posn, incr;
                 rc = rc2;
         }
     } else {            /* use single sector */
-        for (i = 0; i < count; i++, posn += incr, buf += SECTOR_SIZE) {
+        for (i = 0; i < count; i++, posn += incr, buf += bufincr) {
             rc = sd_command(CMD17,posn,0,R1,response);
             if (rc == 0L)
                 rc = sd_receive_data(buf,SECTOR_SIZE,0);
@@ -593,13 +634,7 @@ UBYTE token;
     /*
      *  transfer data
      */
-    if (buf) {
-        for (i = 0; i < len; i++)
-            *buf++ = spi_recv_byte();
-    } else {
-        for (i = 0; i < len; i++)
-            spi_recv_byte();
-    }
+    spi_recv_block(buf,len);
 
     spi_recv_byte();        /* discard crc */
     spi_recv_byte();
@@ -615,7 +650,6 @@ UBYTE token;
  */
 static int sd_send_data(UBYTE *buf,UWORD len,UBYTE token)
 {
-LONG i;
 UBYTE rtoken;
 
     spi_send_byte(token);
@@ -623,8 +657,7 @@ UBYTE rtoken;
         spi_recv_byte();    /* skip a byte before testing for busy */
     } else {
         /* send the data */
-        for (i = 0; i < len; i++)
-            spi_send_byte(*buf++);
+        spi_send_block(buf,len);
         spi_send_byte(0xff);        /* send dummy crc */
         spi_send_byte(0xff);
 
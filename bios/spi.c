@@ -186,3 +186,70 @@ ULONG temp;
 
     return LOBYTE(temp);
 }
+
+/*
+ *  the following are used for the data blocks of read/write commands,
+ *  where nearly all of the time is spent.  they access the DSPI
+ *  registers directly, with the loop unrolled by a factor of 4.
+ */
+#define SPI_XFER(out,temp)  MCF_DSPI_DTFR = (out);                      \
+                            while(!(MCF_DSPI_DSR & MCF_DSPI_DSR_TCF))   \
+                                ;                                       \
+                            temp = MCF_DSPI_DRFR;                       \
+                            MCF_DSPI_DSR = 0xffffffffL
+
+/*
+ *  receive a block of 'len' bytes; if 'buf' is NULL, the data is discarded
+ */
+void spi_recv_block(UBYTE *buf, UWORD len)
+{
+ULONG out = fifo_out | 0xff;
+ULONG temp;
+UWORD n;
+
+    if (!buf) {
+        while(len--) {
+            SPI_XFER(out,temp);
+        }
+        return;
+    }
+
+    for (n = len >> 2; n; n--) {
+        SPI_XFER(out,temp);
+        *buf++ = LOBYTE(temp);
+        SPI_XFER(out,temp);
+        *buf++ = LOBYTE(temp);
+        SPI_XFER(out,temp);
+        *buf++ = LOBYTE(temp);
+        SPI_XFER(out,temp);
+        *buf++ = LOBYTE(temp);
+    }
+
+    for (n = len & 3; n; n--) {
+        SPI_XFER(out,temp);
+        *buf++ = LOBYTE(temp);
+    }
+}
+
+/*
+ *  send a block of 'len' bytes
+ */
+void spi_send_block(const UBYTE *buf, UWORD len)
+{
+ULONG out = fifo_out;
+ULONG temp;
+UWORD n;
+
+    UNUSED(temp);
+
+    for (n = len >> 2; n; n--) {
+        SPI_XFER(out|*buf++,temp);
+        SPI_XFER(out|*buf++,temp);
+        SPI_XFER(out|*buf++,temp);
+        SPI_XFER(out|*buf++,temp);
+    }
+
+    for (n = len & 3; n; n--) {
+        SPI_XFER(out|*buf++,temp);
+    }
+}
@@ -32,6 +32,10 @@ extern void int_hbl(void);
 extern void int_vbl(void);
 extern void int_linea(void);
 extern void int_timerc(void);
+#if CONF_WITH_DMA_INTERRUPT
+extern void int_dma(void);
+extern void dma_sleep(void);
+#endif
 
 extern void gemtrap(void);
 extern void biostrap(void);
@@ -73,11 +77,13 @@ extern WORD trap_save_area[];
 
 /* MFP interrupt vectors */
 #define VEC_MFP6   (*(volatile PFVOID*)0x118) /* MFP level 6 interrupt vector */
+#define VEC_MFP7   (*(volatile PFVOID*)0x11c) /* MFP level 7 interrupt vector */
 
 /* Atari hardware interrupt mapping */
 #define VEC_HBL     VEC_LEVEL2                /* HBL interrupt vector */
 #define VEC_VBL     VEC_LEVEL4                /* VBL interrupt vector */
 #define VEC_ACIA    VEC_MFP6                  /* Keyboard/MIDI interrupt vector */
+#define VEC_DMA     VEC_MFP7                  /* FDC/HDC interrupt vector */
 
 /* OS exception mapping */
 #define VEC_AES     VEC_TRAP2                 /* AES trap exception vector */
@@ -54,7 +54,11 @@
 #define FRGB_WHITE     0xffff00ff
 
 /* test for VDI support of videomode */
+#if CONF_WITH_VDI_16BIT
+#define VALID_VDI_BPP(mode) ((mode&VIDEL_BPPMASK)<=VIDEL_TRUECOLOR)
+#else
 #define VALID_VDI_BPP(mode) ((mode&VIDEL_BPPMASK)<=VIDEL_8BPP)
+#endif
 
 /* selected Falcon videomodes */
 #define FALCON_ST_HIGH      (VIDEL_COMPAT|VIDEL_VGA|VIDEL_80COL|VIDEL_1BPP)
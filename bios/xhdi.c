@@ -108,9 +108,13 @@ static long XHInqDev2(UWORD drv, UWORD *major, UWORD *minor, ULONG *start,
     if (start)
         *start = pstart;
 
+    /*
+     * only the TOS part of the BPB is returned.  a FAT32 BPB can't be
+     * described that way, so it is reported as invalid, as before.
+     */
     myBPB = (BPB *)blkdev_getbpb(drv);
-    if (bpb && myBPB)
-        memcpy(bpb, myBPB, sizeof(BPB));
+    if (bpb && myBPB && !(myBPB->b_flags & B_32))
+        memcpy(bpb, myBPB, TOS_BPB_SIZE);
 
     if (blocks)
         *blocks = blkdev[drv].size;
@@ -210,12 +214,33 @@ static long XHInqDriver(UWORD bios_device, char *name, char *version, char *comp
 
 static long XHDriverSpecial(ULONG key1, ULONG key2, UWORD subopcode, void *data)
 {
+    ULONG *args = data;
+
     if (next_handler) {
         long ret = next_handler(XHDRIVERSPECIAL, key1, key2, subopcode, data);
         if (ret != EINVFN && ret != EUNDEV && ret != EDRIVE)
             return ret;
     }
 
+    if ((key1 != XH_ETOS_KEY1) || (key2 != XH_ETOS_KEY2))
+        return EINVFN;
+
+    if (!data)                  /* all our subopcodes need arguments */
+        return EINVFN;
+
+    switch(subopcode) {
+    case XH_ETOS_THROUGHPUT:
+        if (args[0] >= UNITSNUM - NUMFLOPPIES)
+            return EUNDEV;
+        return disk_throughput(NUMFLOPPIES + args[0], &args[1]);
+#if CONF_WITH_BLKDEV_STATS
+    case XH_ETOS_IOSTATS:
+        if (args[0] >= UNITSNUM)
+            return EUNDEV;
+        return blkdev_stats(args[0], (BLKSTAT *)&args[2], args[1] ? TRUE : FALSE);
+#endif
+    }
+
     return EINVFN;
 }
 
@@ -31,6 +31,18 @@
 #define XHLASTACCESS    18
 #define XHREACCESS      19
 
+/* keys & subopcodes for EmuTOS-specific XHDriverSpecial() functions */
+#define XH_ETOS_KEY1        0x45544f53L /* 'ETOS' */
+#define XH_ETOS_KEY2        0x58484449L /* 'XHDI' */
+#define XH_ETOS_THROUGHPUT  0           /* measure read throughput: data -> ULONG[2]: */
+                                        /*   [0] major device number (input)        */
+                                        /*   [1] read rate in KB/sec (output)       */
+#define XH_ETOS_IOSTATS     1           /* get I/O statistics: data -> ULONG[]:     */
+                                        /*   [0] physical unit number (input):      */
+                                        /*       0-1 = floppies, 2+ = major+2       */
+                                        /*   [1] non-zero to reset stats (input)    */
+                                        /*   [2]... BLKSTAT structure (output)      */
+
 /* values in device_flags for XHInqTarget(), XHInqTarget2() */
 #define XH_TARGET_REMOVABLE 0x02L
 
@@ -118,6 +118,17 @@ extern LONG jmp_xbios(WORD, ...);
 #define DEFAULT_DT_SEPARATOR    '/'
 #define DEFAULT_DT_FORMAT   ((_IDT_12H<<12) + (_IDT_YMD<<8) + DEFAULT_DT_SEPARATOR)
 
+/*
+ * EmuTOS-specific XHDI function used by the IOSTAT command
+ */
+#define XHDI_COOKIE     0x58484449      /* 'XHDI' */
+#define XHDRIVERSPECIAL 13
+#define XH_ETOS_KEY1    0x45544f53L     /* 'ETOS' */
+#define XH_ETOS_KEY2    0x58484449L     /* 'XHDI' */
+#define XH_ETOS_IOSTATS 1
+#define MAX_PHYS_UNITS  34              /* 2 floppies + 32 XHDI major devices */
+#define IOSTAT_SIZES    8               /* entries in request size histogram */
+
 /*
  *  typedefs
  */
@@ -130,6 +141,19 @@ typedef struct {
     char    d_fname[14];
 } DTA;
 
+typedef struct {                /* data for XH_ETOS_IOSTATS */
+    ULONG   unit;               /* physical unit number (input) */
+    ULONG   reset;              /* non-zero to reset statistics (input) */
+    ULONG   requests;
+    ULONG   sectors;
+    ULONG   retries;
+    ULONG   errors;
+    ULONG   mediachanges;
+    ULONG   ticks;              /* in 200Hz ticks */
+    ULONG   max_ticks;
+    ULONG   sizes[IOSTAT_SIZES];/* sizes[n]: requests of 2^n to 2^(n+1)-1 sectors */
+} IOSTAT;
+
 /* Type of function run by execute() */
 typedef LONG FUNC(WORD argc,char **argv);
 
@@ -143,6 +167,7 @@ typedef LONG FUNC(WORD argc,char **argv);
 /*
  *  manifest constants
  */
+#define EINVFN          -32
 #define EFILNF          -33
 #define EPTHNF          -34
 #define ENHNDL          -35
@@ -157,6 +182,7 @@ typedef LONG FUNC(WORD argc,char **argv);
 #define CMDLINE_LENGTH  -103
 #define DIR_NOT_EMPTY   -104        /* translated from EACCDN for folders */
 #define CANT_DELETE     -105        /* translated from EACCDN for files */
+#define NO_IOSTATS      -106        /* no I/O statistics available */
 #define INVALID_PARAM   -126        /* for builtin commands */
 #define WRONG_NUM_ARGS  -127        /* for builtin commands */
 
@@ -27,8 +27,10 @@ typedef struct {
 PRIVATE LONG check_path_component(char *component);
 PRIVATE LONG copy_move(WORD argc,char **argv,WORD delete);
 PRIVATE void display_dta_detail(void);
+PRIVATE void display_iostat(WORD unit);
 PRIVATE char *extract_path(char *dest,const char *src);
 PRIVATE void fixup_filespec(char *filespec);
+PRIVATE LONG get_iostat(void);
 PRIVATE char getyn(void);
 PRIVATE void help_display(const COMMAND *p);
 PRIVATE WORD help_lines(const COMMAND *p);
@@ -52,6 +54,7 @@ PRIVATE LONG run_cls(WORD argc,char **argv);
 PRIVATE LONG run_cp(WORD argc,char **argv);
 PRIVATE LONG run_echo(WORD argc,char **argv);
 PRIVATE LONG run_help(WORD argc,char **argv);
+PRIVATE LONG run_iostat(WORD argc,char **argv);
 PRIVATE LONG run_ls(WORD argc,char **argv);
 PRIVATE LONG run_mkdir(WORD argc,char **argv);
 PRIVATE LONG run_more(WORD argc,char **argv);
@@ -94,6 +97,10 @@ LOCAL const char * const help_help[] = { "[<cmd>]",
     N_("Get help about <cmd> or list available commands"),
     N_("Use HELP ALL for help on all commands"),
     N_("Use HELP EDIT for help on line editing"), NULL };
+LOCAL const char * const help_iostat[] = { "[-r] [<unit>]",
+    N_("Show disk I/O statistics for <unit> or all units"),
+    N_("(0-1=floppies, 2+=XHDI major device+2)"),
+    N_("Specify -r to reset the statistics"), NULL };
 LOCAL const char * const help_ls[] = { "[-l] <path>",
     N_("List files (default terse, horizontal)"),
     N_("Specify -l for detailed list"), NULL };
@@ -147,6 +154,7 @@ LOCAL const COMMAND cmdtable[] = {
     { "echo", NULL, 0, 255, run_echo, help_echo },
     { "exit", NULL, 0, 0, LOOKUP_EXIT, help_exit },
     { "help", NULL, 0, 1, run_help, help_help },
+    { "iostat", NULL, 0, 2, run_iostat, help_iostat },
     { "ls", "dir", 0, 2, run_ls, help_ls },
     { "mkdir", "md", 1, 1, run_mkdir, help_mkdir },
     { "mode", NULL, 1, 4, run_mode, help_mode },
@@ -165,6 +173,9 @@ LOCAL const COMMAND cmdtable[] = {
 
 static LONG linecount;  /* used by 'more' command */
 
+static LONG (*xhdi_handler)(UWORD opcode,...);  /* used by 'iostat' command */
+static IOSTAT iostat;
+
 LONG (*lookup_builtin(WORD argc,char **argv))(WORD,char **)
 {
 const COMMAND *p;
@@ -316,6 +327,51 @@ const char * const *s;
     return 0L;
 }
 
+PRIVATE LONG run_iostat(WORD argc,char **argv)
+{
+LONG rc, cookie;
+WORD unit, first, last, found = 0;
+
+    iostat.reset = 0;
+    if (argc > 1) {
+        if (strequal(argv[1],"-r")) {
+            iostat.reset = 1;
+            argc--;
+            argv++;
+        }
+    }
+
+    if (argc > 1) {
+        first = last = getword(argv[1]);
+        if ((first < 0) || (first >= MAX_PHYS_UNITS))
+            return INVALID_PARAM;
+    } else {
+        first = 0;
+        last = MAX_PHYS_UNITS - 1;
+    }
+
+    if (!getcookie(XHDI_COOKIE,&cookie))
+        return NO_IOSTATS;
+    xhdi_handler = (LONG (*)(UWORD,...))cookie;
+
+    for (unit = first; unit <= last; unit++) {
+        iostat.unit = unit;
+        rc = Supexec(get_iostat);
+        if (rc == EINVFN)       /* not EmuTOS, or statistics not configured */
+            return NO_IOSTATS;
+        if (rc < 0)             /* no such unit */
+            continue;
+        found++;
+        if ((first == last) || iostat.requests)
+            display_iostat(unit);
+    }
+
+    if (!found)
+        return (first == last) ? INVALID_PARAM : NO_IOSTATS;
+
+    return 0L;
+}
+
 PRIVATE LONG run_ls(WORD argc,char **argv)
 {
 char filespec[MAXPATHLEN];
@@ -1040,6 +1096,44 @@ char c;
     return c;
 }
 
+/*
+ *  get the I/O statistics for iostat.unit (must be called in supervisor mode)
+ */
+PRIVATE LONG get_iostat(void)
+{
+    return xhdi_handler(XHDRIVERSPECIAL,XH_ETOS_KEY1,XH_ETOS_KEY2,XH_ETOS_IOSTATS,&iostat);
+}
+
+PRIVATE void display_iostat(WORD unit)
+{
+char buf[20], *p;
+WORD i;
+
+    output(_("I/O statistics for unit "));
+    convulong(buf,unit,2,' ');
+    for (p = buf; *p == ' '; p++)
+        ;
+    outputnl(p);
+    show_line(_("  Requests:       "),iostat.requests);
+    show_line(_("  Sectors:        "),iostat.sectors);
+    show_line(_("  Retries:        "),iostat.retries);
+    show_line(_("  Errors:         "),iostat.errors);
+    show_line(_("  Media changes:  "),iostat.mediachanges);
+    show_line(_("  Total time (ms):"),iostat.ticks*5);
+    show_line(_("  Max time (ms):  "),iostat.max_ticks*5);
+    for (i = 0; i < IOSTAT_SIZES; i++) {
+        output(_("  Sectors "));
+        convulong(buf,1L<<i,4,' ');
+        output(buf);
+        if (i < IOSTAT_SIZES-1) {
+            output("-");
+            convulong(buf,(2L<<i)-1,4,' ');
+            output(buf);
+        } else output("+    ");
+        show_line(":",iostat.sizes[i]);
+    }
+}
+
 PRIVATE void show_line(const char *title,ULONG n)
 {
 char buf[20];
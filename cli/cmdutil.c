@@ -95,6 +95,9 @@ const char *p;
     case CANT_DELETE:
         p = _("can't delete file (read-only?)");
         break;
+    case NO_IOSTATS:
+        p = _("I/O statistics not available");
+        break;
     case INVALID_PARAM:
         p = _("invalid parameter");
         break;
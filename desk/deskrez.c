@@ -174,14 +174,17 @@ WORD oldmode, oldbase, oldoptions;
             rsrc_gaddr_rom(R_STRING,STREZ1+i,(void **)&obj->ob_spec);
     }
 
-    /* FIXME: change the next 2 lines when we have TrueColor support in VDI */
+#if !CONF_WITH_VDI_16BIT
+    /* the VDI can't draw in Truecolor modes, so don't offer them */
     obj = tree + FREZTEXT;          /* this hides the "TC" header text */
     obj->ob_flags |= HIDETREE;
+#endif
 
     for (i = 0, obj = tree+FREZLIST; i < NUM_FALCON_BUTTONS; i++, obj++) {
-        /* FIXME: change the next 2 lines when we have TrueColor support in VDI */
+#if !CONF_WITH_VDI_16BIT
         if ((falconmode_from_button[i]&VIDEL_BPPMASK) > VIDEL_8BPP)
             obj->ob_flags |= HIDETREE;
+#endif
         if (i == selected)
             obj->ob_state |= SELECTED;
         else obj->ob_state &= ~SELECTED;
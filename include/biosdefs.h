@@ -30,14 +30,28 @@ struct _bpb /* bios parameter block */
     UWORD datrec;       /* first data record */
     UWORD numcl;        /* number of data clusters available */
     UWORD b_flags;      /* flags (see below) */
+    /*
+     * EmuTOS extension: the TOS BPB ends here.  the following fields
+     * are only valid if B_32 is set in b_flags, in which case the
+     * 16-bit fsiz, fatrec, datrec and numcl fields above are zero.
+     */
+    ULONG fsiz32;       /* FAT size in records */
+    ULONG fatrec32;     /* first FAT record (of last FAT) */
+    ULONG datrec32;     /* first data record */
+    ULONG numcl32;      /* number of data clusters available */
+    ULONG rootcl;       /* first cluster of root directory */
+    UWORD fsinfo;       /* record number of FSInfo sector (0 if none) */
 };
 typedef struct _bpb BPB;
 
+#define TOS_BPB_SIZE    18  /* length of the part of the BPB defined by TOS */
+
 /*
  *  flags for BPB
  */
 #define B_16    1       /* device has 16-bit FATs */
 #define B_FIX   2       /* device has fixed media */
+#define B_32    4       /* device has 32-bit FATs (EmuTOS extension) */
 
 /*
  * Flags for Kbshift()
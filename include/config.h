@@ -236,6 +236,15 @@
 # ifndef CONF_WITH_VDI_EXTENSIONS
 #  define CONF_WITH_VDI_EXTENSIONS 0
 # endif
+# ifndef CONF_WITH_VDI_16BIT
+#  define CONF_WITH_VDI_16BIT 0
+# endif
+# ifndef CONF_WITH_VDI_BEZIER
+#  define CONF_WITH_VDI_BEZIER 0
+# endif
+# ifndef CONF_WITH_SPAN_KERNELS
+#  define CONF_WITH_SPAN_KERNELS 0
+# endif
 # ifndef CONF_WITH_SHOW_FILE
 #  define CONF_WITH_SHOW_FILE 0
 # endif
@@ -251,6 +260,24 @@
 # ifndef CONF_WITH_SHUTDOWN
 #  define CONF_WITH_SHUTDOWN 0
 # endif
+# ifndef CONF_WITH_FAT32
+#  define CONF_WITH_FAT32 0
+# endif
+# ifndef CONF_WITH_VFAT
+#  define CONF_WITH_VFAT 0
+# endif
+# ifndef CONF_WITH_DIRINDEX
+#  define CONF_WITH_DIRINDEX 0
+# endif
+# ifndef CONF_WITH_DNDCACHE
+#  define CONF_WITH_DNDCACHE 0
+# endif
+# ifndef CONF_BDOS_READAHEAD
+#  define CONF_BDOS_READAHEAD 0
+# endif
+# ifndef CONF_WITH_FLOPPY_TRACK_CACHE
+#  define CONF_WITH_FLOPPY_TRACK_CACHE 0
+# endif
 #endif
 
 /*
@@ -279,6 +306,9 @@
 # ifndef CONF_WITH_VDI_EXTENSIONS
 #  define CONF_WITH_VDI_EXTENSIONS 0
 # endif
+# ifndef CONF_WITH_VDI_BEZIER
+#  define CONF_WITH_VDI_BEZIER 0
+# endif
 # ifndef CONF_WITH_ICDRTC
 #  define CONF_WITH_ICDRTC 0
 # endif
@@ -770,6 +800,16 @@
 # define CONF_WITH_FDC 1
 #endif
 
+/*
+ * Set CONF_WITH_FLOPPY_TRACK_CACHE to 1 to keep a copy of the most recently
+ * read track/side of each floppy drive in ST-RAM, so that partial-track
+ * reads of the same track/side don't have to wait for the diskette again.
+ * This costs 9 KB of ST-RAM per drive.
+ */
+#ifndef CONF_WITH_FLOPPY_TRACK_CACHE
+# define CONF_WITH_FLOPPY_TRACK_CACHE CONF_WITH_FDC
+#endif
+
 /*
  * Set this to 1 to activate ACSI support
  */
@@ -889,6 +929,16 @@
 # define CONF_WITH_XHDI 1
 #endif
 
+/*
+ * Set CONF_WITH_BLKDEV_STATS to 1 to keep per-unit I/O statistics in
+ * Rwabs() (request counts, latencies and request sizes).  They can be
+ * read via an EmuTOS-specific XHDriverSpecial() function, and are
+ * displayed by the EmuCON2 'iostat' command.
+ */
+#ifndef CONF_WITH_BLKDEV_STATS
+# define CONF_WITH_BLKDEV_STATS CONF_WITH_XHDI
+#endif
+
 /*
  * Set CONF_WITH_BLITTER to 1 to enable minimal Blitmode() support
  */
@@ -919,6 +969,66 @@
 # define CONF_LOGSEC_SIZE 512
 #endif
 
+/*
+ * CONF_BDOS_BUFFERS defines the number of GEMDOS sector buffers in each
+ * of the two buffer lists (FAT and directory/data).  If it is zero, the
+ * number of buffers is chosen at boot time according to the amount of
+ * free memory, using 1/64th of the largest free block, but never less
+ * than 2 nor more than CONF_BDOS_MAX_BUFFERS per list.
+ */
+#ifndef CONF_BDOS_BUFFERS
+# define CONF_BDOS_BUFFERS 0
+#endif
+
+#ifndef CONF_BDOS_MAX_BUFFERS
+# define CONF_BDOS_MAX_BUFFERS 128
+#endif
+
+/*
+ * CONF_BDOS_READAHEAD is the maximum number of records that GEMDOS reads
+ * ahead when a file is being read sequentially in small pieces.  It never
+ * reads beyond the end of the current cluster, nor uses more than half
+ * of the directory/data buffers.  Set it to 0 to disable readahead.
+ */
+#ifndef CONF_BDOS_READAHEAD
+# define CONF_BDOS_READAHEAD 16
+#endif
+
+/*
+ * Set CONF_WITH_FAT32 to 1 to allow GEMDOS to use FAT32 partitions.
+ * This makes cluster numbers 32 bits wide throughout GEMDOS.
+ */
+#ifndef CONF_WITH_FAT32
+# define CONF_WITH_FAT32 1
+#endif
+
+/*
+ * Set CONF_WITH_VFAT to 1 to support VFAT long filenames in GEMDOS,
+ * together with the MiNT-compatible Dpathconf(), Dopendir(), Dreaddir(),
+ * Drewinddir() and Dclosedir() functions.
+ */
+#ifndef CONF_WITH_VFAT
+# define CONF_WITH_VFAT 1
+#endif
+
+/*
+ * Set CONF_WITH_DIRINDEX to 1 to let GEMDOS build hash indexes of the
+ * names in large directories, so that files in them can be found
+ * without reading the whole directory.
+ */
+#ifndef CONF_WITH_DIRINDEX
+# define CONF_WITH_DIRINDEX 1
+#endif
+
+/*
+ * Set CONF_WITH_DNDCACHE to 1 to keep the GEMDOS directory nodes (DNDs)
+ * in a bounded cache with hashed lookup, reclaiming the least recently
+ * used ones, instead of letting them fill up the OS memory pool.
+ */
+#ifndef CONF_WITH_DNDCACHE
+# define CONF_WITH_DNDCACHE 1
+#endif
+
 /*
  * Set CONF_WITH_ASSERT to 1 to enable the assert() function
  */
@@ -935,6 +1045,16 @@
 # define USE_STOP_INSN_TO_FREE_HOST_CPU 1
 #endif
 
+/*
+ * Set CONF_WITH_DMA_INTERRUPT to 1 to let the CPU sleep while floppy and
+ * ACSI DMA transfers are in progress.  The FDC/HDC interrupt (MFP GPIP 5)
+ * then wakes it up as soon as the transfer completes, instead of the MFP
+ * being polled continuously.  This requires a working STOP instruction.
+ */
+#ifndef CONF_WITH_DMA_INTERRUPT
+# define CONF_WITH_DMA_INTERRUPT ((CONF_WITH_FDC || CONF_WITH_ACSI) && USE_STOP_INSN_TO_FREE_HOST_CPU)
+#endif
+
 /*
  * With this switch you can control if some functions should be used as
  * static-inlines. This is generally a good idea if your compiler supports
@@ -1056,6 +1176,33 @@
 # define CONF_WITH_VDI_EXTENSIONS 1
 #endif
 
+/*
+ * Set CONF_WITH_VDI_16BIT to 1 to let the VDI drive the Falcon Truecolor
+ * (16 bits per pixel, packed RGB565) video modes.  The planar drawing
+ * primitives hand over to the packed-pixel versions in vdi_tc.c when
+ * the screen has 16 planes.
+ */
+#ifndef CONF_WITH_VDI_16BIT
+# define CONF_WITH_VDI_16BIT CONF_WITH_VIDEL
+#endif
+
+/*
+ * Set CONF_WITH_VDI_BEZIER to 1 to support the PC-GEM/3 Bezier curve
+ * functions v_bez(), v_bez_fill(), v_bez_on/off() and v_bez_qual()
+ */
+#ifndef CONF_WITH_VDI_BEZIER
+# define CONF_WITH_VDI_BEZIER 1
+#endif
+
+/*
+ * Set CONF_WITH_SPAN_KERNELS to 1 to build a horizontal line fill routine
+ * specialised for each number of planes and write mode.  This is faster,
+ * but takes a few KB more than a single generic routine.
+ */
+#ifndef CONF_WITH_SPAN_KERNELS
+# define CONF_WITH_SPAN_KERNELS 1
+#endif
+
 /*
  * Set CONF_WITH_FORMAT to 1 to support formatting floppy diskettes in EmuDesk
  */
@@ -1393,6 +1540,24 @@
 # endif
 #endif
 
+#if !CONF_WITH_MFP
+# if CONF_WITH_DMA_INTERRUPT
+#  error CONF_WITH_DMA_INTERRUPT requires CONF_WITH_MFP.
+# endif
+#endif
+
+#if !USE_STOP_INSN_TO_FREE_HOST_CPU
+# if CONF_WITH_DMA_INTERRUPT
+#  error CONF_WITH_DMA_INTERRUPT requires USE_STOP_INSN_TO_FREE_HOST_CPU.
+# endif
+#endif
+
+#if !CONF_WITH_FDC
+# if CONF_WITH_FLOPPY_TRACK_CACHE
+#  error CONF_WITH_FLOPPY_TRACK_CACHE requires CONF_WITH_FDC.
+# endif
+#endif
+
 #if !CONF_WITH_ALT_RAM
 # if CONF_WITH_STATIC_ALT_RAM
 #  error CONF_WITH_STATIC_ALT_RAM requires CONF_WITH_ALT_RAM.
@@ -1450,6 +1615,12 @@
 # endif
 #endif
 
+#if !CONF_WITH_VIDEL
+# if CONF_WITH_VDI_16BIT
+#  error CONF_WITH_VDI_16BIT requires CONF_WITH_VIDEL.
+# endif
+#endif
+
 #if !CONF_WITH_SCC
 # if SCC_DEBUG_PRINT
 #  error SCC_DEBUG_PRINT requires CONF_WITH_SCC.
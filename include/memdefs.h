@@ -21,6 +21,10 @@
 
 /*
  *  MD - Memory Descriptor
+ *
+ *  only the first four fields are architectural: the MD in the system
+ *  variables (themd) has no room for the others, which are used by the
+ *  BDOS to keep its free lists (see iumem.c)
  */
 typedef struct _md MD;
 struct _md
@@ -29,6 +33,10 @@ struct _md
         UBYTE   *m_start;   /* start address of memory block */
         LONG    m_length;   /* number of bytes in memory block*/
         PD      *m_own;     /* owner's process descriptor */
+        MD      *m_prev;    /* previous MD in same list, or NULL */
+        MD      *m_lower;   /* MD for the block just below, or NULL */
+        MD      *m_higher;  /* MD for the block just above, or NULL */
+        WORD    m_flags;
 };
 
 /*
@@ -39,13 +47,21 @@ struct _md
 
 /*
  *  MPB - Memory Partition Block
+ *
+ *  only the first three fields are architectural: Getmpb() fills in
+ *  mp_mfl & mp_mal, and the BDOS uses the others for its free lists
  */
+#define MP_CLASSES  32      /* size classes of free blocks */
+
 typedef struct _mpb MPB;
 struct _mpb
 {
         MD      *mp_mfl;    /* memory free list */
         MD      *mp_mal;    /* memory allocated list */
         MD      *mp_rover;  /* roving pointer - no longer used */
+        MD      *mp_tail;   /* last MD in free list */
+        ULONG   mp_classmap;    /* bit n set iff mp_class[n] is valid */
+        MD      *mp_class[MP_CLASSES];  /* first free MD of each class */
 };
 
 #endif  /* _MEMDEFS_H */
@@ -18,7 +18,7 @@
 /* #include "kprint.h" */
 
 
-#if HAVE_BEZIER
+#if CONF_WITH_VDI_BEZIER
 
 /*
  * We conform to the PC-GEM/3 file standard with the inclusion of bezier
@@ -43,10 +43,10 @@
  * You can easily try this out on a piece of paper.
  */
 
-#define MIN_QUAL 0
 #define IS_BEZ(f) ((f&1)!=0)
 #define IS_JUMP(f) ((f&2)!=0)
 
+#define MAX_DEPTH   7       /* a curve is split into at most 2^MAX_DEPTH lines */
 
 
 /*
@@ -64,146 +64,238 @@ labs(LONG x)
 
 
 /*
- * gen_segs -  compute bezier function by difference method
+ * bez_depth - choose the number of lines to split a curve into
+ *
+ * A cubic Bezier curve split into n lines of equal parameter steps
+ * deviates from those lines by at most 3/4 * D / n^2, where D is the
+ * largest second difference of the control points.  The allowed
+ * deviation depends on the quality: 1/4 pixel for the highest quality
+ * (7), doubling for each step down.  So the smallest depth k, with
+ * n = 2^k, satisfying 2^(2k+7-qual) >= 3 * D is chosen.
  *
- * last point is included
- * one dimension only, so use alternate elements of array & px
- * array[0] : anchor 1
- * array[2] : control 1
- * array[4] : control 2
- * array[6] : anchor 2
+ * The depth is also limited so that the forward differences in
+ * bez_init() cannot overflow, even for huge curves.
  */
-static void
-gen_segs(WORD *const array, WORD *px, const int bez_qual,
-         WORD * pmin, WORD * pmax, WORD fill)
+static int
+bez_depth(const Point *p, int qual)
 {
-    LONG d3x, d2x, d1x;
-    LONG x0;
-    int q = 3 * bez_qual;
-    int qd = 0;
-    int i;
-    WORD x;
-
-    /*** calculate 1st, 2nd & 3rd order differences ***/
-    d1x = (LONG)array[2]-array[0];
-    d2x = (LONG)array[4]-array[2];
-    d3x = -array[0] - 3*d2x + array[6];
-    d2x -= d1x;
-
-    if (!fill && q >= 3) {
-        d1x>>=1;
-        d2x>>=1;
-        d3x>>=1;
-        q--;
+    LONG d, dx, dy, extent;
+    int i, k;
+
+    dx = labs((LONG)p[0].x - 2 * (LONG)p[1].x + p[2].x);
+    d = labs((LONG)p[1].x - 2 * (LONG)p[2].x + p[3].x);
+    if (d > dx)
+        dx = d;
+    dy = labs((LONG)p[0].y - 2 * (LONG)p[1].y + p[2].y);
+    d = labs((LONG)p[1].y - 2 * (LONG)p[2].y + p[3].y);
+    if (d > dy)
+        dy = d;
+    d = 3 * (dx + dy);
+
+    for (k = 0; k < MAX_DEPTH; k++)
+        if ((1L << (2 * k + 7 - qual)) >= d)
+            break;
+
+    for (i = 1, extent = 0; i < 4; i++) {
+        d = labs((LONG)p[i].x - p[0].x);
+        if (d > extent)
+            extent = d;
+        d = labs((LONG)p[i].y - p[0].y);
+        if (d > extent)
+            extent = d;
     }
+    while ((k > 0) && (extent > (0x7fffffffL >> (2 * k + 3))))
+        k--;
 
-    d1x = ((3L * d1x) << (2 * bez_qual)) + ((3L * d2x) << bez_qual) + d3x;
-    /* assert( d1x <=  0x5f408000 ); */
-    /* assert( d1x >= -0x5f408000 ); */
-
-    d3x = 6L*d3x;
-    /* assert( d3x <=  0xbffe8 ); */
-    /* assert( d3x >= -0xbffe8 ); */
-
-    d2x = ((6L*d2x)<<bez_qual) + d3x;
-    /* assert( d2x <=  0x2f6fa12 ); */
-    /* assert( d2x >= -0x2f6fa12 ); */
-
-    x0 = labs(array[0]);
-    while( x0 >= (0x7fffffffL>>q) )
-        q--, qd++;
-
-    x0 = (((LONG)array[0]) << q) + (1L << (q - 1));
-
-    for(i = 1 << bez_qual; i > 0; i--) {
-        x = (WORD)(x0 >> q);
-        *px = x;
-        if ( x < *pmin )
-            *pmin = x;
-        if ( x > *pmax )
-            *pmax = x;
-        px+=2;
-
-        if (labs( (x0 >> 1) + (d1x >> (qd + 1)) ) >= 0x3ffffffeL) {
-            /** halve scale to avoid overflow **/
-            x0 = x0 >> 1;
-            q--;
-            qd++;
-            /* assert( labs(x0+(d1x>>qd)) >= 0x40000000L ); */
-        }
+    return k;
+}
 
-        x0 += d1x >> qd;
-        if ( qd > 0 && labs(x0) < 0x40000000L ) {
-            /** double scale to maximise accuracy **/
-            x0 = (x0 << 1)|1;
-            q++, qd--;
-        }
 
-        /* assert( d2x<0 || d1x <=  0x7fffffff-d2x ); */
-        /* assert( d2x>0 || d1x >= -0x7fffffff-d2x ); */
-        d1x += d2x;
-        d2x += d3x;
-        /* assert( d2x <=  0x30bf9e8 ); */
-        /* assert( d2x >= -0x30bf9e8 ); */
+
+/*
+ * forward differencing
+ *
+ * For n = 2^k steps, the position and its 1st, 2nd & 3rd order
+ * differences are scaled by n^3, i.e. they have 3k fraction bits, which
+ * makes them exact integers.  The position is kept as an integer part
+ * and a fraction, so that only the differences need to fit in a LONG.
+ */
+typedef struct {
+    LONG pos;               /* integer part of position */
+    LONG frac;              /* fraction of position */
+    LONG d1, d2, d3;        /* 1st, 2nd & 3rd order differences */
+} BEZ_AXIS;
+
+typedef struct {
+    BEZ_AXIS x, y;
+    int shift;              /* number of fraction bits */
+    LONG mask;              /* mask for fraction */
+    int steps;              /* number of points still to come */
+    Point end;              /* last point, which is output exactly */
+} BEZ_CURVE;
+
+
+static void
+axis_init(BEZ_AXIS *axis, WORD p0, WORD p1, WORD p2, WORD p3, int k)
+{
+    LONG c1, c2, c3;
+
+    c1 = (LONG)p1 - p0;
+    c2 = (LONG)p2 - p1 - c1;
+    c3 = (LONG)p3 - p0 - 3 * ((LONG)p2 - p1);
+
+    axis->d1 = ((3 * c1) << (2 * k)) + ((3 * c2) << k) + c3;
+    axis->d3 = 6 * c3;
+    axis->d2 = ((6 * c2) << k) + axis->d3;
+    axis->pos = p0;
+    axis->frac = k ? 1L << (3 * k - 1) : 0;     /* for rounding */
+}
+
+
+static __inline__ WORD
+axis_step(BEZ_AXIS *axis, int shift, LONG mask)
+{
+    axis->frac += axis->d1;
+    axis->pos += axis->frac >> shift;
+    axis->frac &= mask;
+    axis->d1 += axis->d2;
+    axis->d2 += axis->d3;
+
+    return (WORD)axis->pos;
+}
+
+
+/*
+ * bez_init - prepare to generate the points of a curve
+ */
+static void
+bez_init(BEZ_CURVE *bez, const Point *p, int k)
+{
+    axis_init(&bez->x, p[0].x, p[1].x, p[2].x, p[3].x, k);
+    axis_init(&bez->y, p[0].y, p[1].y, p[2].y, p[3].y, k);
+    bez->shift = 3 * k;
+    bez->mask = (1L << bez->shift) - 1;
+    bez->steps = 1 << k;
+    bez->end = p[3];
+}
+
+
+/*
+ * bez_next - get the next point of a curve
+ *
+ * the start point is not returned, the end point is
+ * returns FALSE when there are no more points
+ */
+static __inline__ BOOL
+bez_next(BEZ_CURVE *bez, Point *pt)
+{
+    if (bez->steps <= 0)
+        return FALSE;
+
+    if (--bez->steps == 0)
+        *pt = bez->end;
+    else {
+        pt->x = axis_step(&bez->x, bez->shift, bez->mask);
+        pt->y = axis_step(&bez->y, bez->shift, bez->mask);
     }
 
-    /** add the last point .. */
-    *px = x = array[6];
-    if ( x < *pmin )
-        *pmin = x;
-    if ( x > *pmax )
-        *pmax = x;
+    return TRUE;
 }
 
 
 
 /*
- * draw_segs - draw segments in xptsin array
+ * path handling
  *
- * do piece-wise if input array is too big
- * not guaranteed to work if FILL, but still better than anything else
+ * A path is a (possibly disjoint) series of bezier curves & polylines,
+ * as passed to v_bez() & v_bez_fill().  walk_path() turns it into a
+ * series of points, each of which either starts a new contour (at the
+ * jump points) or is joined to the previous point.  These are passed
+ * on to the line drawing code or, when filling, collected for the
+ * polygon fill code.
  */
+/* the most points a path may produce for v_bez_fill() */
+#define MAX_BEZ_POINTS      32767
+
+typedef struct {
+    Vwk *vwk;
+    BOOL counting;          /* TRUE: only count points & contours */
+    Point *points;          /* when filling: collected points */
+    WORD *ends;             /* when filling: ends of contours */
+    LONG npoints;           /* number of points so far */
+    LONG ncontours;         /* number of complete contours so far */
+    WORD jumps;             /* number of jump points */
+    Point last;             /* when drawing: the previous point */
+    WORD xmin, ymin, xmax, ymax;    /* extent of the points */
+} BEZ_PATH;
 
-/* mode values for draw_segs() */
-#define FILL    9       /* v_pline() */
-#define NO_FILL 6       /* v_fill_area() */
 
 static void
-draw_segs(Vwk * vwk, WORD nr_vertices, Point * point, WORD mode)
+path_point(BEZ_PATH *path, const Point *pt, BOOL jump)
 {
-    if ( nr_vertices >= 2 ) {
-        if (nr_vertices > INQ_TAB[14])
-            nr_vertices = INQ_TAB[14];
+    if (path->counting) {
+        if (jump && path->npoints)
+            path->ncontours++;
+        path->npoints++;
+        return;
+    }
 
-        /* output to driver, converting ndc if necessary */
-        if (mode == FILL) {
-            polygon(vwk, point, nr_vertices);
-        }
-        else
-        {
-            short i;
-            Line line;
-
-            LSTLIN = FALSE;
-            for(i = nr_vertices - 1; i > 0; i--) {
-                line.x1 = point->x;
-                line.y1 = point->y;
-                point++;                /* advance point by point */
-                line.x2 = point->x;
-                line.y2 = point->y;
-
-                if (!vwk->clip || clip_line(vwk, &line))
-                    abline(&line, vwk->wrt_mode, vwk->line_color);
-            }
-        }
+    if (path->npoints == 0) {
+        path->xmin = path->xmax = pt->x;
+        path->ymin = path->ymax = pt->y;
+    } else {
+        if (pt->x < path->xmin)
+            path->xmin = pt->x;
+        if (pt->x > path->xmax)
+            path->xmax = pt->x;
+        if (pt->y < path->ymin)
+            path->ymin = pt->y;
+        if (pt->y > path->ymax)
+            path->ymax = pt->y;
     }
+
+    if (path->points) {
+        /* filling: collect the points */
+        if (jump && path->npoints)
+            path->ends[path->ncontours++] = path->npoints;
+        path->points[path->npoints] = *pt;
+    } else if (!jump) {
+        /* drawing: join to the previous point */
+        Line line;
+
+        line.x1 = path->last.x;
+        line.y1 = path->last.y;
+        line.x2 = pt->x;
+        line.y2 = pt->y;
+        if (!path->vwk->clip || clip_line(path->vwk, &line))
+            abline(&line, path->vwk->wrt_mode, path->vwk->line_color);
+    }
+    path->last = *pt;
+    path->npoints++;
+}
+
+
+static void
+path_curve(BEZ_PATH *path, const Point *p)
+{
+    BEZ_CURVE bez;
+    Point pt;
+    int k;
+
+    k = bez_depth(p, path->vwk->bez_qual);
+    if (path->counting) {
+        path->npoints += 1 << k;
+        return;
+    }
+
+    bez_init(&bez, p, k);
+    while (bez_next(&bez, &pt))
+        path_point(path, &pt, FALSE);
 }
 
 
 /*
- * v_bez - draw a bezier curve
- *
- * outputs a (possibly disjoint) series of bezier curves & polylines.
+ * walk_path - process the points of a path
  *
  * Each element in bezarr[] is a flag that controls the behaviour of the
  * corresponding input point.
@@ -214,363 +306,155 @@ draw_segs(Vwk * vwk, WORD nr_vertices, Point * point, WORD mode)
  *         2. 1st control point
  *         3. 2nd control point
  *         4. end point
+ * The end point may itself start another curve.
  *
  * If bit 0 is zero, the corresponding point is part of a polyline.
  *
  * If bit 1 is set, the corresponding point starts a new disconnected
- * bezier curve.
+ * curve or polyline.
  *
  * Note: The C function calls are as described here, but internally the C
  * libraries byte swap bezarr[] for intel compatible format.
  * If you are not using the C library, but directly programming the VDI
  * interface, you need to do the byte swapping yourself.
  */
-
-void
-v_bez(Vwk * vwk, Point * ptsget, int nr_ptsin)
+static void
+walk_path(BEZ_PATH *path, const Point *point, int count)
 {
+    const UBYTE *bezarr = (const UBYTE *)INTIN;
     int i;
-    /* WORD  const nr_ptsin = CONTRL[1]; */
-    UBYTE * bezarr = (UBYTE*)INTIN;
-    WORD bez_qual;
-    WORD xmin, xmax, ymin, ymax;
-    WORD total_vertices = nr_ptsin;
-    WORD total_jumps = 0;
-    UWORD vertices_per_bez;
-    Point ptsbuf[MAX_PTSIN];
-    /* Point * ptsget = (Point*)PTSIN; */
-    Point * ptsput = ptsbuf;
-
-    bez_qual = vwk->bez_qual;
-    vertices_per_bez = 1 << bez_qual;
-    xmin = ymin = 32767;
-    xmax = ymax = 0;
-
-    i = 0;
-    while(i < nr_ptsin) {
-        int flag = bezarr[i^1];         /* index with xor 1 to byte swap !! */
 
-        if (IS_BEZ(flag)) {
-            /* bezier start point found */
-            if (i+3 >= nr_ptsin)
-                break;                  /* incomlete curve, omit it */
+    path->npoints = 0;
+    path->ncontours = 0;
+    path->jumps = 0;
 
-            if (IS_JUMP(flag))
-                total_jumps++;          /* count jump point */
+    for (i = 0; i < count; i++) {
+        int flag = bezarr[i^1];         /* index with xor 1 to byte swap !! */
 
-            /* generate line segments from bez points */
-            gen_segs(&ptsget->x, &ptsput->x, bez_qual, &xmin, &xmax, vwk->xfm_mode);    /* x coords */
-            gen_segs(&ptsget->y, &ptsput->y, bez_qual, &ymin, &ymax, vwk->xfm_mode);    /* y coords */
+        if (IS_JUMP(flag))
+            path->jumps++;
+        path_point(path, &point[i], (i == 0) || IS_JUMP(flag));
 
-            /* skip to coord pairs at end of bez curve */
+        while (IS_BEZ(flag)) {
+            if (i+3 >= count)
+                return;                 /* incomplete curve, omit it */
+            path_curve(path, &point[i]);
             i += 3;
-            ptsget += 3;
-            total_vertices += vertices_per_bez-3;
-            draw_segs(vwk, vertices_per_bez+1, ptsbuf, NO_FILL );
-        }
-        else {
-            /* polyline */
-            WORD output_vertices = 0;
-            Point * point = ptsget;
-            do {
-                int t;
-
-                t = point->x;
-                if ( t < xmin )
-                    xmin = t;
-                if ( t > xmax )
-                    xmax = t;
-
-                t = point->y;
-                if ( t < ymin )
-                    ymin = t;
-                if ( t > ymax )
-                    ymax = t;
-
-                output_vertices++;
-                if ( IS_BEZ(flag) )
-                    break;              /* stop if a jump point is next */
-
-                /* continue polyline */
-                i++;
-                if (i >= nr_ptsin)
-                    break;
-
-                ptsget += 1;
-                {
-                    int old_flag = flag;
-                    flag = bezarr[i^1];
-                    if (!IS_JUMP(old_flag) && IS_JUMP(flag))
-                        total_jumps++;   /* count jump point */
-                }
-            } while( !IS_JUMP(flag) );
-            draw_segs(vwk, output_vertices, point, NO_FILL);
+            flag = bezarr[i^1];
         }
     }
+}
 
-    INTOUT[0] = total_vertices; /* total nr points */
-    INTOUT[1] = total_jumps;    /* total moves */
+
+/*
+ * set the output of v_bez() & v_bez_fill()
+ */
+static void
+path_output(const BEZ_PATH *path)
+{
+    /* total nr points */
+    INTOUT[0] = (path->npoints > MAX_BEZ_POINTS) ? MAX_BEZ_POINTS : path->npoints;
+    INTOUT[1] = path->jumps;            /* total moves */
     CONTRL[4] = 2;
     CONTRL[2] = 2;
-    PTSOUT[0] = xmin;
-    PTSOUT[1] = ymin;
-    PTSOUT[2] = xmax;
-    PTSOUT[3] = ymax;
-
-    return;
+    PTSOUT[0] = path->xmin;
+    PTSOUT[1] = path->ymin;
+    PTSOUT[2] = path->xmax;
+    PTSOUT[3] = path->ymax;
 }
 
 
 /*
- * v_bez_fill - draw a filled bezier curve
+ * v_bez - draw a bezier curve
  *
- * It is similar to v_bez(), but it forms a closed contour and fills
- * it with the current fill pattern.
+ * outputs a (possibly disjoint) series of bezier curves & polylines,
+ * see walk_path().  The curves are split into lines which are drawn
+ * directly, without buffering them.
  */
-#if 1
 void
-v_bez_fill(Vwk * vwk, Point * ptsget, int nr_ptsin)
+v_bez(Vwk * vwk, Point * point, int count)
 {
-    int i;
-    /* WORD  const nr_ptsin = CONTRL[1]; */
-    UBYTE * bezarr = (UBYTE*)INTIN;
-    WORD bez_qual;
-    WORD xmin, xmax, ymin, ymax;
-    WORD total_vertices = nr_ptsin;
-    WORD total_jumps = 0;
-    UWORD vertices_per_bez;
-    WORD output_vertices = 0;
-    Point ptsbuf[MAX_PTSIN];
-    /* Point * ptsget = (Point*)PTSIN; */
-    Point * ptsput = ptsbuf;
-
-    bez_qual = vwk->bez_qual;
-    vertices_per_bez = 1 << bez_qual;
-    xmin = ymin = 32767;
-    xmax = ymax = 0;
-
-    i = 0;
-    while(i < nr_ptsin) {
-        int flag = bezarr[i^1]; /* index with xor 1 to byte swap !! */
-
-        if (IS_BEZ(flag)) {
-            /* bezier start point found */
-            if (i+3 >= nr_ptsin)
-                break;
-
-            if (IS_JUMP(flag))
-                total_jumps++;   /* count jump point */
-
-            /* generate line segments from bez points */
-            gen_segs(&ptsget->x, &ptsput->x, bez_qual, &xmin, &xmax, vwk->xfm_mode);
-            gen_segs(&ptsget->y, &ptsput->y, bez_qual, &ymin, &ymax, vwk->xfm_mode);
-
-            /* skip to coord pairs at end of bez curve */
-            i += 3;
-            ptsget += 3;
-            total_vertices += vertices_per_bez-3;
-
-            output_vertices += vertices_per_bez+1;
-            ptsput = ptsbuf + output_vertices;
-            /* draw_segs(vwk, vertices_per_bez+1, ptsbuf, FILL ); */
-        }
-        else {
-            /* polyline */
-            /* WORD output_vertices = 0; */
-            Point * point = ptsget;
-            do {
-                int t;
-
-                t = point->x;
-                if ( t < xmin )
-                    xmin = t;
-                if ( t > xmax )
-                    xmax = t;
-
-                t = point->y;
-                if ( t < ymin )
-                    ymin = t;
-                if ( t > ymax )
-                    ymax = t;
-
-                output_vertices++;
-                if ( IS_BEZ(flag) )
-                    break;              /* stop if a jump point is next */
-
-                /* continue polyline */
-                i++;
-                if (i >= nr_ptsin)
-                    break;
-
-                ptsget += 1;
-                {
-                    int old_flag = flag;
-                    flag = bezarr[i^1];
-                    if (!IS_JUMP(old_flag) && IS_JUMP(flag))
-                        total_jumps++;   /* count jump point */
-                }
-            } while( !IS_JUMP(flag) );
-        }
+    BEZ_PATH path;
 
-        /* draw segments and reset all vertex information */
-        draw_segs(vwk, output_vertices, ptsbuf, FILL);
-        bez_qual = vwk->bez_qual;
-        /* ptsget0 = ptsget; */
-        ptsput = ptsbuf;
-        output_vertices = 0;
+    /* larger paths are read directly from the caller's array */
+    if ((count == MAX_PTSIN) && (user_ptsin_count > MAX_PTSIN)) {
+        point = user_ptsin;
+        count = user_ptsin_count;
     }
 
-    INTOUT[0] = total_vertices; /* total nr points */
-    INTOUT[1] = total_jumps;    /* total moves */
-    CONTRL[4] = 2;
-    CONTRL[2] = 2;
-    PTSOUT[0] = xmin;
-    PTSOUT[1] = ymin;
-    PTSOUT[2] = xmax;
-    PTSOUT[3] = ymax;
+    path.vwk = vwk;
+    path.counting = FALSE;
+    path.points = NULL;
+    path.xmin = path.ymin = path.xmax = path.ymax = 0;
 
-    return;
+    LSTLIN = FALSE;
+    walk_path(&path, point, count);
+    path_output(&path);
 }
 
-#else
+
+/*
+ * v_bez_fill - draw a filled bezier curve
+ *
+ * It is similar to v_bez(), but each part of the path forms a closed
+ * contour, and they are filled together with the current fill pattern.
+ *
+ * The points generated are collected in a static buffer, or in an
+ * allocated one if that is too small.
+ */
+#define MAX_FILL_POINTS     MAX_PTSIN
+#define MAX_FILL_CONTOURS   16
+static Point fill_points[MAX_FILL_POINTS];
+static WORD fill_ends[MAX_FILL_CONTOURS];
 
 void
-v_bez_fill(Vwk * vwk, Point * ptsget, int nr_ptsin)
+v_bez_fill(Vwk * vwk, Point * point, int count)
 {
-    /* WORD  const nr_ptsin = CONTRL[1]; */
-    const UBYTE *const bezarr = (UBYTE*)INTIN;  /* index with xor 1 to byte swap !! */
-    WORD bez_qual;
-    WORD xmin, xmax, ymin, ymax;
-    WORD total_vertices = nr_ptsin;
-    WORD total_jumps = 0;
-    WORD vertices_per_bez;
-    WORD i, i0;
-    WORD output_vertices = 0;
-    Point ptsbuf[MAX_PTSIN];
-    /* Point * ptsget = (Point*)PTSIN; */
-    Point * ptsget0 = ptsget;
-    Point * ptsput = ptsbuf;
-
-    bez_qual = vwk->bez_qual;
-    vertices_per_bez = 1 << bez_qual;
-    xmin = ymin = 32767;
-    xmax = ymax = 0;
-
-    i = i0 = 0;
-    while (i < nr_ptsin) {
-        int flag = bezarr[i^1];
-
-        if (IS_BEZ( flag )) {
-            if (i+3 >= nr_ptsin)
-                break;   /* incomplete curve, omit it */
-
-            if (IS_JUMP(flag))
-                total_jumps++;   /* count jump point */
-
-            /* keep this curve within nr vertices for the driver's ptsget[]
-             ** with one spare for the end point */
-            if ( output_vertices+vertices_per_bez+1 > INQ_TAB[14] ) {
-                if ( bez_qual > MIN_QUAL ) {
-                    /* reduce bezier quality & start this polygon again */
-                    bez_qual--;
-                    i = i0;
-                    ptsget = (Point*)PTSIN;
-                    ptsget0 = ptsget;
-                    ptsput = ptsbuf;
-                    output_vertices = 0;
-                    continue;
-                }
-                /* too bad if we get here. refuse to add vertices to output */
-            }
-            else {
-                if ( i != i0 ) {
-                    /* the end point will be copied in again */
-                    ptsput -= 1;
-                    output_vertices--;
-                }
-
-                output_vertices += vertices_per_bez+1;
-                total_vertices += vertices_per_bez-3;
-                gen_segs(&ptsget->x, &ptsput->x, bez_qual, &xmin, &xmax, vwk->xfm_mode);        /* x coords */
-                gen_segs(&ptsget->y, &ptsput->y, bez_qual, &ymin, &ymax, vwk->xfm_mode);        /* y coords */
-                ptsput = ptsbuf + output_vertices;
-            }
-            /* assert( PTSIN + 2*i == ptsget ); */
-            i+=3;
-            ptsget += 3;
-            flag = bezarr[i^1];
-        }
-        else {
-            /** polyline **/
-            if (i != i0) {
-                /* the end point will be copied in again */
-                ptsput -= 1;
-                output_vertices--;
-            }
-
-            do {
-                int t;
-                if ( output_vertices < INQ_TAB[14] ) {  /* need room for at least one more */
-                    t = ptsget->x;
-                    if ( t < xmin )
-                        xmin = t;
-                    if ( t > xmax )
-                        xmax = t;
-                    ptsput->x = t;
-
-                    t = ptsget->y;
-                    if ( t < ymin )
-                        ymin = t;
-                    if ( t > ymax )
-                        ymax = t;
-                    ptsput->y = t;
-
-                    ptsput++;
-                    output_vertices++;
-                }
-
-                /* assert( ptsbuf + output_vertices == ptsput ); */
-                /* assert( PTSIN + 2*i == ptsget ); */
-                if ( IS_BEZ(flag) )
-                    break;
-                i++;
-                if (i >= nr_ptsin)
-                    break;
-
-                ptsget += 1;
-                /* continue polyline, stop if a jump point is next */
-                {
-                    int old_flag = flag;
-                    flag = bezarr[i^1];
-                    if (!IS_JUMP(old_flag) && IS_JUMP(flag))
-                        total_jumps++;   /* count jump point */
-                }
-            } while( !IS_JUMP(flag) );
-        }
+    BEZ_PATH path;
+    void *mem = NULL;
 
-        if ( i >= nr_ptsin || IS_JUMP(flag) ) {
-            draw_segs(vwk, output_vertices, ptsbuf, FILL);
-            bez_qual = vwk->bez_qual;
-            i0 = i;
-            ptsget0 = ptsget;
-            ptsput = ptsbuf;
-            output_vertices = 0;
-        }
+    /* larger paths are read directly from the caller's array */
+    if ((count == MAX_PTSIN) && (user_ptsin_count > MAX_PTSIN)) {
+        point = user_ptsin;
+        count = user_ptsin_count;
     }
 
-    INTOUT[0] = total_vertices; /* total nr points */
-    INTOUT[1] = total_jumps;    /* total moves */
-    CONTRL[4] = 2;
-    CONTRL[2] = 2;
-    PTSOUT[0] = xmin;
-    PTSOUT[1] = ymin;
-    PTSOUT[2] = xmax;
-    PTSOUT[3] = ymax;
+    path.vwk = vwk;
+    path.xmin = path.ymin = path.xmax = path.ymax = 0;
+
+    /* find out how much room we need */
+    path.counting = TRUE;
+    walk_path(&path, point, count);
+    if (path.npoints)
+        path.ncontours++;
+
+    /* the contour ends are WORDs, and polygon_contours() indexes with int */
+    if (path.npoints > MAX_BEZ_POINTS)
+        return;
+
+    path.points = fill_points;
+    path.ends = fill_ends;
+    if ((path.npoints > MAX_FILL_POINTS) || (path.ncontours > MAX_FILL_CONTOURS)) {
+        mem = (void *)trap1(X_MALLOC, (LONG)path.npoints * sizeof(Point)
+                                        + (LONG)path.ncontours * sizeof(WORD));
+        if (mem == NULL)
+            return;
+        path.points = mem;
+        path.ends = (WORD *)(path.points + path.npoints);
+    }
 
-    return;
+    /* collect the points & fill */
+    path.counting = FALSE;
+    walk_path(&path, point, count);
+    if (path.npoints) {
+        path.ends[path.ncontours++] = path.npoints;
+        polygon_contours(vwk, path.points, path.ends, path.ncontours);
+    }
+    path_output(&path);
 
+    if (mem)
+        trap1(X_MFREE, mem);
 }
-#endif
 
 
 /*
@@ -599,7 +483,8 @@ v_bez_control(Vwk * vwk)
  * lower quality bezier curve has fewer longer straight line segments.
  * Higher quality bezier curves thus appear smoother, but are slower.
  *
- * note: bez_qual > 7 will cause overflow in gen_segs()
+ * The quality determines how closely the lines follow the curve,
+ * see bez_depth().
  */
 #define MIN_QUAL 0
 static const WORD pcarr[] = {0, 10, 23, 39, 55, 71, 86, 100};
@@ -29,6 +29,9 @@
 /* Some color mapping tables */
 WORD MAP_COL[MAXCOLOURS];       /* maps vdi pen -> hardware register */
 WORD REV_MAP_COL[MAXCOLOURS];   /* maps hardware register -> vdi pen */
+#if CONF_WITH_VDI_16BIT
+UWORD TC_COL[MAXCOLOURS];       /* maps hardware register -> RGB565 pixel */
+#endif
 
 static const WORD MAP_COL_ROM[] =
     { 0, 15, 1, 2, 4, 6, 3, 5, 7, 8, 9, 10, 12, 14, 11, 13 };
@@ -480,6 +483,38 @@ static WORD videl2vdi(LONG col)
 #endif
 
 
+#if CONF_WITH_VDI_16BIT
+/*
+ * In Truecolor modes there is no hardware palette: the pixel value
+ * is the colour.  We keep a software palette instead, indexed like
+ * the hardware registers, that gives the RGB565 value for each pen.
+ */
+
+/* Create RGB565 pixel value from VDI colour */
+static UWORD vdi2tc(WORD r, WORD g, WORD b)
+{
+    UWORD pixel;
+
+    pixel = ((LONG)r * 31 + 500) / 1000;                /* scale 1000 -> 31 */
+    pixel <<= 6;
+    pixel |= ((LONG)g * 63 + 500) / 1000;               /* scale 1000 -> 63 */
+    pixel <<= 5;
+    pixel |= ((LONG)b * 31 + 500) / 1000;               /* scale 1000 -> 31 */
+
+    return pixel;
+}
+
+
+/* Create VDI colour values from RGB565 pixel value */
+static void tc2vdi(UWORD pixel, WORD *rgb)
+{
+    rgb[0] = (WORD)(((LONG)((pixel >> 11) & 0x1f) * 1000 + 15) / 31);
+    rgb[1] = (WORD)(((LONG)((pixel >> 5) & 0x3f) * 1000 + 31) / 63);
+    rgb[2] = (WORD)(((LONG)(pixel & 0x1f) * 1000 + 15) / 31);
+}
+#endif
+
+
 /*
  * Monochrome screens get special handling because they don't use the
  * regular palette setup; instead, bit 0 of h/w palette register 0
@@ -544,6 +579,14 @@ static void set_color(WORD colnum, WORD *rgb)
     g = rgb[1];
     b = rgb[2];
 
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE)
+    {
+        TC_COL[hwreg] = vdi2tc(r, g, b);
+        return;
+    }
+#endif
+
 #if CONF_WITH_VIDEL
     if (has_videl)
     {
@@ -784,6 +827,13 @@ void vdi_vq_color(Vwk *vwk)
     colnum = INTIN[0];          /* may have been munged on TT system, see above */
     hwreg = MAP_COL[colnum];    /* get hardware register */
 
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE)
+    {
+        tc2vdi(TC_COL[hwreg], &INTOUT[1]);
+        return;
+    }
+#endif
 #if CONF_WITH_VIDEL
     if (has_videl)
     {
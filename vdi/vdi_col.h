@@ -9,6 +9,10 @@
 
 extern WORD MAP_COL[], REV_MAP_COL[];
 
+#if CONF_WITH_VDI_16BIT
+extern UWORD TC_COL[];
+#endif
+
 extern WORD REQ_COL[16][3];
 
 extern void init_colors(void);
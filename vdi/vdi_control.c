@@ -77,7 +77,11 @@ static const WORD INQ_TAB_rom[45] = {
     0,                  /* 25 -  */
     0,                  /* 26 -  */
     0,                  /* 27 -  */
+#if CONF_WITH_VDI_BEZIER
+    2,                  /* 28 - bezier flag (bit 1) */
+#else
     0,                  /* 28 - bezier flag (bit 1) */
+#endif
     0,                  /* 29 -  */
     0,                  /* 30 - raster flag (bit 0), does vro_cpyfm scaling? */
     0,                  /* 31 -  */
@@ -317,6 +321,155 @@ static void init_wk(Vwk * vwk)
 
 
 
+#if CONF_WITH_VDI_EXTENSIONS
+/*
+ * off-screen bitmap workstations
+ *
+ * A workstation opened by v_open_bm() draws into a bitmap in memory,
+ * which has the same format as the screen, instead of onto the screen.
+ * While a drawing function is called for such a workstation, the screen
+ * base address and geometry used by the drawing code are temporarily
+ * replaced by those of the bitmap, see bm_enter() and bm_leave().
+ */
+static struct {
+    UBYTE *bm_addr;
+    UBYTE *bas_ad;
+    UWORD lin_wr;
+    UWORD bytes_lin;
+    UWORD hz_rez;
+    UWORD vt_rez;
+    WORD dev_xres;
+    WORD dev_yres;
+} saved_screen;
+
+
+/*
+ * bm_enter - make the bitmap of a workstation the drawing target
+ */
+void bm_enter(const Vwk * vwk)
+{
+    /* the mouse cursor must not be drawn while we are switched */
+    mouse_flag += 1;
+
+    saved_screen.bas_ad = v_bas_ad;
+    saved_screen.lin_wr = v_lin_wr;
+    saved_screen.bytes_lin = v_bytes_lin;
+    saved_screen.hz_rez = v_hz_rez;
+    saved_screen.vt_rez = v_vt_rez;
+    saved_screen.dev_xres = xres;
+    saved_screen.dev_yres = yres;
+
+    v_bas_ad = saved_screen.bm_addr = vwk->bm_addr;
+    v_lin_wr = v_bytes_lin = vwk->bm_lin_wr;
+    v_hz_rez = vwk->bm_width;
+    v_vt_rez = vwk->bm_height;
+    xres = vwk->bm_width - 1;
+    yres = vwk->bm_height - 1;
+}
+
+
+/*
+ * bm_leave - make the screen the drawing target again
+ */
+void bm_leave(void)
+{
+    /* unless the VBL has just installed a new screen (Setscreen()) */
+    if (v_bas_ad == saved_screen.bm_addr)
+        v_bas_ad = saved_screen.bas_ad;
+    v_lin_wr = saved_screen.lin_wr;
+    v_bytes_lin = saved_screen.bytes_lin;
+    v_hz_rez = saved_screen.hz_rez;
+    v_vt_rez = saved_screen.vt_rez;
+    xres = saved_screen.dev_xres;
+    yres = saved_screen.dev_yres;
+
+    mouse_flag -= 1;
+}
+
+
+/* the largest line length of a bitmap, in bytes (v_lin_wr is a WORD) */
+#define MAX_BM_LINE     32767L
+
+/*
+ * bm_open - set up the bitmap for v_open_bm()
+ *
+ * The MFDB is passed in CONTRL[7-8].  If its fd_addr is NULL, we
+ * allocate a bitmap of the size given by INTIN[11] & INTIN[12] (the
+ * size of the screen if they are zero), and fill in the MFDB.
+ * Otherwise the caller's bitmap is used, which must be in device-
+ * specific format with the same number of planes as the screen.
+ *
+ * returns FALSE if the bitmap cannot be used or allocated
+ */
+static BOOL bm_open(Vwk * vwk)
+{
+    MFDB *mfdb = *(MFDB **)&CONTRL[7];
+    WORD width, height, wdwidth;
+    UBYTE *addr;
+
+    if (mfdb->fd_addr) {
+        if (mfdb->fd_nplanes != v_planes)
+            return FALSE;
+        if (mfdb->fd_stand)
+            return FALSE;
+        width = mfdb->fd_w;
+        height = mfdb->fd_h;
+        wdwidth = mfdb->fd_wdwidth;
+        if ((width <= 0) || (height <= 0) || (wdwidth < (width + 15L) / 16))
+            return FALSE;
+        if ((LONG)wdwidth * 2 * v_planes > MAX_BM_LINE)
+            return FALSE;
+        addr = mfdb->fd_addr;
+        vwk->bm_allocated = FALSE;
+    } else {
+        /* the size is given as the maximum coordinates, width-1 & height-1 */
+        if ((INTIN[11] < 0) || (INTIN[11] >= 32767)
+         || (INTIN[12] < 0) || (INTIN[12] >= 32767))
+            return FALSE;
+        width = INTIN[11] ? INTIN[11] + 1 : v_hz_rez;
+        height = INTIN[12] ? INTIN[12] + 1 : v_vt_rez;
+        wdwidth = (width + 15L) / 16;
+        if ((LONG)wdwidth * 2 * v_planes > MAX_BM_LINE)
+            return FALSE;
+        addr = (UBYTE *)trap1(X_MALLOC, (LONG)wdwidth * 2 * v_planes * height);
+        if (addr == NULL)
+            return FALSE;
+        mfdb->fd_addr = addr;
+        mfdb->fd_w = wdwidth * 16;
+        mfdb->fd_h = height;
+        mfdb->fd_wdwidth = wdwidth;
+        mfdb->fd_stand = 0;
+        mfdb->fd_nplanes = v_planes;
+        mfdb->fd_r1 = mfdb->fd_r2 = mfdb->fd_r3 = 0;
+        vwk->bm_allocated = TRUE;
+    }
+
+    vwk->bm_addr = addr;
+    vwk->bm_width = width;
+    vwk->bm_height = height;
+    vwk->bm_lin_wr = wdwidth * 2 * v_planes;
+
+    return TRUE;
+}
+
+
+/*
+ * bm_close - release the bitmap of a workstation, if any
+ */
+static void bm_close(Vwk * vwk)
+{
+    if (vwk->bm_addr && vwk->bm_allocated)
+        trap1(X_MFREE, vwk->bm_addr);
+}
+#endif
+
+
+
+/*
+ * vdi_v_opnvwk - open a virtual workstation
+ *
+ * also implements v_open_bm() (sub-opcode 1), if CONF_WITH_VDI_EXTENSIONS
+ */
 void vdi_v_opnvwk(Vwk * vwk)
 {
     WORD handle;
@@ -329,6 +482,17 @@ void vdi_v_opnvwk(Vwk * vwk)
         return;
     }
 
+#if CONF_WITH_VDI_EXTENSIONS
+    vwk->bm_addr = NULL;
+    if ((CONTRL[5] == 1) && (CONTRL[3] >= 20)) {
+        if (!bm_open(vwk)) {
+            trap1(X_MFREE, vwk);
+            CONTRL[6] = 0;
+            return;
+        }
+    }
+#endif
+
     /* Now find a free handle */
     handle = 1;
     work_ptr = &virt_work;
@@ -345,6 +509,16 @@ void vdi_v_opnvwk(Vwk * vwk)
     vwk->next_work = temp;
 
     vwk->handle = CONTRL[6] = handle;
+#if CONF_WITH_VDI_EXTENSIONS
+    if (vwk->bm_addr) {
+        /* the workstation has the size of the bitmap */
+        bm_enter(vwk);
+        init_wk(vwk);
+        if (vwk->bm_allocated)
+            vdi_v_clrwk(vwk);
+        bm_leave();
+    } else
+#endif
     init_wk(vwk);
     CUR_WORK = vwk;
 }
@@ -364,6 +538,9 @@ void vdi_v_clsvwk(Vwk * vwk)
 
     work_ptr->next_work = vwk->next_work;
     CUR_WORK = work_ptr;
+#if CONF_WITH_VDI_EXTENSIONS
+    bm_close(vwk);              /* also implements v_close_bm() */
+#endif
     trap1(X_MFREE, vwk);
 }
 
@@ -406,6 +583,9 @@ void vdi_v_opnwk(Vwk * vwk)
     vwk = &virt_work;
     CONTRL[6] = vwk->handle = 1;
     vwk->next_work = NULL;
+#if CONF_WITH_VDI_EXTENSIONS
+    vwk->bm_addr = NULL;
+#endif
 
     line_cw = -1;               /* invalidate current line width */
 
@@ -431,6 +611,9 @@ void vdi_v_clswk(Vwk * vwk)
         vwk = virt_work.next_work;
         do {
             next_work = vwk->next_work;
+#if CONF_WITH_VDI_EXTENSIONS
+            bm_close(vwk);
+#endif
             trap1(X_MFREE, vwk);
         } while ((vwk = next_work));
     }
@@ -455,6 +638,18 @@ void vdi_v_clrwk(Vwk * vwk)
     /* Calculate screen size */
     size = (ULONG)v_lin_wr * v_vt_rez;
 
+#if CONF_WITH_VDI_16BIT
+    /* all bits zero is black, so fill with the colour of pen 0 */
+    if (TRUECOLOR_MODE) {
+        UWORD *addr = (UWORD *)v_bas_ad;
+        UWORD pixel = TC_COL[0];
+
+        for (size /= sizeof(UWORD); size; size--)
+            *addr++ = pixel;
+        return;
+    }
+#endif
+
     /* clear the screen */
     memset(v_bas_ad, 0, size);
 }
@@ -16,8 +16,6 @@
 #include "portab.h"
 #include "fonthdr.h"
 
-#define HAVE_BEZIER 0           /* switch on bezier capability */
-
 /* GEMDOS function numbers */
 #define X_MALLOC 0x48
 #define X_MFREE 0x49
@@ -154,9 +152,31 @@ struct Vwk_ {
     WORD ymx_clip;              /* High y point of clipping rectangle   */
     /* newly added */
     WORD bez_qual;              /* actual quality for bezier curves */
+#if CONF_WITH_VDI_EXTENSIONS
+    /* off-screen bitmap workstations (v_open_bm) */
+    UBYTE *bm_addr;             /* start of bitmap, NULL if the screen  */
+    WORD bm_width;              /* width of bitmap in pixels            */
+    WORD bm_height;             /* height of bitmap in pixels           */
+    UWORD bm_lin_wr;            /* bytes per line of bitmap             */
+    BOOL bm_allocated;          /* TRUE if the VDI allocated the bitmap */
+#endif
 };
 
 
+/* Raster definitions */
+typedef struct {
+    void *fd_addr;
+    WORD fd_w;
+    WORD fd_h;
+    WORD fd_wdwidth;
+    WORD fd_stand;
+    WORD fd_nplanes;
+    WORD fd_r1;
+    WORD fd_r2;
+    WORD fd_r3;
+} MFDB;
+
+
 typedef struct Rect_ Rect;
 struct Rect_
 {
@@ -242,16 +262,25 @@ void arb_line(Line * line);
 
 /* C Support routines */
 Vwk * get_vwk_by_handle(WORD);
+#if CONF_WITH_VDI_EXTENSIONS
+void bm_enter(const Vwk * vwk);
+void bm_leave(void);
+#endif
 UWORD * get_start_addr(const WORD x, const WORD y);
 void set_LN_MASK(Vwk *vwk);
 void st_fl_ptr(Vwk *);
 void d_justified(Vwk *);
 
+/* the caller's PTSIN array & CONTRL[1], saved by vdi_asm.S */
+extern Point *user_ptsin;
+extern WORD user_ptsin_count;
+
 /* drawing primitives */
 void draw_pline(Vwk * vwk);
 void arrow(Vwk * vwk, Point * point, int count);
 void draw_rect(const Vwk * vwk, Rect * rect, const UWORD fillcolor);
 void polygon(Vwk * vwk, Point * point, int count);
+void polygon_contours(Vwk * vwk, const Point * point, const WORD * ends, int contours);
 void polyline(Vwk * vwk, Point * point, int count, WORD color);
 void wideline(Vwk * vwk, Point * point, int count);
 
@@ -262,6 +291,14 @@ void clc_flit (const VwkAttrib * attr, const VwkClip * clipper, const Point * po
 void abline (const Line * line, const WORD wrt_mode, UWORD color);
 void contourfill(const VwkAttrib * attr, const VwkClip *clip);
 
+#if CONF_WITH_VDI_16BIT
+/* packed-pixel (Truecolor) versions of the drawing primitives */
+UWORD * get_start_addr16(const WORD x, const WORD y);
+void draw_rect_tc(const VwkAttrib *attr, const Rect *rect);
+void abline_tc(const Line * line, const WORD wrt_mode, UWORD color);
+void text_blt_tc(Vwk * vwk);
+#endif
+
 /* initialization of subsystems */
 void text_init(Vwk *);
 void text_init2(Vwk *);
@@ -311,7 +311,7 @@ void vdi_v_escape(Vwk * vwk)
 
     KDEBUG(("VDI esc, subfunction %u called\n",escfun));
 
-#if HAVE_BEZIER
+#if CONF_WITH_VDI_BEZIER
     if (escfun == 99) {
         v_bez_qual(vwk);        /* set quality of bezier curves */
         return;
@@ -14,6 +14,7 @@
 #include "config.h"
 #include "portab.h"
 #include "vdi_defs.h"
+#include "asm.h"
 #include "../bios/tosvars.h"
 #include "../bios/lineavars.h"
 
@@ -367,14 +368,63 @@ bub_sort (WORD * buf, WORD count)
 
 
 /*
- * clc_flit - draw a filled polygon
+ * fill_span - draw the part of a scan line between two intersections
+ *
+ * The x-coordinates are adjusted so that the border of the figure will
+ * not be drawn with the fill pattern.  If the starting point is then
+ * greater than the ending point, nothing is done.  If clipping is in
+ * force, the segment is also clipped to the left and right sides of
+ * the clipping rectangle.
+ */
+static void
+fill_span(const VwkAttrib * attr, const VwkClip * clipper, WORD x1, WORD x2, WORD y)
+{
+    Rect rect;
+
+    x1++;
+    x2--;
+
+    /* do nothing, if starting point greater than ending point */
+    if (x1 > x2)
+        return;
+
+    if (attr->clip) {
+        if (x1 < clipper->xmn_clip) {
+            if (x2 < clipper->xmn_clip)
+                return;                 /* entire segment clipped left */
+            x1 = clipper->xmn_clip;     /* clip left end of line */
+        }
+
+        if (x2 > clipper->xmx_clip) {
+            if (x1 > clipper->xmx_clip)
+                return;                 /* entire segment clipped right */
+            x2 = clipper->xmx_clip;     /* clip right end of line */
+        }
+    }
+
+    rect.x1 = x1;
+    rect.y1 = y;
+    rect.x2 = x2;
+    rect.y2 = y;
+
+    /* rectangle fill routine draws horizontal line */
+    draw_rect_common(attr, &rect);
+}
+
+
+
+/*
+ * clc_flit - draw one scan line of a filled polygon
  *
  * (Sutherland and Hodgman Polygon Clipping Algorithm)
  *
- * For each non-horizontal scanline crossing poly, do:
+ * For the given non-horizontal scanline crossing poly, do:
  *   - find intersection points of scan line with poly edges.
  *   - Sort intersections left to right
  *   - Draw pixels between each pair of points (x coords) on the scan line
+ *
+ * This is used by the Line-A polygon function, which draws a single
+ * scan line per call; polygon() uses the edge table code below.
  */
 /*
  * the buffer used by clc_flit() has been temporarily moved from the
@@ -459,100 +509,279 @@ clc_flit (const VwkAttrib * attr, const VwkClip * clipper, const Point * point,
     if ( intersections > 1 )
         bub_sort(fill_buffer, intersections);
 
-    if (attr->clip) {
-        /* Clipping is in force.  Once the endpoints of the line segment have */
-        /* been adjusted for the border, clip them to the left and right sides */
-        /* of the clipping rectangle. */
+    /* draw from point to point */
+    bufptr = fill_buffer;
+    for (i = intersections / 2 - 1; i >= 0; i--, bufptr += 2)
+        fill_span(attr, clipper, bufptr[0], bufptr[1], y);
+}
 
-        /* The x-coordinates of each line segment are adjusted so that the */
-        /* border of the figure will not be drawn with the fill pattern. */
 
-        /* loop through buffered points */
-        WORD * ptr = fill_buffer;
-        for (i = intersections / 2 - 1; i >= 0; i--) {
-            WORD x1, x2;
-            Rect rect;
 
-            /* grab a pair of adjusted intersections */
-            x1 = *ptr++ + 1;
-            x2 = *ptr++ - 1;
+/*
+ * edge table polygon fill
+ *
+ * polygon() builds a table of all the non-horizontal edges, sorted by
+ * their topmost scan line.  While working down the polygon, edges are
+ * moved from this table to the active edge list when the current scan
+ * line reaches them, and dropped when it passes their bottom.  The
+ * active edge list is kept sorted by x, and the x-coordinate of each
+ * active edge is stepped incrementally from one scan line to the next,
+ * so the cost is proportional to the number of edges plus the number of
+ * spans drawn, instead of edges times scan lines.
+ *
+ * An edge covers the scan lines from its top y up to but excluding its
+ * bottom y.  The x-coordinates produced are exactly those computed by
+ * clc_flit(), i.e. the intersection is rounded from the endpoint with
+ * the lower x: x = xref + (2*w*d + h) / (2*h), where w & h are the
+ * width & height of the edge, and d is the distance in y between the
+ * scan line and the reference endpoint.  This is stepped as a DDA.
+ */
+typedef struct edge {
+    struct edge *next;          /* next edge in table or active list */
+    WORD ytop;                  /* first scan line crossed */
+    WORD ybot;                  /* first scan line below the edge */
+    WORD x;                     /* x of the current intersection */
+    WORD xstep;                 /* whole part of x step per scan line */
+    BOOL down;                  /* TRUE if d increases with y */
+    LONG err;                   /* fractional part of x, 0 <= err < den */
+    LONG errstep;               /* fractional part of x step */
+    LONG den;                   /* 2 * height of edge */
+} EDGE;
 
-            /* do nothing, if starting point greater than ending point */
-            if ( x1 > x2 )
-                continue;
+/*
+ * Like fill_buffer, the edge table for small polygons (which covers all
+ * those that the VDI & AES generate themselves) is kept in a static
+ * area, to avoid stack overflow.  Larger ones are allocated as needed.
+ */
+#define MAX_STATIC_EDGES    (2*MAX_ARC_CT)
+static EDGE edge_buffer[MAX_STATIC_EDGES];
 
-            if ( x1 < clipper->xmn_clip ) {
-                if ( x2 < clipper->xmn_clip )
-                    continue;           /* entire segment clipped left */
-                x1 = clipper->xmn_clip; /* clip left end of line */
-            }
 
-            if ( x2 > clipper->xmx_clip ) {
-                if ( x1 > clipper->xmx_clip )
-                    continue;           /* entire segment clippped */
-                x2 = clipper->xmx_clip; /* clip right end of line */
-            }
-            rect.x1 = x1;
-            rect.y1 = y;
-            rect.x2 = x2;
-            rect.y2 = y;
+/*
+ * edge_init - set up an edge's intersection with scan line y
+ *
+ * ytop & ybot must already be set
+ */
+static void
+edge_init(EDGE *edge, const Point *p1, const Point *p2, WORD y)
+{
+    const Point *ref, *other;
+    LONG w2, d;
 
-            /* rectangle fill routine draws horizontal line */
-            draw_rect_common(attr, &rect);
+    /* the reference point is the one with the lower x */
+    if (p2->x < p1->x) {
+        ref = p2;
+        other = p1;
+    } else {
+        ref = p1;
+        other = p2;
+    }
+
+    w2 = 2L * (other->x - ref->x);
+    edge->den = 2L * (edge->ybot - edge->ytop);
+    edge->down = (ref->y == edge->ytop);
+    d = edge->down ? (y - ref->y) : (ref->y - y);
+    d = d * w2 + (edge->den >> 1);
+
+    edge->x = ref->x + (WORD)(d / edge->den);
+    edge->err = d % edge->den;
+    edge->xstep = (WORD)(w2 / edge->den);
+    edge->errstep = w2 % edge->den;
+}
+
+
+/*
+ * edge_step - advance an edge's intersection to the next scan line
+ */
+static __inline__ void
+edge_step(EDGE *edge)
+{
+    if (edge->down) {
+        edge->x += edge->xstep;
+        edge->err += edge->errstep;
+        if (edge->err >= edge->den) {
+            edge->x++;
+            edge->err -= edge->den;
+        }
+    } else {
+        edge->x -= edge->xstep;
+        edge->err -= edge->errstep;
+        if (edge->err < 0) {
+            edge->x--;
+            edge->err += edge->den;
         }
     }
-    else {
-        /* Clipping is not in force.  Draw from point to point. */
-
-        /* This code has been modified from the version in the screen driver. */
-        /* The x-coordinates of each line segment are adjusted so that the */
-        /* border of the figure will not be drawn with the fill pattern.  If */
-        /* the starting point is greater than the ending point then nothing is */
-        /* done. */
-
-        /* loop through buffered points */
-        WORD * ptr = fill_buffer;
-        for (i = intersections / 2 - 1; i >= 0; i--) {
-            WORD x1, x2;
-            Rect rect;
+}
 
-            /* grab a pair of adjusted endpoints */
-            x1 = *ptr++ + 1 ;   /* word */
-            x2 = *ptr++ - 1 ;   /* word */
 
-            /* If starting point greater than ending point, nothing is done. */
-            /* is start still to left of end? */
-            if ( x1 <= x2 ) {
-                rect.x1 = x1;
-                rect.y1 = y;
-                rect.x2 = x2;
-                rect.y2 = y;
+/*
+ * edge_sort - sort a list of edges by their top scan line
+ *
+ * This is a merge sort, to keep things reasonable for large polygons.
+ */
+static EDGE *
+edge_sort(EDGE *list, int count)
+{
+    EDGE *left, *right, **tail, *head;
+    int i;
 
-                /* rectangle fill routine draws horizontal line */
-                draw_rect_common(attr, &rect);
-            }
+    if (count < 2)
+        return list;
+
+    /* split the list in two halves & sort them */
+    right = list;
+    for (i = count / 2 - 1; i > 0; i--)
+        right = right->next;
+    left = list;
+    list = right->next;
+    right->next = NULL;
+    left = edge_sort(left, count / 2);
+    right = edge_sort(list, count - count / 2);
+
+    /* merge them */
+    tail = &head;
+    while (left && right) {
+        if (right->ytop < left->ytop) {
+            *tail = right;
+            right = right->next;
+        } else {
+            *tail = left;
+            left = left->next;
         }
+        tail = &(*tail)->next;
     }
+    *tail = left ? left : right;
+
+    return head;
 }
 
 
 /*
- * polygon - draw a filled polygon
+ * active_insert - insert an edge into the active list, sorted by x
  */
+static void
+active_insert(EDGE **active, EDGE *edge)
+{
+    while (*active && ((*active)->x < edge->x))
+        active = &(*active)->next;
+    edge->next = *active;
+    *active = edge;
+}
 
-void
-polygon(Vwk * vwk, Point * ptsin, int count)
+
+/*
+ * poly_fill - fill the interior of a polygon
+ *
+ * The polygon consists of one or more contours: contour c ends just
+ * before point[ends[c]], and the next one (if any) starts there.  The
+ * contours need not be closed, i.e. the edge from the last point to the
+ * first one of each contour is implicit.  Overlapping contours are
+ * filled by the even-odd rule, so that holes can be drawn.  Only the
+ * scan lines between miny+1 and maxy (inclusive) are drawn.
+ */
+static void
+poly_fill(Vwk * vwk, const Point * point, const WORD * ends, int contours,
+          WORD miny, WORD maxy)
 {
-    WORD i, k, y;
-    WORD fill_maxy, fill_miny;
-    Point * point, * ptsget, * ptsput;
-    const VwkClip *clipper;
     VwkAttrib attr;
+    EDGE *edges, *table, *active, *edge, **link;
+    int c, i, n, first, count;
+    WORD y;
 
-    LSTLIN = FALSE;
+    count = ends[contours-1];
+
+    /* allocate the edge table if it won't fit in the static one */
+    edges = edge_buffer;
+    if (count > MAX_STATIC_EDGES) {
+        edges = (EDGE *)trap1(X_MALLOC, (LONG)count * sizeof(EDGE));
+        if (edges == NULL)
+            return;
+    }
+
+    /* build the edge table, ignoring horizontal edges */
+    for (i = 0, n = 0, c = 0, first = 0, link = &table; i < count; i++) {
+        const Point *p1, *p2;
+
+        while (i >= ends[c])
+            first = ends[c++];
+        p1 = &point[i];
+        p2 = &point[(i + 1 < ends[c]) ? i + 1 : first];
+
+        if (p1->y == p2->y)
+            continue;
+        edge = &edges[n++];
+        if (p1->y < p2->y) {
+            edge->ytop = p1->y;
+            edge->ybot = p2->y;
+        } else {
+            edge->ytop = p2->y;
+            edge->ybot = p1->y;
+        }
+        edge_init(edge, p1, p2, (edge->ytop > miny) ? edge->ytop : miny + 1);
+        *link = edge;
+        link = &edge->next;
+    }
+    *link = NULL;
+    table = edge_sort(table, n);
+
+    /* copy data needed by draw_rect_common */
+    Vwk2Attrib(vwk, &attr, vwk->fill_color);
+
+    for (y = miny + 1, active = NULL; y <= maxy; y++) {
+        /* drop the edges that end above this scan line, & step the rest */
+        for (link = &active; (edge = *link) != NULL; ) {
+            if (edge->ybot <= y) {
+                *link = edge->next;
+                continue;
+            }
+            edge_step(edge);
+            link = &edge->next;
+        }
+
+        /* keep the active list sorted (it is nearly sorted already) */
+        for (link = &active; (edge = *link) != NULL && edge->next; ) {
+            EDGE *next = edge->next;
+            if (next->x < edge->x) {
+                edge->next = next->next;
+                active_insert(&active, next);
+            } else
+                link = &edge->next;
+        }
+
+        /* add the edges that start at or above this scan line */
+        while (table && (table->ytop <= y)) {
+            edge = table;
+            table = table->next;
+            if (edge->ybot > y)
+                active_insert(&active, edge);
+        }
+
+        if (!active && !table)
+            break;
+
+        /* draw from intersection to intersection */
+        for (edge = active; edge && edge->next; edge = edge->next->next)
+            fill_span(&attr, VDI_CLIP(vwk), edge->x, edge->next->x, y);
+    }
+
+    if (edges != edge_buffer)
+        trap1(X_MFREE, edges);
+}
+
+
+/*
+ * poly_yrange - find the scan lines to fill for a polygon
+ *
+ * returns FALSE if the polygon is entirely clipped
+ */
+static BOOL
+poly_yrange(Vwk * vwk, const Point * point, int count, WORD * miny, WORD * maxy)
+{
+    WORD i, k;
+    WORD fill_maxy, fill_miny;
+    const VwkClip *clipper;
 
     /* find out the total min and max y values */
-    point = ptsin;
     fill_maxy = fill_miny = point->y;
     for (i = count - 1; i > 0; i--) {
         point++;
@@ -565,7 +794,6 @@ polygon(Vwk * vwk, Point * ptsin, int count)
                 fill_maxy = k;
     }
 
-    /* cast structure needed by clc_flit */
     clipper = VDI_CLIP(vwk);
     if (vwk->clip) {
         if (fill_miny < clipper->ymn_clip) {
@@ -575,29 +803,44 @@ polygon(Vwk * vwk, Point * ptsin, int count)
                 if (fill_miny < 1)
                     fill_miny = 1;
             } else
-                return;         /* polygon entirely before clip */
+                return FALSE;   /* polygon entirely before clip */
         }
         if (fill_maxy > clipper->ymx_clip) {
             if (fill_miny <= clipper->ymx_clip)  /* polygon ends after clip */
                 fill_maxy = clipper->ymx_clip;   /* polygon partial overlap */
             else
-                return;         /* polygon entirely after clip */
+                return FALSE;   /* polygon entirely after clip */
         }
     }
 
-    /* close the polygon, connect last and first point */
-    ptsget = ptsin;
-    ptsput = ptsin + count;
-    ptsput->x = ptsget->x;
-    ptsput->y = ptsget->y;
+    *miny = fill_miny;
+    *maxy = fill_maxy;
+
+    return TRUE;
+}
 
-    /* copy data needed by clc_flit -> draw_rect_common */
-    Vwk2Attrib(vwk, &attr, vwk->fill_color);
+
+/*
+ * polygon - draw a filled polygon
+ */
+
+void
+polygon(Vwk * vwk, Point * ptsin, int count)
+{
+    WORD fill_maxy, fill_miny, ends;
+
+    LSTLIN = FALSE;
+
+    if (!poly_yrange(vwk, ptsin, count, &fill_miny, &fill_maxy))
+        return;
+
+    /* close the polygon, connect last and first point */
+    ptsin[count] = ptsin[0];
 
     /* really draw it */
-    for (y = fill_maxy; y > fill_miny; y--) {
-        clc_flit(&attr, clipper, ptsin, y, count);
-    }
+    ends = count;
+    poly_fill(vwk, ptsin, &ends, 1, fill_miny, fill_maxy);
+
     if (vwk->fill_per == TRUE) {
         LN_MASK = 0xffff;
         polyline(vwk, ptsin, count+1, vwk->fill_color);
@@ -606,6 +849,46 @@ polygon(Vwk * vwk, Point * ptsin, int count)
 
 
 
+/*
+ * polygon_contours - draw a filled polygon made of one or more contours
+ *
+ * Unlike polygon(), this needs no room to close the contours, and does
+ * not modify the points.  See poly_fill() for the meaning of ends[].
+ */
+
+void
+polygon_contours(Vwk * vwk, const Point * point, const WORD * ends, int contours)
+{
+    WORD fill_maxy, fill_miny;
+    int c, first;
+
+    LSTLIN = FALSE;
+
+    if (contours < 1)
+        return;
+
+    if (!poly_yrange(vwk, point, ends[contours-1], &fill_miny, &fill_maxy))
+        return;
+
+    poly_fill(vwk, point, ends, contours, fill_miny, fill_maxy);
+
+    if (vwk->fill_per == TRUE) {
+        LN_MASK = 0xffff;
+        for (c = 0, first = 0; c < contours; first = ends[c++]) {
+            Point closing[2];
+
+            if (ends[c] - first < 2)
+                continue;
+            polyline(vwk, (Point *)&point[first], ends[c] - first, vwk->fill_color);
+            closing[0] = point[ends[c]-1];
+            closing[1] = point[first];
+            polyline(vwk, closing, 2, vwk->fill_color);
+        }
+    }
+}
+
+
+
 /*
  * vdi_v_fillarea - Fill an area
  */
@@ -614,15 +897,26 @@ void vdi_v_fillarea(Vwk * vwk)
     Point * point = (Point*)PTSIN;
     int count = CONTRL[1];
 
-#if 0
-#if HAVE_BEZIER
+#if CONF_WITH_VDI_BEZIER
     /* check, if we want to draw a filled bezier curve */
-    if (CONTRL[5] == 13 && vwk->bez_qual )
+    if (CONTRL[5] == 13)
         v_bez_fill(vwk, point, count);
     else
 #endif
-#endif
+    {
+        /*
+         * the PTSIN array passed to us holds at most MAX_PTSIN points;
+         * larger polygons are filled directly from the caller's array
+         */
+        if ((count == MAX_PTSIN) && (user_ptsin_count > MAX_PTSIN)) {
+            WORD ends = user_ptsin_count;
+
+            polygon_contours(vwk, user_ptsin, &ends, 1);
+            return;
+        }
+
         polygon(vwk, point, count);
+    }
 }
 
 
@@ -725,6 +1019,11 @@ pixelread(const WORD x, const WORD y)
     UWORD *addr;
     UWORD mask;
 
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE)
+        return *get_start_addr16(x, y); /* the pixel is the colour */
+#endif
+
     /* convert x,y to start address and bit mask */
     addr = get_start_addr(x, y);
     addr += v_planes;                   /* start at highest-order bit_plane */
@@ -733,6 +1032,35 @@ pixelread(const WORD x, const WORD y)
     return get_color(mask, addr);       /* return the composed color value */
 }
 
+#if CONF_WITH_VDI_16BIT
+/*
+ * end_pts_tc - find the endpoints of a section of solid color
+ *
+ * Truecolor version of the searches in end_pts(): returns the colour
+ * at x,y and sets the left and right ends of the run of that colour
+ */
+static UWORD
+end_pts_tc(const VwkClip * clip, WORD x, WORD y, WORD *xleftout, WORD *xrightout)
+{
+    UWORD *start = get_start_addr16(x, y);
+    UWORD *addr;
+    UWORD color = *start;
+    WORD xs;
+
+    for (xs = x, addr = start; xs < clip->xmx_clip; xs++)
+        if (*++addr != color)
+            break;
+    *xrightout = xs;
+
+    for (xs = x, addr = start; xs > clip->xmn_clip; xs--)
+        if (*--addr != color)
+            break;
+    *xleftout = xs;
+
+    return color;
+}
+#endif
+
 static UWORD
 search_to_right (const VwkClip * clip, WORD x, UWORD mask, const UWORD search_col, UWORD * addr)
 {
@@ -807,6 +1135,15 @@ end_pts(const VwkClip * clip, WORD x, WORD y, WORD *xleftout, WORD *xrightout,
     if ( y < clip->ymn_clip || y > clip->ymx_clip)
         return 0;
 
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE) {
+        color = end_pts_tc(clip, x, y, xleftout, xrightout);
+        if ( color != search_color )
+            return seed_type ^ 1;
+        return seed_type ^ 0;
+    }
+#endif
+
     /* convert x,y to start address and bit mask */
     addr = get_start_addr(x, y);
     addr += v_planes;                   /* start at highest-order bit_plane */
@@ -865,6 +1202,11 @@ void contourfill(const VwkAttrib * attr, const VwkClip *clip)
         if (search_color >= DEV_TAB[13])
             return;
 
+#if CONF_WITH_VDI_16BIT
+        if (TRUECOLOR_MODE)
+            search_color = TC_COL[MAP_COL[search_color]];
+        else
+#endif
         /*
          * We mandate that white is all bits on.  Since this yields 15
          * in rom, we must limit it to how many planes there really are.
@@ -1031,6 +1373,16 @@ void vdi_v_get_pixel(Vwk * vwk)
     /* Get the requested pixel */
     pel = (WORD)pixelread(x,y);
 
+#if CONF_WITH_VDI_16BIT
+    /* return the pixel value as a LONG: there is no matching pen */
+    if (TRUECOLOR_MODE) {
+        INTOUT[0] = 0;
+        INTOUT[1] = pel;
+        CONTRL[4] = 2;
+        return;
+    }
+#endif
+
     int_out = INTOUT;
     *int_out++ = pel;
 
@@ -1075,6 +1427,15 @@ put_pix(void)
     const WORD x = PTSIN[0];
     const WORD y = PTSIN[1];
 
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE) {
+        addr = get_start_addr16(x, y);
+        if (addr >= (UWORD*)v_bas_ad && addr < get_start_addr16(0, v_vt_rez))
+            *addr = INTIN[0];   /* the colour is the pixel value */
+        return;
+    }
+#endif
+
     /* convert x,y to start address */
     addr = get_start_addr(x, y);
     /* co-ordinates can wrap, but cannot write outside screen,
@@ -1084,6 +1445,7 @@ put_pix(void)
         return;
     }
     color = INTIN[0];           /* device dependent encoded color bits */
+
     mask = 0x8000 >> (x&0xf);   /* initial bit position in WORD */
 
     for (plane = v_planes-1; plane >= 0; plane-- ) {
@@ -265,7 +265,7 @@ void vdi_v_gdp(Vwk * vwk)
     case 10:         /* GDP Justified Text */
         d_justified(vwk);
         break;
-#if HAVE_BEZIER
+#if CONF_WITH_VDI_BEZIER
     case 13:         /* GDP Bezier */
         v_bez_control(vwk);     /* check, if we can do bezier curves */
         break;
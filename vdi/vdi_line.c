@@ -160,178 +160,242 @@ void vdi_vql_attributes(Vwk * vwk)
 
 
 /*
- * draw_rect_common - draw one or more horizontal lines
+ * span fill kernels
  *
- * This code does the following:
- *  1. Figures out the sizes of the left, centre, and right sections.  If
- *     the line lies entirely within a WORD, then the centre and right
- *     section sizes will be zero; if the line spans two WORDs, then the
- *     centre size will be zero.
- *  2. The outermost control is via a switch() statement depending on
- *     the current drawing mode.
- *  3. Within each case, the outermost loop processes one scan line per
- *     iteration.
- *  4. Within this loop, the video planes are processed in sequence.
- *  5. Within this, the left section is processed, then the centre and/or
- *     right sections (if they exist).
+ * draw_rect_common() hands the actual drawing over to one of these.
+ * There is one kernel per (number of planes, kind of operation), so
+ * that the compiler can unroll the plane loops completely and keep the
+ * per-plane values in registers; the kernel is chosen once per call.
+ *
+ * For each scan line, the kernel first works out, for every plane, the
+ * pattern bits to be modified ('keep') and the new values of those bits
+ * ('val').  Then it processes the left section, the centre section and
+ * the right section (if they exist).  The left & right sections are
+ * done a WORD at a time, masked.  In the centre section, whole groups
+ * of interleaved plane WORDs are written as LONGs.
  *
- * NOTE: this code seems rather longwinded and repetitive.  In fact it
- * can be shortened considerably and made much more elegant.  Doing so
- * however will wreck its performance, and this in turn will affect the
- * performance of many VDI calls.  This is not particularly noticeable
- * on an accelerated system, but is disastrous when running on a plain
- * 8MHz ST or 16MHz Falcon.  You are strongly advised not to change this
+ * NOTE: this code is rather longwinded and repetitive, and deliberately
+ * so.  It underlies rectangle, span and polygon fills, and therefore
+ * many VDI & AES calls.  This is not particularly noticeable on an
+ * accelerated system, but is disastrous when running on a plain 8MHz
+ * ST or 16MHz Falcon.  You are strongly advised not to change this
  * without a lot of careful thought & performance testing!
  */
-void draw_rect_common(const VwkAttrib *attr, const Rect *rect)
-{
-    UWORD leftmask, rightmask, *addr;
-    const UWORD patmsk = attr->patmsk;
-    const int yinc = (v_lin_wr>>1) - v_planes;
-    int centre, y;
+#define SPAN_REPLACE    0       /* replace mode */
+#define SPAN_MERGE      1       /* transparent & reverse transparent modes */
+#define SPAN_XOR        2       /* xor mode */
+
+typedef struct {
+    UWORD leftmask;             /* mask for left section */
+    UWORD rightmask;            /* mask for right section (0 if none) */
+    int centre;                 /* number of WORDs (per plane) in centre */
+    UWORD patxor;               /* 0xffff to invert the pattern (erase mode) */
+} Span;
+
+#if CONF_WITH_SPAN_KERNELS
+typedef void (*SPAN_KERNEL)(const VwkAttrib *attr, const Rect *rect, UWORD *addr, const Span *span);
+#endif
 
-    leftmask = 0xffff >> (rect->x1 & 0x0f);
-    rightmask = 0xffff << (15 - (rect->x2 & 0x0f));
 
-    centre = (rect->x2 & 0xfff0) - (rect->x1 & 0xfff0) - 16;
-    if (centre < 0) {                   /* i.e. all bits within 1 WORD */
-        leftmask &= rightmask;          /* so combine masks */
-        centre = rightmask = 0;
-    }
-    centre >>= 4;                       /* convert to WORD count */
+/*
+ * span_word - apply the values for one scan line to a WORD of one plane
+ */
+static __inline__ UWORD span_word(UWORD data, UWORD keep, UWORD val, UWORD mask, const int op)
+{
+    if (op == SPAN_XOR)
+        return data ^ (keep & mask);
 
-    addr = get_start_addr(rect->x1,rect->y1);   /* init address counter */
+    return (data & ~(keep & mask)) | (val & mask);
+}
 
-    switch(attr->wrt_mode) {
-    case 3:                 /* erase (reverse transparent) mode */
-        for (y = rect->y1; y <= rect->y2; y++, addr += yinc) {
-            int patind = patmsk & y;   /* starting pattern */
-            int plane;
-            UWORD color;
 
-            for (plane = 0, color = attr->color; plane < v_planes; plane++, color>>=1, addr++) {
-                UWORD *work = addr;
-                UWORD pattern = ~attr->patptr[patind];
-                int n;
+/*
+ * span_fill - fill a span on each line of a rectangle
+ *
+ * This must be inlined, so that the planes & op constants of each kernel
+ * below are propagated into it.
+ */
+static __inline__ __attribute__((always_inline))
+void span_fill(const VwkAttrib *attr, const Rect *rect, UWORD *addr,
+               const Span *span, const int planes, const int op)
+{
+    const UWORD patmsk = attr->patmsk;
+    const int centre = span->centre;
+    const int yinc = v_lin_wr >> 1;
+    UWORD keep[8], val[8];
+    ULONG lkeep[4], lval[4];
+    int y;
+
+    for (y = rect->y1; y <= rect->y2; y++, addr += yinc) {
+        UWORD *work = addr;
+        int patind = patmsk & y;    /* starting pattern */
+        int plane, n;
+        UWORD color = attr->color;
 
-                if (color & 0x0001) {
-                    *work |= pattern & leftmask;    /* left section */
-                    work += v_planes;
-                    for (n = 0; n < centre; n++) {  /* centre section */
-                        *work |= pattern;
-                        work += v_planes;
-                    }
-                    if (rightmask) {                /* right section */
-                        *work |= pattern & rightmask;
-                    }
-                } else {
-                    *work &= ~(pattern & leftmask); /* left section */
-                    work += v_planes;
-                    for (n = 0; n < centre; n++) {  /* centre section */
-                        *work &= ~pattern;
-                        work += v_planes;
-                    }
-                    if (rightmask) {                /* right section */
-                        *work &= ~(pattern & rightmask);
-                    }
-                }
-                if (attr->multifill)
-                    patind += 16;                   /* advance pattern data */
-            }
+        /*
+         * work out the values for this line, for all planes
+         */
+        for (plane = 0; plane < planes; plane++, color >>= 1) {
+            UWORD pattern = attr->patptr[patind] ^ span->patxor;
+
+            if (op == SPAN_REPLACE)
+                keep[plane] = 0xffff;
+            else
+                keep[plane] = pattern;
+            val[plane] = (color & 0x0001) ? pattern : 0x0000;
+            if (attr->multifill)
+                patind += 16;           /* advance pattern data */
         }
-        break;
-    case 2:                 /* xor mode */
-        for (y = rect->y1; y <= rect->y2; y++, addr += yinc) {
-            int patind = patmsk & y;   /* starting pattern */
-            int plane;
-            UWORD color;
-
-            for (plane = 0, color = attr->color; plane < v_planes; plane++, color>>=1, addr++) {
-                UWORD *work = addr;
-                UWORD pattern = attr->patptr[patind];
-                int n;
-
-                *work ^= pattern & leftmask;        /* left section */
-                work += v_planes;
-                for (n = 0; n < centre; n++) {      /* centre section */
-                    *work ^= pattern;
-                    work += v_planes;
-                }
-                if (rightmask) {                    /* right section */
-                    *work ^= pattern & rightmask;
-                }
-                if (attr->multifill)
-                    patind += 16;                   /* advance pattern data */
+        if (planes == 1) {
+            lkeep[0] = ((ULONG)keep[0] << 16) | keep[0];
+            lval[0] = ((ULONG)val[0] << 16) | val[0];
+        } else {
+            for (plane = 0; plane < planes; plane += 2) {
+                lkeep[plane>>1] = ((ULONG)keep[plane] << 16) | keep[plane+1];
+                lval[plane>>1] = ((ULONG)val[plane] << 16) | val[plane+1];
             }
         }
-        break;
-    case 1:                 /* transparent mode */
-        for (y = rect->y1; y <= rect->y2; y++, addr += yinc) {
-            int patind = patmsk & y;   /* starting pattern */
-            int plane;
-            UWORD color;
 
-            for (plane = 0, color = attr->color; plane < v_planes; plane++, color>>=1, addr++) {
-                UWORD *work = addr;
-                UWORD pattern = attr->patptr[patind];
-                int n;
-
-                if (color & 0x0001) {
-                    *work |= pattern & leftmask;    /* left section */
-                    work += v_planes;
-                    for (n = 0; n < centre; n++) {  /* centre section */
-                        *work |= pattern;
-                        work += v_planes;
-                    }
-                    if (rightmask) {                /* right section */
-                        *work |= pattern & rightmask;
-                    }
-                } else {
-                    *work &= ~(pattern & leftmask); /* left section */
-                    work += v_planes;
-                    for (n = 0; n < centre; n++) {  /* centre section */
-                        *work &= ~pattern;
-                        work += v_planes;
-                    }
-                    if (rightmask) {                /* right section */
-                        *work &= ~(pattern & rightmask);
-                    }
+        /* left section */
+        for (plane = 0; plane < planes; plane++, work++)
+            *work = span_word(*work, keep[plane], val[plane], span->leftmask, op);
+
+        /* centre section */
+        if (centre) {
+            ULONG *lwork = (ULONG *)work;
+
+            if (planes == 1) {
+                for (n = centre >> 1; n > 0; n--, lwork++) {
+                    if (op == SPAN_REPLACE)
+                        *lwork = lval[0];
+                    else if (op == SPAN_XOR)
+                        *lwork ^= lkeep[0];
+                    else
+                        *lwork = (*lwork & ~lkeep[0]) | lval[0];
                 }
-                if (attr->multifill)
-                    patind += 16;                   /* advance pattern data */
-            }
-        }
-        break;
-    default:                /* replace mode */
-        for (y = rect->y1; y <= rect->y2; y++, addr += yinc) {
-            int patind = patmsk & y;   /* starting pattern */
-            int plane;
-            UWORD color;
-
-            for (plane = 0, color = attr->color; plane < v_planes; plane++, color>>=1, addr++) {
-                UWORD data, *work = addr;
-                UWORD pattern = (color & 0x0001) ? attr->patptr[patind] : 0x0000;
-                int n;
-
-                data = *work & ~leftmask;           /* left section */
-                data |= pattern & leftmask;
-                *work = data;
-                work += v_planes;
-                for (n = 0; n < centre; n++) {      /* centre section */
-                    *work = pattern;
-                    work += v_planes;
+                work = (UWORD *)lwork;
+                if (centre & 1) {
+                    *work = span_word(*work, keep[0], val[0], 0xffff, op);
+                    work++;
                 }
-                if (rightmask) {                    /* right section */
-                    data = *work & ~rightmask;
-                    data |= pattern & rightmask;
-                    *work = data;
+            } else {
+                for (n = centre; n > 0; n--) {
+                    for (plane = 0; plane < (planes >> 1); plane++, lwork++) {
+                        if (op == SPAN_REPLACE)
+                            *lwork = lval[plane];
+                        else if (op == SPAN_XOR)
+                            *lwork ^= lkeep[plane];
+                        else
+                            *lwork = (*lwork & ~lkeep[plane]) | lval[plane];
+                    }
                 }
-                if (attr->multifill)
-                    patind += 16;                   /* advance pattern data */
+                work = (UWORD *)lwork;
             }
         }
-        break;
+
+        /* right section */
+        if (span->rightmask) {
+            for (plane = 0; plane < planes; plane++, work++)
+                *work = span_word(*work, keep[plane], val[plane], span->rightmask, op);
+        }
+    }
+}
+
+
+#if CONF_WITH_SPAN_KERNELS
+/*
+ * the kernels themselves: span_fill() with constant planes & operation
+ */
+#define DEFINE_SPAN_KERNEL(planes, op, name) \
+static void name(const VwkAttrib *attr, const Rect *rect, UWORD *addr, const Span *span) \
+{ \
+    span_fill(attr, rect, addr, span, planes, op); \
+}
+
+DEFINE_SPAN_KERNEL(1, SPAN_REPLACE, span_replace1)
+DEFINE_SPAN_KERNEL(1, SPAN_MERGE, span_merge1)
+DEFINE_SPAN_KERNEL(1, SPAN_XOR, span_xor1)
+DEFINE_SPAN_KERNEL(2, SPAN_REPLACE, span_replace2)
+DEFINE_SPAN_KERNEL(2, SPAN_MERGE, span_merge2)
+DEFINE_SPAN_KERNEL(2, SPAN_XOR, span_xor2)
+DEFINE_SPAN_KERNEL(4, SPAN_REPLACE, span_replace4)
+DEFINE_SPAN_KERNEL(4, SPAN_MERGE, span_merge4)
+DEFINE_SPAN_KERNEL(4, SPAN_XOR, span_xor4)
+#if CONF_WITH_VIDEL || CONF_WITH_TT_SHIFTER
+DEFINE_SPAN_KERNEL(8, SPAN_REPLACE, span_replace8)
+DEFINE_SPAN_KERNEL(8, SPAN_MERGE, span_merge8)
+DEFINE_SPAN_KERNEL(8, SPAN_XOR, span_xor8)
+#endif
+
+/* indexed by [log2(v_planes)][write mode] */
+static const SPAN_KERNEL span_kernels[][4] = {
+    { span_replace1, span_merge1, span_xor1, span_merge1 },
+    { span_replace2, span_merge2, span_xor2, span_merge2 },
+    { span_replace4, span_merge4, span_xor4, span_merge4 },
+#if CONF_WITH_VIDEL || CONF_WITH_TT_SHIFTER
+    { span_replace8, span_merge8, span_xor8, span_merge8 },
+#endif
+};
+#endif /* CONF_WITH_SPAN_KERNELS */
+
+
+/*
+ * draw_rect_common - draw one or more horizontal lines
+ *
+ * This code does the following:
+ *  1. Figures out the sizes of the left, centre, and right sections.  If
+ *     the line lies entirely within a WORD, then the centre and right
+ *     section sizes will be zero; if the line spans two WORDs, then the
+ *     centre size will be zero.
+ *  2. Selects the span fill kernel for the current number of planes
+ *     and drawing mode, which does the rest (see above).  Without
+ *     CONF_WITH_SPAN_KERNELS, a single generic copy of span_fill()
+ *     is used instead.
+ */
+void draw_rect_common(const VwkAttrib *attr, const Rect *rect)
+{
+    UWORD *addr;
+    Span span;
+    WORD mode;
+    int centre;
+#if CONF_WITH_SPAN_KERNELS
+    int shift;
+#endif
+
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE) {
+        draw_rect_tc(attr, rect);
+        return;
+    }
+#endif
+
+    span.leftmask = 0xffff >> (rect->x1 & 0x0f);
+    span.rightmask = 0xffff << (15 - (rect->x2 & 0x0f));
+
+    centre = (rect->x2 & 0xfff0) - (rect->x1 & 0xfff0) - 16;
+    if (centre < 0) {                       /* i.e. all bits within 1 WORD */
+        span.leftmask &= span.rightmask;    /* so combine masks */
+        centre = span.rightmask = 0;
     }
+    span.centre = centre >> 4;              /* convert to WORD count */
+
+    mode = attr->wrt_mode;
+    if ((mode < 0) || (mode > 3))
+        mode = 0;                           /* replace mode */
+    span.patxor = (mode == 3) ? 0xffff : 0x0000;
+
+    addr = get_start_addr(rect->x1,rect->y1);   /* init address counter */
+
+#if CONF_WITH_SPAN_KERNELS
+    /* v_planes is 1, 2, 4 or 8 */
+    for (shift = 0; (1 << shift) < v_planes; shift++)
+        ;
+
+    span_kernels[shift][mode](attr, rect, addr, &span);
+#else
+    span_fill(attr, rect, addr, &span, v_planes,
+              (mode == 0) ? SPAN_REPLACE : (mode == 2) ? SPAN_XOR : SPAN_MERGE);
+#endif
 }
 
 
@@ -527,9 +591,9 @@ void vdi_v_pline(Vwk * vwk)
 
     set_LN_MASK(vwk);
 
-#if HAVE_BEZIER
+#if CONF_WITH_VDI_BEZIER
     /* check, if we want to draw a bezier curve */
-    if (CONTRL[5] == 13 && vwk->bez_qual )        /* FIXME: bez_qual ok?? */
+    if (CONTRL[5] == 13)
         v_bez(vwk, point, count);
     else
 #endif
@@ -1170,6 +1234,13 @@ void abline (const Line * line, WORD wrt_mode, UWORD color)
     int plane;
     UWORD linemask = LN_MASK;   /* linestyle bits */
 
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE) {
+        abline_tc(line, wrt_mode, color);
+        return;
+    }
+#endif
+
     /* Make x axis always goind up */
     if (line->x2 < line->x1) {
         /* if delta x < 0 then draw from point 2 to 1 */
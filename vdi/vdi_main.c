@@ -108,6 +108,39 @@ static void(* const jmptb2[])(Vwk *) = {
 #define JMPTB2_ENTRIES  ARRAY_SIZE(jmptb2)
 
 
+#if CONF_WITH_VDI_EXTENSIONS
+/*
+ * draws_on_bitmap - TRUE if the function draws, or depends on the size of
+ * the drawing area, and therefore uses the bitmap of a bitmap workstation
+ *
+ * The others, notably the mouse and escape functions, always work on the
+ * screen.
+ */
+static BOOL draws_on_bitmap(WORD opcode)
+{
+    switch(opcode) {
+    case 3:         /* v_clrwk */
+    case 6:         /* v_pline */
+    case 7:         /* v_pmarker */
+    case 8:         /* v_gtext */
+    case 9:         /* v_fillarea */
+    case 11:        /* v_gdp */
+    case 102:       /* vq_extnd */
+    case 103:       /* v_contourfill */
+    case 105:       /* v_get_pixel */
+    case 109:       /* vro_cpyfm */
+    case 110:       /* vr_trnfm */
+    case 114:       /* vr_recfl */
+    case 121:       /* vrt_cpyfm */
+    case 129:       /* vs_clip */
+        return TRUE;
+    }
+
+    return FALSE;
+}
+#endif
+
+
 /*
  * screen - Screen driver entry point
  */
@@ -116,6 +149,9 @@ void screen(void)
 {
     WORD opcode, handle;
     Vwk *vwk = NULL;
+#if CONF_WITH_VDI_EXTENSIONS
+    BOOL bitmap = FALSE;
+#endif
 
     /* get workstation handle */
     handle = CONTRL[6];
@@ -137,6 +173,13 @@ void screen(void)
         /* This copying is done for assembler routines */
         if (vwk->fill_style != 4)       /* multifill just for user */
             vwk->multifill = 0;
+
+#if CONF_WITH_VDI_EXTENSIONS
+        /* switch to the bitmap of an off-screen workstation */
+        bitmap = vwk->bm_addr && draws_on_bitmap(opcode);
+        if (bitmap)
+            bm_enter(vwk);
+#endif
     }
 
     if (opcode >= 1 && opcode < 1+JMPTB1_ENTRIES) {
@@ -146,4 +189,9 @@ void screen(void)
     else if (opcode >= 100 && opcode < 100+JMPTB2_ENTRIES) {
         (*jmptb2[opcode - 100]) (vwk);
     }
+
+#if CONF_WITH_VDI_EXTENSIONS
+    if (bitmap)
+        bm_leave();
+#endif
 }
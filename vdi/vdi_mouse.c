@@ -643,6 +643,104 @@ static void vb_draw(void)
 
 
 
+#if CONF_WITH_VDI_16BIT
+/*
+ * cur_display_tc() - Truecolor version of cur_display()
+ *
+ * The save area always holds a block 16 pixels wide, shifted left or
+ * right if necessary to lie within the screen; it still covers all of
+ * the visible part of the cursor, and needs no special restore code.
+ * 16 rows of 16 pixels fit exactly in the MCS save area.
+ */
+static void cur_display_tc(Mcdb *sprite, MCS *mcs, WORD x, WORD y)
+{
+    WORD row, col, row_count, xsave;
+    UWORD *addr, *save, *src;
+    UWORD fgpixel, bgpixel;
+
+    x -= sprite->xhot;          /* x = left side of destination block */
+    y -= sprite->yhot;          /* y = top of destination block */
+
+    mcs->stat = 0x00;           /* reset status of save buffer */
+
+    /*
+     * clip y axis
+     */
+    src = sprite->mask;         /* MASK/FORM for cursor */
+    if (y < 0) {            /* clip top */
+        row_count = y + 16;
+        src -= y << 1;          /* point to first visible row of MASK/FORM */
+        y = 0;                  /* and reset starting row */
+    }
+    else if (y > (DEV_TAB[1]-15)) { /* clip bottom */
+        row_count = DEV_TAB[1] - y + 1;
+    }
+    else {
+        row_count = 16;
+    }
+
+    /* position of the saved block */
+    xsave = x;
+    if (xsave < 0)
+        xsave = 0;
+    else if (xsave > DEV_TAB[0]-15)
+        xsave = DEV_TAB[0] - 15;
+
+    addr = get_start_addr16(xsave, y);
+    save = (UWORD *)mcs->area;
+
+    mcs->len = row_count;       /* number of cursor rows */
+    mcs->addr = addr;           /* save area: origin of material */
+    mcs->stat |= MCS_VALID;     /* flag the buffer as being loaded */
+
+    bgpixel = TC_COL[sprite->bg_col];
+    fgpixel = TC_COL[sprite->fg_col];
+
+    for (row = row_count - 1; row >= 0; row--) {
+        UWORD *dst = addr;
+        UWORD bg = *src++;      /* mask */
+        UWORD fg = *src++;      /* form */
+
+        for (col = 0; col < 16; col++)
+            *save++ = dst[col];
+
+        for (col = 0; col < 16; col++) {
+            WORD xpos = x + col;
+            UWORD bit = 0x8000 >> col;
+
+            if ((xpos < 0) || (xpos > DEV_TAB[0]))
+                continue;
+            if (fg & bit)
+                dst[xpos - xsave] = fgpixel;
+            else if (bg & bit)
+                dst[xpos - xsave] = bgpixel;
+        }
+
+        addr += v_lin_wr >> 1;  /* next row of screen */
+    }
+}
+
+
+/*
+ * cur_replace_tc - Truecolor version of cur_replace()
+ */
+static void cur_replace_tc(MCS *mcs)
+{
+    WORD row, col;
+    UWORD *addr, *src;
+
+    addr = mcs->addr;
+    src = (UWORD *)mcs->area;
+
+    for (row = mcs->len - 1; row >= 0; row--) {
+        for (col = 0; col < 16; col++)
+            addr[col] = *src++;
+        addr += v_lin_wr >> 1;  /* next row of screen */
+    }
+}
+#endif
+
+
 /*
  * cur_display_clip()
  *
@@ -752,6 +850,13 @@ static void cur_display (Mcdb *sprite, MCS *mcs, WORD x, WORD y)
     UWORD shft, cdb_fg, cdb_bg;
     ULONG *save;
 
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE) {
+        cur_display_tc(sprite, mcs, x, y);
+        return;
+    }
+#endif
+
     x -= sprite->xhot;          /* x = left side of destination block */
     y -= sprite->yhot;          /* y = top of destination block */
 
@@ -905,6 +1010,13 @@ static void cur_replace (MCS *mcs)
         return;
     mcs->stat &= ~MCS_VALID;        /* yes but (like TOS) don't allow reuse */
 
+#if CONF_WITH_VDI_16BIT
+    if (TRUECOLOR_MODE) {
+        cur_replace_tc(mcs);
+        return;
+    }
+#endif
+
     addr = mcs->addr;
     src = (UWORD *)mcs->area;
 
@@ -15,6 +15,7 @@
 #include "vdi_defs.h"
 #include "../bios/lineavars.h"
 #include "../bios/tosvars.h"
+#include "string.h"
 #include "kprint.h"
 
 #ifdef __mcoldfire__
@@ -94,19 +95,6 @@ struct blit_frame {
     WORD src_wr;        /* +74 source form wrap (in bytes) */
 };
 
-/* Raster definitions */
-typedef struct {
-    void *fd_addr;
-    WORD fd_w;
-    WORD fd_h;
-    WORD fd_wdwidth;
-    WORD fd_stand;
-    WORD fd_nplanes;
-    WORD fd_r1;
-    WORD fd_r2;
-    WORD fd_r3;
-} MFDB;
-
 
 extern void linea_blit(struct blit_frame *info); /* called only from linea.S */
 extern void linea_raster(void); /* called only from linea.S */
@@ -118,6 +106,40 @@ static struct blit_frame vdi_info;
 /* which blit information to use, should be set before calling bit_blt() */
 struct blit_frame *blit_info;
 
+
+#if CONF_WITH_VDI_16BIT
+/*
+ * transpose_tc - convert between 16 plane words and 16 packed pixels
+ *
+ * In the standard format, a 16-plane form holds 16 separate planes; in
+ * the device-dependent (Truecolor) format each pixel is a single WORD.
+ * Once the plane words for a group of 16 pixels have been gathered
+ * together, converting between the two is a 16x16 bit transposition.
+ */
+static void transpose_tc(UWORD *words, BOOL to_pixels)
+{
+    UWORD temp[16];
+    WORD i, j;
+
+    for (i = 0; i < 16; i++) {
+        temp[i] = words[i];
+        words[i] = 0;
+    }
+
+    for (i = 0; i < 16; i++) {
+        for (j = 0; j < 16; j++) {
+            if (to_pixels) {        /* plane i, pixel j -> bit i of pixel j */
+                if (temp[i] & (0x8000 >> j))
+                    words[j] |= 1 << i;
+            } else {                /* pixel i, plane j -> bit i of plane j */
+                if (temp[i] & (1 << j))
+                    words[j] |= 0x8000 >> i;
+            }
+        }
+    }
+}
+#endif
+
 /*
  * vdi_vr_trnfm - transform screen bitmaps
  *
@@ -145,6 +167,25 @@ void vdi_vr_trnfm(Vwk * vwk)
     size = (LONG)src_mfdb->fd_h * src_mfdb->fd_wdwidth; /* size of plane in words */
     inplace = (src==dst);
 
+#if CONF_WITH_VDI_16BIT
+    /*
+     * A 16-plane device-dependent form holds packed pixels: convert each
+     * group of 16 pixels to plane words first, then let the code below
+     * move the words to their planes (in place, on a copy if necessary)
+     */
+    if ((planes == 16) && !src_mfdb->fd_stand)
+    {
+        if (!inplace)
+        {
+            memcpy(dst, src, size * planes * sizeof(WORD));
+            src = dst;
+            inplace = TRUE;
+        }
+        for (i = 0, work = dst; i < size; i++, work += planes)
+            transpose_tc((UWORD *)work, FALSE);
+    }
+#endif
+
     if (src_mfdb->fd_stand)     /* source is standard format */
     {
         dst_mfdb->fd_stand = 0;     /* force dest to device-dependent */
@@ -168,6 +209,11 @@ void vdi_vr_trnfm(Vwk * vwk)
                 work += outer;
             }
         }
+#if CONF_WITH_VDI_16BIT
+        if ((planes == 16) && !dst_mfdb->fd_stand)
+            for (i = 0, dst = dst_mfdb->fd_addr; i < size; i++, dst += planes)
+                transpose_tc((UWORD *)dst, TRUE);
+#endif
         return;
     }
 
@@ -198,6 +244,12 @@ void vdi_vr_trnfm(Vwk * vwk)
         }
         src = work;
     }
+
+#if CONF_WITH_VDI_16BIT
+    if ((planes == 16) && !dst_mfdb->fd_stand)
+        for (i = 0, dst = dst_mfdb->fd_addr; i < size; i++, dst += planes)
+            transpose_tc((UWORD *)dst, TRUE);
+#endif
 }
 
 
@@ -805,10 +857,153 @@ setup_info (struct raster_t *raster, struct blit_frame * info)
     info->s_nxpl = 2;           /* next plane offset (source) */
     info->d_nxpl = 2;           /* next plane offset (destination) */
 
+#if CONF_WITH_VDI_16BIT
+    if (info->plane_ct == 16)   /* packed pixels, see cpy_raster_tc() */
+        return FALSE;
+#endif
+
     /* only 8, 4, 2 and 1 planes are valid (destination) */
     return info->plane_ct & ~0x000f;
 }
 
+
+#if CONF_WITH_VDI_16BIT
+/*
+ * logic_op_tc - apply one of the 16 logic operations to a pixel
+ */
+static UWORD logic_op_tc(WORD op, UWORD s, UWORD d)
+{
+    switch(op) {
+    case BM_ALL_WHITE:  return 0x0000;
+    case BM_S_AND_D:    return s & d;
+    case BM_S_AND_NOTD: return s & ~d;
+    case BM_S_ONLY:     return s;
+    case BM_NOTS_AND_D: return ~s & d;
+    case BM_D_ONLY:     return d;
+    case BM_S_XOR_D:    return s ^ d;
+    case BM_S_OR_D:     return s | d;
+    case BM_NOT_SORD:   return ~(s | d);
+    case BM_NOT_SXORD:  return ~(s ^ d);
+    case BM_NOT_D:      return ~d;
+    case BM_S_OR_NOTD:  return s | ~d;
+    case BM_NOT_S:      return ~s;
+    case BM_NOTS_OR_D:  return ~s | d;
+    case BM_NOT_SANDD:  return ~(s & d);
+    }
+    return 0xffff;      /* BM_ALL_BLACK */
+}
+
+
+/*
+ * cpy_raster_tc - copy raster to a 16-plane (Truecolor) destination
+ *
+ * For the opaque copy, the source must also have 16 planes, and the
+ * logic operation is applied to whole pixels.  For the transparent
+ * copy, the source is monochrome and its bits select the colours
+ * from INTIN[1] & INTIN[2].  Patterns are not supported.
+ */
+static void
+cpy_raster_tc(struct raster_t *raster, struct blit_frame *info, WORD mode)
+{
+    UBYTE *src, *dst;
+    WORD s_nxln, d_nxln, x, y;
+
+    src = (UBYTE *)info->s_form + (LONG)info->s_ymin * info->s_nxln;
+    dst = (UBYTE *)info->d_form + (LONG)info->d_ymin * info->d_nxln;
+    dst += info->d_xmin * sizeof(UWORD);
+    s_nxln = info->s_nxln;
+    d_nxln = info->d_nxln;
+
+    if (!raster->transparent) {
+        const WORD rowbytes = info->b_wd * sizeof(UWORD);
+
+        /* planes of source and destination equal in number? */
+        if (info->s_nxwd != info->d_nxwd)
+            return;
+
+        src += info->s_xmin * sizeof(UWORD);
+
+        /* work upwards if the areas might overlap that way */
+        if ((info->s_form == info->d_form) && (info->d_ymin > info->s_ymin)) {
+            src += (LONG)(info->b_ht - 1) * s_nxln;
+            dst += (LONG)(info->b_ht - 1) * d_nxln;
+            s_nxln = -s_nxln;
+            d_nxln = -d_nxln;
+        }
+
+        for (y = info->b_ht; y > 0; y--, src += s_nxln, dst += d_nxln) {
+            UWORD *s = (UWORD *)src, *d = (UWORD *)dst;
+
+            if (mode == BM_S_ONLY) {
+                memmove(d, s, rowbytes);
+                continue;
+            }
+
+            /* within a line, go right to left if they overlap that way */
+            if ((d > s) && (d < s + info->b_wd)) {
+                for (x = info->b_wd - 1; x >= 0; x--)
+                    d[x] = logic_op_tc(mode, s[x], d[x]);
+            } else {
+                for (x = 0; x < info->b_wd; x++, s++, d++)
+                    *d = logic_op_tc(mode, *s, *d);
+            }
+        }
+    } else {
+        WORD fg_col, bg_col;
+        UWORD fgpixel, bgpixel;
+
+        /* is source area one plane? */
+        if (info->s_nxwd != 2)
+            return;             /* source must be mono plane */
+
+        fg_col = INTIN[1];
+        if ((fg_col >= DEV_TAB[13]) || (fg_col < 0))
+            fg_col = 1;
+        fgpixel = TC_COL[MAP_COL[fg_col]];
+
+        bg_col = INTIN[2];
+        if ((bg_col >= DEV_TAB[13]) || (bg_col < 0))
+            bg_col = 1;
+        bgpixel = TC_COL[MAP_COL[bg_col]];
+
+        if ((mode < MD_REPLACE) || (mode > MD_ERASE))
+            return;             /* unsupported mode */
+
+        for (y = info->b_ht; y > 0; y--, src += s_nxln, dst += d_nxln) {
+            const UWORD *s = (const UWORD *)src + (info->s_xmin >> 4);
+            UWORD bit = 0x8000 >> (info->s_xmin & 0x0f);
+            UWORD data = *s++;
+            UWORD *d = (UWORD *)dst;
+
+            for (x = info->b_wd; x > 0; x--, d++) {
+                switch(mode) {
+                case MD_REPLACE:
+                    *d = (data & bit) ? fgpixel : bgpixel;
+                    break;
+                case MD_TRANS:
+                    if (data & bit)
+                        *d = fgpixel;
+                    break;
+                case MD_XOR:
+                    if (data & bit)
+                        *d = ~*d;
+                    break;
+                default:        /* MD_ERASE */
+                    if (!(data & bit))
+                        *d = bgpixel;
+                    break;
+                }
+                bit >>= 1;
+                if (!bit) {
+                    bit = 0x8000;
+                    data = *s++;
+                }
+            }
+        }
+    }
+}
+#endif
+
 /* common functionality for vdi_vro_cpyfm, vdi_vrt_cpyfm, linea_raster */
 static void
 cpy_raster(struct raster_t *raster, struct blit_frame *info)
@@ -835,6 +1030,13 @@ cpy_raster(struct raster_t *raster, struct blit_frame *info)
     if (setup_info(raster, info))
         return;
 
+#if CONF_WITH_VDI_16BIT
+    if (info->plane_ct == 16) {
+        cpy_raster_tc(raster, info, mode);
+        return;
+    }
+#endif
+
     if (!raster->transparent) {
 
         /* COPY RASTER OPAQUE */
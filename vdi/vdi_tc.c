@@ -0,0 +1,719 @@
+/*
+ * vdi_tc.c - Drawing primitives for packed-pixel (Truecolor) screens
+ *
+ * Copyright (C) 2016 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+/*
+ * In the Falcon Truecolor modes, each pixel is one WORD in RGB565
+ * format, and consecutive pixels are in consecutive WORDs.  The planar
+ * drawing primitives in the rest of the VDI pass control to the
+ * routines in this file when TRUECOLOR_MODE is true.
+ *
+ * Colours arrive here as hardware register numbers (i.e. after the
+ * MAP_COL[] lookup), exactly as for the planar routines; they are
+ * converted to pixel values via the software palette TC_COL[].
+ */
+
+/* #define ENABLE_KDEBUG */
+
+#include "config.h"
+#include "portab.h"
+#include "vdi_defs.h"
+#include "../bios/lineavars.h"
+#include "../bios/tosvars.h"
+#include "kprint.h"
+
+#if CONF_WITH_VDI_16BIT
+
+/* linea-variables used for text blitting */
+extern WORD CLIP, XMN_CLIP, XMX_CLIP, YMN_CLIP, YMX_CLIP;
+extern UWORD DDA_INC;           /* the fraction to be added to the DDA */
+extern WORD T_SCLSTS;           /* 0 if scale down, 1 if enlarge */
+extern WORD MONO_STATUS;        /* True if current font monospaced */
+extern WORD STYLE;              /* Requested text special effects */
+extern WORD DOUBLE;             /* True if current font scaled */
+extern WORD CHUP;               /* Text baseline vector */
+extern WORD WRT_MODE;
+
+extern WORD XACC_DDA;           /* accumulator for x DDA        */
+extern WORD SOURCEX, SOURCEY;   /* upper left of character in font file */
+extern WORD DESTX, DESTY;       /* upper left of destination on screen  */
+extern UWORD DELX, DELY;        /* width and height of character    */
+extern const UWORD *FBASE;      /* pointer to font data         */
+extern WORD FWIDTH;             /* offset,segment and form width of font */
+extern WORD LITEMASK, SKEWMASK; /* special effects          */
+extern WORD WEIGHT;             /* special effects          */
+extern WORD R_OFF, L_OFF;       /* skew above and below baseline    */
+extern WORD TEXT_FG;
+
+extern WORD scrpt2;             /* Offset to large text buffer */
+extern WORD *scrtchp;           /* Pointer to text scratch buffer */
+
+/* style bits */
+#define F_THICKEN 1
+#define F_LIGHT 2
+#define F_SKEW  4
+#define F_OUTLINE 16
+
+
+/*
+ * get_start_addr16 - return the address of the pixel at x,y
+ */
+UWORD * get_start_addr16(const WORD x, const WORD y)
+{
+    UBYTE * addr;
+
+    addr = v_bas_ad;                    /* start of screen */
+    addr += (LONG)x * sizeof(UWORD);    /* add x coordinate part of addr */
+    addr += (LONG)y * v_lin_wr;         /* add y coordinate part of addr */
+
+    return (UWORD*)addr;
+}
+
+
+/*
+ * draw_rect_tc - draw one or more horizontal lines
+ *
+ * This is the Truecolor version of draw_rect_common().  The pattern
+ * bits are aligned to x&15, as they are in the planar version, so
+ * patterns line up the same way on screen.  Only the first plane of
+ * a multi-plane fill pattern is used.
+ */
+void draw_rect_tc(const VwkAttrib *attr, const Rect *rect)
+{
+    const UWORD patmsk = attr->patmsk;
+    const UWORD fg = TC_COL[attr->color];
+    const UWORD bg = TC_COL[0];
+    const WORD width = rect->x2 - rect->x1 + 1;
+    const WORD yinc = (v_lin_wr>>1) - width;
+    const UWORD startbit = 0x8000 >> (rect->x1 & 0x0f);
+    UWORD *addr;
+    WORD y, n;
+
+    if (width <= 0)
+        return;
+
+    addr = get_start_addr16(rect->x1, rect->y1);
+
+    switch(attr->wrt_mode) {
+    case 3:                 /* erase (reverse transparent) mode */
+        for (y = rect->y1; y <= rect->y2; y++, addr += yinc) {
+            UWORD pattern = ~attr->patptr[patmsk & y];
+            UWORD bit = startbit;
+
+            for (n = width; n > 0; n--, addr++) {
+                if (pattern & bit)
+                    *addr = fg;
+                bit = bit >> 1 | bit << 15;
+            }
+        }
+        break;
+    case 2:                 /* xor mode */
+        for (y = rect->y1; y <= rect->y2; y++, addr += yinc) {
+            UWORD pattern = attr->patptr[patmsk & y];
+            UWORD bit = startbit;
+
+            for (n = width; n > 0; n--, addr++) {
+                if (pattern & bit)
+                    *addr = ~*addr;
+                bit = bit >> 1 | bit << 15;
+            }
+        }
+        break;
+    case 1:                 /* transparent mode */
+        for (y = rect->y1; y <= rect->y2; y++, addr += yinc) {
+            UWORD pattern = attr->patptr[patmsk & y];
+            UWORD bit = startbit;
+
+            if (pattern == 0xffff) {            /* solid: just fill */
+                for (n = width; n > 0; n--)
+                    *addr++ = fg;
+                continue;
+            }
+            for (n = width; n > 0; n--, addr++) {
+                if (pattern & bit)
+                    *addr = fg;
+                bit = bit >> 1 | bit << 15;
+            }
+        }
+        break;
+    default:                /* replace mode */
+        for (y = rect->y1; y <= rect->y2; y++, addr += yinc) {
+            UWORD pattern = attr->patptr[patmsk & y];
+            UWORD bit = startbit;
+
+            if ((pattern == 0xffff) || (pattern == 0x0000)) {
+                UWORD pixel = pattern ? fg : bg;    /* solid: just fill */
+                for (n = width; n > 0; n--)
+                    *addr++ = pixel;
+                continue;
+            }
+            for (n = width; n > 0; n--) {
+                *addr++ = (pattern & bit) ? fg : bg;
+                bit = bit >> 1 | bit << 15;
+            }
+        }
+        break;
+    }
+}
+
+
+/*
+ * abline_tc - draw a line (general purpose)
+ *
+ * This is the Truecolor version of abline(); the line style handling
+ * and the Bresenham stepping are the same as for the planar version.
+ */
+void abline_tc(const Line * line, const WORD wrt_mode, UWORD color)
+{
+    UWORD *addr;
+    WORD x1,y1,x2,y2;           /* the coordinates */
+    WORD dx;                    /* width of rectangle around line */
+    WORD dy;                    /* height of rectangle around line */
+    WORD xinc, yinc;            /* in/decrease for each step */
+    WORD eps, e1, e2;           /* epsilon & increments */
+    WORD loopcnt;
+    UWORD fg, bg;
+    UWORD linemask = LN_MASK;   /* linestyle bits */
+
+    /* Make x axis always going up */
+    if (line->x2 < line->x1) {
+        x1 = line->x2;
+        y1 = line->y2;
+        x2 = line->x1;
+        y2 = line->y1;
+    } else {
+        x1 = line->x1;
+        y1 = line->y1;
+        x2 = line->x2;
+        y2 = line->y2;
+    }
+
+    /*
+     * optimize drawing of horizontal lines
+     */
+    if (y1 == y2) {
+        VwkAttrib attr;
+        Rect rect;
+        attr.clip = 0;
+        attr.multifill = 0;
+        attr.patmsk = 0;
+        attr.patptr = &linemask;
+        attr.wrt_mode = wrt_mode;
+        attr.color = color;
+        rect.x1 = x1;
+        rect.y1 = y1;
+        rect.x2 = x2;
+        rect.y2 = y2;
+        draw_rect_tc(&attr,&rect);
+        return;
+    }
+
+    fg = TC_COL[color];
+    bg = TC_COL[0];
+
+    dx = x2 - x1;
+    dy = y2 - y1;
+
+    /* calculate increase values for x and y to add to actual address */
+    if (dy < 0) {
+        dy = -dy;                       /* make dy absolute */
+        yinc = -(WORD)(v_lin_wr / 2);   /* sub one line of words */
+    } else {
+        yinc = v_lin_wr / 2;            /* add one line of words */
+    }
+
+    addr = get_start_addr16(x1, y1);    /* init address counter */
+
+    /*
+     * step along the major axis; xinc/yinc become the increments
+     * for the major/minor axis respectively
+     */
+    if (dx >= dy) {
+        xinc = 1;
+        loopcnt = dx;
+    } else {
+        xinc = yinc;
+        yinc = 1;
+        loopcnt = dy;
+        dy = dx;
+        dx = loopcnt;
+    }
+    e1 = 2*dy;
+    eps = -dx;
+    e2 = 2*dx;
+
+    for ( ; loopcnt >= 0; loopcnt--) {
+        linemask = linemask >> 15|linemask << 1;    /* get next bit of line style */
+
+        switch (wrt_mode) {
+        case 3:                 /* reverse transparent */
+            if (!(linemask&0x0001))
+                *addr = fg;
+            break;
+        case 2:                 /* xor */
+            if (linemask&0x0001)
+                *addr = ~*addr;
+            break;
+        case 1:                 /* or */
+            if (linemask&0x0001)
+                *addr = fg;
+            break;
+        default:                /* rep */
+            *addr = (linemask&0x0001) ? fg : bg;
+            break;
+        }
+
+        addr += xinc;
+        eps += e1;
+        if (eps >= 0 ) {
+            eps -= e2;
+            addr += yinc;
+        }
+    }
+    LN_MASK = linemask;
+}
+
+
+/*
+ * Text blitting
+ *
+ * A character goes through the same stages as in the planar text_blt()
+ * (see vdi_tblit.S), but the work is split differently:
+ *  1. thickening and skewing build a copy of the character in the
+ *     small scratch buffer
+ *  2. scaling builds a copy in the large scratch buffer
+ *  3. rotation, outlining, lightening and clipping are all done while
+ *     writing the pixels to the screen, so no further copy is needed
+ * A plain character at normal size skips the first two stages, and is
+ * written to the screen straight from the font data.
+ */
+typedef struct {
+    const UBYTE *base;          /* address of top line */
+    WORD wrap;                  /* bytes per line */
+    WORD xoff;                  /* bit offset of leftmost column */
+    WORD w, h;                  /* size in pixels */
+} GLYPH;
+
+
+/* return the value of the bit at x,y, or 0 if outside the glyph */
+static UWORD glyph_bit(const GLYPH *g, WORD x, WORD y)
+{
+    const UBYTE *p;
+
+    if ((x < 0) || (y < 0) || (x >= g->w) || (y >= g->h))
+        return 0;
+
+    x += g->xoff;
+    p = g->base + (LONG)y * g->wrap + (x >> 3);
+
+    return (*p >> (7 - (x & 7))) & 1;
+}
+
+
+/* set up an empty glyph in a scratch buffer */
+static void glyph_init(GLYPH *g, UBYTE *buf, WORD w, WORD h)
+{
+    LONG n;
+
+    g->base = buf;
+    g->wrap = ((w + 15) >> 4) * sizeof(UWORD);
+    g->xoff = 0;
+    g->w = w;
+    g->h = h;
+
+    for (n = (LONG)g->wrap * h; n > 0; n--)
+        *buf++ = 0;
+}
+
+
+/* set the bit at x,y in a glyph that was set up by glyph_init() */
+static void glyph_set(GLYPH *g, WORD x, WORD y)
+{
+    UBYTE *p = (UBYTE *)g->base + (LONG)y * g->wrap + (x >> 3);
+
+    *p |= 0x80 >> (x & 7);
+}
+
+
+/*
+ * glyph_effects - thicken and/or skew a glyph
+ *
+ * 'smear' is the number of extra columns to the right of each set
+ * pixel; for monospaced fonts, the smear is clipped to the cell.
+ * Skewing shifts each line to the right by a count that increases
+ * from the bottom line upwards, as controlled by SKEWMASK.
+ */
+static void glyph_effects(const GLYPH *src, GLYPH *dst, UBYTE *buf, WORD smear, WORD skew)
+{
+    WORD x, y, k, limit, offset;
+    UWORD skewmask = SKEWMASK;
+
+    limit = src->w + (MONO_STATUS ? 0 : smear);
+    glyph_init(dst, buf, limit + skew, src->h);
+
+    for (y = src->h - 1, offset = 0; y >= 0; y--) {
+        for (x = 0; x < src->w; x++) {
+            if (!glyph_bit(src, x, y))
+                continue;
+            for (k = 0; (k <= smear) && (x + k < limit); k++)
+                glyph_set(dst, x + k + offset, y);
+        }
+        if (skew) {
+            skewmask = skewmask << 1 | skewmask >> 15;
+            if ((skewmask & 0x0001) && (offset < skew))
+                offset++;
+        }
+    }
+}
+
+
+/*
+ * dda_step - advance a scaling DDA by one source pixel
+ *
+ * returns the number of destination pixels for that source pixel
+ */
+static WORD dda_step(UWORD *accu)
+{
+    UWORD old;
+
+    if (DDA_INC == 0xffff)              /* exact doubling */
+        return 2;
+
+    old = *accu;
+    *accu += DDA_INC;
+    if (*accu < old)                    /* carry */
+        return T_SCLSTS ? 2 : 1;
+
+    return T_SCLSTS ? 1 : 0;
+}
+
+
+/*
+ * glyph_scale - scale a glyph according to DDA_INC & T_SCLSTS
+ *
+ * The horizontal DDA carries on from character to character (via
+ * XACC_DDA), the vertical one restarts for every character, like
+ * act_siz().  Returns the scaled width of the first 'cols' columns,
+ * i.e. the distance to the next character.
+ */
+static WORD glyph_scale(const GLYPH *src, GLYPH *dst, UBYTE *buf, WORD cols)
+{
+    UWORD accu;
+    WORD x, y, w, h, dx, dy, nx, ny, i, j, advance;
+
+    /* calculate the scaled size */
+    for (x = w = advance = 0, accu = XACC_DDA; x < src->w; x++) {
+        w += dda_step(&accu);
+        if (x == cols - 1)
+            advance = w;
+    }
+    for (y = h = 0, accu = 0x7fff; y < src->h; y++)
+        h += dda_step(&accu);
+    if (src->h && !h)                   /* like act_siz() */
+        h = 1;
+
+    glyph_init(dst, buf, w, h);
+
+    for (y = dy = 0, accu = 0x7fff; y < src->h; y++, dy += ny) {
+        UWORD xaccu = XACC_DDA;
+
+        ny = dda_step(&accu);
+        if ((y == src->h - 1) && !dy && !ny)
+            ny = 1;                     /* keep at least one line */
+        for (x = dx = 0; x < src->w; x++, dx += nx) {
+            nx = dda_step(&xaccu);
+            if (!glyph_bit(src, x, y))
+                continue;
+            for (j = 0; j < ny; j++)
+                for (i = 0; i < nx; i++)
+                    glyph_set(dst, dx + i, dy + j);
+        }
+    }
+
+    /* update the horizontal DDA for the next character */
+    for (x = 0, accu = XACC_DDA; x < cols; x++)
+        dda_step(&accu);
+    XACC_DDA = accu;
+
+    return advance;
+}
+
+
+/*
+ * outline_bit - return the outlined value of the bit at x,y
+ *
+ * The outlined glyph is one pixel larger on every side than the
+ * original, and contains the pixels that border the original shape.
+ */
+static UWORD outline_bit(const GLYPH *g, WORD x, WORD y)
+{
+    WORD i, j;
+
+    x--;
+    y--;
+    if (glyph_bit(g, x, y))
+        return 0;
+
+    for (j = -1; j <= 1; j++)
+        for (i = -1; i <= 1; i++)
+            if (glyph_bit(g, x + i, y + j))
+                return 1;
+
+    return 0;
+}
+
+
+/*
+ * put_glyph - write a glyph to the screen at DESTX,DESTY
+ *
+ * applies rotation, outlining, lightening, clipping & writing mode
+ */
+static void put_glyph(const GLYPH *g)
+{
+    WORD gw, gh, sw, sh, x0, y0, xmin, ymin, xmax, ymax, x, y;
+    const BOOL outline = (STYLE & F_OUTLINE) ? TRUE : FALSE;
+    const UWORD fg = TC_COL[TEXT_FG];
+    const UWORD bg = TC_COL[0];
+    UWORD litemask = LITEMASK;
+
+    /* size of the glyph after outlining, then on screen after rotation */
+    gw = g->w + (outline ? 2 : 0);
+    gh = g->h + (outline ? 2 : 0);
+    if ((CHUP == 900) || (CHUP == 2700)) {
+        sw = gh;
+        sh = gw;
+    } else {
+        sw = gw;
+        sh = gh;
+    }
+
+    /* adjust destination, just like text_blt() */
+    x0 = DESTX;
+    y0 = DESTY;
+    if (CHUP == 900)
+        y0 -= g->w;                     /* move up by width */
+    else if (CHUP == 1800)
+        x0 -= g->w;                     /* move right by width */
+
+    /* clip to window or screen */
+    if (CLIP) {
+        xmin = XMN_CLIP;
+        ymin = YMN_CLIP;
+        xmax = XMX_CLIP;
+        ymax = YMX_CLIP;
+    } else {
+        xmin = ymin = 0;
+        xmax = xres;
+        ymax = yres;
+    }
+    if (xmin < x0)
+        xmin = x0;
+    if (ymin < y0)
+        ymin = y0;
+    if (xmax > x0 + sw - 1)
+        xmax = x0 + sw - 1;
+    if (ymax > y0 + sh - 1)
+        ymax = y0 + sh - 1;
+    if ((xmin > xmax) || (ymin > ymax))
+        return;
+
+    for (y = ymin; y <= ymax; y++) {
+        UWORD *addr = get_start_addr16(xmin, y);
+        WORD j = y - y0;
+
+        if (STYLE & F_LIGHT)
+            litemask = litemask >> 1 | litemask << 15;
+
+        for (x = xmin; x <= xmax; x++, addr++) {
+            WORD i = x - x0, u, v;
+            UWORD bit;
+
+            switch(CHUP) {
+            case 900:
+                u = gw - 1 - j;
+                v = i;
+                break;
+            case 1800:
+                u = gw - 1 - i;
+                v = gh - 1 - j;
+                break;
+            case 2700:
+                u = j;
+                v = gh - 1 - i;
+                break;
+            default:
+                u = i;
+                v = j;
+                break;
+            }
+
+            bit = outline ? outline_bit(g, u, v) : glyph_bit(g, u, v);
+            if ((STYLE & F_LIGHT) && !(litemask & (0x8000 >> (x & 0x0f))))
+                bit = 0;
+
+            switch(WRT_MODE) {
+            case 3:             /* reverse transparent */
+                if (!bit)
+                    *addr = fg;
+                break;
+            case 2:             /* xor */
+                if (bit)
+                    *addr = ~*addr;
+                break;
+            case 1:             /* transparent */
+                if (bit)
+                    *addr = fg;
+                break;
+            default:            /* replace */
+                *addr = bit ? fg : bg;
+                break;
+            }
+        }
+    }
+}
+
+
+/*
+ * put_plain - write an unrotated, unmodified glyph to the screen
+ *
+ * this is the common case, so it gets its own loop
+ */
+static void put_plain(const GLYPH *g)
+{
+    WORD xmin, ymin, xmax, ymax, x, y;
+    const UWORD fg = TC_COL[TEXT_FG];
+    const UWORD bg = TC_COL[0];
+    const UBYTE *line;
+
+    if (CLIP) {
+        xmin = XMN_CLIP;
+        ymin = YMN_CLIP;
+        xmax = XMX_CLIP;
+        ymax = YMX_CLIP;
+    } else {
+        xmin = ymin = 0;
+        xmax = xres;
+        ymax = yres;
+    }
+    if (xmin < DESTX)
+        xmin = DESTX;
+    if (ymin < DESTY)
+        ymin = DESTY;
+    if (xmax > DESTX + g->w - 1)
+        xmax = DESTX + g->w - 1;
+    if (ymax > DESTY + g->h - 1)
+        ymax = DESTY + g->h - 1;
+    if ((xmin > xmax) || (ymin > ymax))
+        return;
+
+    line = g->base + (LONG)(ymin - DESTY) * g->wrap;
+    for (y = ymin; y <= ymax; y++, line += g->wrap) {
+        UWORD *addr = get_start_addr16(xmin, y);
+        WORD bitnum = g->xoff + xmin - DESTX;
+        const UBYTE *src = line + (bitnum >> 3);
+        UBYTE mask = 0x80 >> (bitnum & 7);
+        UBYTE data = *src++;
+
+        for (x = xmin; x <= xmax; x++, addr++) {
+            switch(WRT_MODE) {
+            case 3:             /* reverse transparent */
+                if (!(data & mask))
+                    *addr = fg;
+                break;
+            case 2:             /* xor */
+                if (data & mask)
+                    *addr = ~*addr;
+                break;
+            case 1:             /* transparent */
+                if (data & mask)
+                    *addr = fg;
+                break;
+            default:            /* replace */
+                *addr = (data & mask) ? fg : bg;
+                break;
+            }
+            mask >>= 1;
+            if (!mask) {
+                mask = 0x80;
+                data = *src++;
+            }
+        }
+    }
+}
+
+
+/*
+ * text_blt_tc - blit one character to the screen
+ *
+ * This is the Truecolor version of text_blt(), and uses the same
+ * line-A variables for input and output: the character is taken from
+ * the font form at SOURCEX,SOURCEY with size DELX,DELY, and DESTX,DESTY
+ * are advanced past it on return.
+ */
+void text_blt_tc(Vwk * vwk)
+{
+    GLYPH g, work;
+    UBYTE *buf = (UBYTE *)scrtchp;
+    WORD smear = 0, skew = 0, advance;
+
+    g.base = (const UBYTE *)FBASE + (LONG)SOURCEY * FWIDTH;
+    g.wrap = FWIDTH;
+    g.xoff = SOURCEX;
+    g.w = DELX;
+    g.h = DELY;
+
+    if ((STYLE & F_THICKEN) && WEIGHT) {
+        smear = WEIGHT;
+        if (DOUBLE)             /* only thicken by half the regular amount */
+            smear = (smear > 1) ? smear >> 1 : 1;
+    }
+    if (STYLE & F_SKEW) {
+        skew = L_OFF + R_OFF;
+        if (DOUBLE)
+            skew >>= 1;
+    }
+
+    /* thicken & skew into the small buffer */
+    if (smear || skew) {
+        glyph_effects(&g, &work, buf, smear, skew);
+        g = work;
+    }
+
+    /* scale into the large buffer */
+    if (DOUBLE) {
+        advance = glyph_scale(&g, &work, buf + scrpt2, DELX);
+        g = work;
+    } else
+        advance = DELX;
+
+    /* the distance to the next character includes any thickening */
+    if ((STYLE & F_THICKEN) && WEIGHT && !MONO_STATUS)
+        advance += WEIGHT;
+
+    if ((CHUP == 0) && !(STYLE & (F_OUTLINE|F_LIGHT)))
+        put_plain(&g);
+    else
+        put_glyph(&g);
+
+    switch(CHUP) {
+    case 900:
+        DESTY -= advance;       /* move up */
+        break;
+    case 1800:
+        DESTX -= advance;       /* move left */
+        break;
+    case 2700:
+        DESTY += advance;       /* move down */
+        break;
+    default:
+        DESTX += advance;       /* move right */
+        break;
+    }
+}
+
+#endif /* CONF_WITH_VDI_16BIT */
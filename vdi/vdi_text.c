@@ -251,6 +251,11 @@ void vdi_v_gtext(Vwk * vwk)
             SOURCEY = 0;
             DELY = fnt_ptr->form_height;
 
+#if CONF_WITH_VDI_16BIT
+            if (TRUECOLOR_MODE)
+                text_blt_tc(vwk);
+            else
+#endif
             text_blt(vwk);
 
             fnt_ptr = vwk->cur_font;     /* restore reg var */